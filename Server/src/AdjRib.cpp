@@ -0,0 +1,464 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#include "AdjRib.h"
+#include "RibCheckpoint.h"
+
+#include <cstring>
+
+/**
+ * Get a bit of a prefix
+ *
+ * \param [in] prefix       Prefix in binary form
+ * \param [in] pos          Bit position, zero is the most significant bit
+ */
+static inline int prefixBit(const uint8_t *prefix, int pos) {
+    return (prefix[pos >> 3] >> (7 - (pos & 7))) & 1;
+}
+
+/**
+ * Get the number of leading bits two prefixes have in common
+ *
+ * \param [in] a            Prefix in binary form
+ * \param [in] b            Prefix in binary form
+ * \param [in] max          Max bits to compare
+ */
+static int commonBits(const uint8_t *a, const uint8_t *b, int max) {
+    int bits = 0;
+
+    for (int i = 0; bits < max; i++, bits += 8) {
+        uint8_t diff = a[i] ^ b[i];
+
+        if (diff) {
+            bits += __builtin_clz(diff) - 24;
+            break;
+        }
+    }
+
+    return bits < max ? bits : max;
+}
+
+/**
+ * Class constructor
+ *
+ * \details The paths of the checkpoint are loaded and a new generation is started.
+ *
+ *  \param [in] logPtr      Pointer to existing Logger for app logging
+ *  \param [in] checkpoint  Checkpoint to persist the paths to, NULL for none.  Owned by the RIB.
+ */
+AdjRib::AdjRib(Logger *logPtr, RibCheckpoint *checkpoint) {
+    logger = logPtr;
+    this->checkpoint = checkpoint;
+    generation = 0;
+    paths = 0;
+
+    if (checkpoint != NULL) {
+        Key key;
+        uint64_t attr_id;
+        uint32_t gen;
+
+        generation = checkpoint->getGeneration();
+
+        for (uint32_t i = 0; i < checkpoint->capacity(); i++) {
+            if (not checkpoint->getRecord(i, key, attr_id, gen))
+                continue;
+
+            if (key.len > 128) {
+                checkpoint->release(i);
+                continue;
+            }
+
+            Node *node = findNode(key, true);
+
+            Path path;
+            path.path_id = key.path_id;
+            path.generation = gen;
+            path.attr_id = attr_id;
+            path.record = i;
+
+            node->paths.push_back(path);
+            ++paths;
+        }
+    }
+
+    // The paths loaded are from the previous session
+    newSession();
+}
+
+/**
+ * Destructor
+ */
+AdjRib::~AdjRib() {
+    for (std::map<uint16_t, Node *>::iterator it = roots.begin(); it != roots.end(); ++it)
+        freeTrie(it->second);
+
+    if (checkpoint != NULL)
+        delete checkpoint;
+}
+
+/**
+ * Get the table of the key from the BMP peer flags
+ *
+ * \param [in] peer         Peer entry of the message
+ */
+uint8_t AdjRib::getTable(const MsgBusInterface::obj_bgp_peer &peer) {
+    uint8_t table = 0;
+
+    if (not peer.isAdjIn)
+        table |= 1;
+
+    if (not peer.isPrePolicy)
+        table |= 2;
+
+    if (peer.isLocRib)
+        table |= 4;
+
+    return table;
+}
+
+/**
+ * Start a new generation, all paths need to be confirmed again
+ */
+void AdjRib::newSession() {
+    // Zero marks a free checkpoint record
+    if (++generation == 0)
+        generation = 1;
+
+    if (checkpoint != NULL)
+        checkpoint->setGeneration(generation);
+}
+
+/**
+ * Add or update a path, confirming it for the current generation
+ *
+ * \param [in] key          Path key
+ * \param [in] attr_id      Attribute set ID of the path
+ *
+ * \return true if the path is new or its attribute set changed, false if unchanged
+ */
+bool AdjRib::update(const Key &key, uint64_t attr_id) {
+    if (key.len > 128)
+        return true;                        // Invalid length, not tracked
+
+    Node *node = findNode(key, true);
+
+    for (size_t i = 0; i < node->paths.size(); i++) {
+        Path &path = node->paths[i];
+
+        if (path.path_id != key.path_id)
+            continue;
+
+        bool changed = path.attr_id != attr_id;
+
+        if (changed or path.generation != generation) {
+            path.attr_id = attr_id;
+            path.generation = generation;
+
+            if (path.record != ADJ_RIB_NO_RECORD)
+                checkpoint->set(path.record, attr_id, generation);
+        }
+
+        return changed;
+    }
+
+    Path path;
+    path.path_id = key.path_id;
+    path.generation = generation;
+    path.attr_id = attr_id;
+    path.record = (checkpoint != NULL) ? checkpoint->add(key, attr_id, generation) : ADJ_RIB_NO_RECORD;
+
+    node->paths.push_back(path);
+    ++paths;
+
+    return true;
+}
+
+/**
+ * Remove a path
+ *
+ * \param [in] key          Path key
+ *
+ * \return true if the path was present
+ */
+bool AdjRib::remove(const Key &key) {
+    if (key.len > 128)
+        return true;                        // Invalid length, not tracked
+
+    return removePath(key);
+}
+
+/**
+ * Remove the paths of a table and type that were not confirmed for the current generation
+ *
+ * \param [in]  table       Table of the paths, see getTable()
+ * \param [in]  type        bgp::PREFIX_TYPE of the paths
+ * \param [out] stale       Keys of the removed paths
+ */
+void AdjRib::sweep(uint8_t table, uint8_t type, std::vector<Key> &stale) {
+    std::vector<Node *> walk;
+    Key key;
+
+    stale.clear();
+
+    std::map<uint16_t, Node *>::iterator it = roots.find(table << 8 | type);
+    if (it == roots.end())
+        return;
+
+    memset(&key, 0, sizeof(key));
+    key.table = table;
+    key.type = type;
+
+    walk.push_back(it->second);
+    while (not walk.empty()) {
+        Node *node = walk.back();
+        walk.pop_back();
+
+        for (size_t i = 0; i < node->paths.size(); i++) {
+            if (node->paths[i].generation == generation)
+                continue;
+
+            key.len = node->len;
+            key.path_id = node->paths[i].path_id;
+            memcpy(key.prefix, node->prefix, sizeof(key.prefix));
+
+            stale.push_back(key);
+        }
+
+        if (node->child[0] != NULL)
+            walk.push_back(node->child[0]);
+        if (node->child[1] != NULL)
+            walk.push_back(node->child[1]);
+    }
+
+    // Removing changes the trie, so it's done once the walk is over
+    for (size_t i = 0; i < stale.size(); i++)
+        removePath(stale[i]);
+}
+
+/**
+ * Get all paths, grouped by table and type
+ *
+ * \param [out] keys        Keys of the paths
+ */
+void AdjRib::getPaths(std::vector<Key> &keys) {
+    std::vector<Node *> walk;
+    Key key;
+
+    keys.clear();
+    keys.reserve(paths);
+    memset(&key, 0, sizeof(key));
+
+    for (std::map<uint16_t, Node *>::iterator it = roots.begin(); it != roots.end(); ++it) {
+        key.table = it->first >> 8;
+        key.type = it->first & 0xFF;
+
+        walk.push_back(it->second);
+        while (not walk.empty()) {
+            Node *node = walk.back();
+            walk.pop_back();
+
+            for (size_t i = 0; i < node->paths.size(); i++) {
+                key.len = node->len;
+                key.path_id = node->paths[i].path_id;
+                memcpy(key.prefix, node->prefix, sizeof(key.prefix));
+
+                keys.push_back(key);
+            }
+
+            if (node->child[0] != NULL)
+                walk.push_back(node->child[0]);
+            if (node->child[1] != NULL)
+                walk.push_back(node->child[1]);
+        }
+    }
+}
+
+/**
+ * Remove all paths
+ */
+void AdjRib::clear() {
+    for (std::map<uint16_t, Node *>::iterator it = roots.begin(); it != roots.end(); ++it)
+        freeTrie(it->second);
+
+    roots.clear();
+    paths = 0;
+
+    if (checkpoint != NULL)
+        checkpoint->clear();
+}
+
+/**
+ * Get the number of paths
+ */
+size_t AdjRib::size() {
+    return paths;
+}
+
+/**
+ * Find the node of a prefix
+ *
+ * \param [in] key          Path key
+ * \param [in] create       Insert the node if not found
+ *
+ * \return node, NULL if not found
+ */
+AdjRib::Node *AdjRib::findNode(const Key &key, bool create) {
+    Node **link;
+
+    if (create) {
+        link = &roots[key.table << 8 | key.type];
+
+    } else {
+        std::map<uint16_t, Node *>::iterator it = roots.find(key.table << 8 | key.type);
+        if (it == roots.end())
+            return NULL;
+
+        link = &it->second;
+    }
+
+    while (true) {
+        Node *node = *link;
+
+        if (node == NULL)
+            break;
+
+        int common = commonBits(node->prefix, key.prefix, node->len < key.len ? node->len : key.len);
+
+        if (common == node->len) {
+            if (node->len == key.len)
+                return node;
+
+            link = &node->child[prefixBit(key.prefix, node->len)];
+            continue;
+        }
+
+        if (not create)
+            return NULL;
+
+        // The prefix splits the node's edge, either above it or at a new branch
+        Node *leaf = new Node();
+        memcpy(leaf->prefix, key.prefix, sizeof(leaf->prefix));
+        leaf->len = key.len;
+
+        if (common == key.len) {
+            leaf->child[prefixBit(node->prefix, key.len)] = node;
+            *link = leaf;
+
+        } else {
+            Node *branch = new Node();
+            memcpy(branch->prefix, key.prefix, sizeof(branch->prefix));
+            branch->len = common;
+            branch->child[prefixBit(node->prefix, common)] = node;
+            branch->child[prefixBit(key.prefix, common)] = leaf;
+            *link = branch;
+        }
+
+        return leaf;
+    }
+
+    if (not create)
+        return NULL;
+
+    Node *leaf = new Node();
+    memcpy(leaf->prefix, key.prefix, sizeof(leaf->prefix));
+    leaf->len = key.len;
+    *link = leaf;
+
+    return leaf;
+}
+
+/**
+ * Remove a path from the trie, merging the nodes left without paths
+ *
+ * \param [in] key          Path key
+ *
+ * \return true if the path was present
+ */
+bool AdjRib::removePath(const Key &key) {
+    std::map<uint16_t, Node *>::iterator it = roots.find(key.table << 8 | key.type);
+    if (it == roots.end())
+        return false;
+
+    Node **link = &it->second;
+    Node **parent_link = NULL;
+    Node *node;
+
+    while ((node = *link) != NULL) {
+        if (node->len > key.len or commonBits(node->prefix, key.prefix, node->len) < node->len)
+            return false;
+
+        if (node->len == key.len)
+            break;
+
+        parent_link = link;
+        link = &node->child[prefixBit(key.prefix, node->len)];
+    }
+
+    if (node == NULL)
+        return false;
+
+    size_t i = 0;
+    while (i < node->paths.size() and node->paths[i].path_id != key.path_id)
+        i++;
+
+    if (i == node->paths.size())
+        return false;
+
+    if (node->paths[i].record != ADJ_RIB_NO_RECORD)
+        checkpoint->release(node->paths[i].record);
+
+    node->paths.erase(node->paths.begin() + i);
+    --paths;
+
+    if (not node->paths.empty() or (node->child[0] != NULL and node->child[1] != NULL))
+        return true;
+
+    // No paths and at most one child left, the child takes its place
+    *link = (node->child[0] != NULL) ? node->child[0] : node->child[1];
+    delete node;
+
+    // A branch is only needed while it has two children
+    if (parent_link != NULL) {
+        Node *parent = *parent_link;
+
+        if (parent->paths.empty() and (parent->child[0] == NULL or parent->child[1] == NULL)) {
+            *parent_link = (parent->child[0] != NULL) ? parent->child[0] : parent->child[1];
+            delete parent;
+        }
+    }
+
+    if (it->second == NULL)
+        roots.erase(it);
+
+    return true;
+}
+
+/**
+ * Free a trie
+ *
+ * \param [in] node         Root of the trie
+ */
+void AdjRib::freeTrie(Node *node) {
+    std::vector<Node *> walk;
+
+    if (node != NULL)
+        walk.push_back(node);
+
+    while (not walk.empty()) {
+        node = walk.back();
+        walk.pop_back();
+
+        if (node->child[0] != NULL)
+            walk.push_back(node->child[0]);
+        if (node->child[1] != NULL)
+            walk.push_back(node->child[1]);
+
+        delete node;
+    }
+}
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#ifndef ADJRIB_H_
+#define ADJRIB_H_
+
+#include "MsgBusInterface.hpp"
+#include "Logger.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#define ADJ_RIB_NO_RECORD       0xFFFFFFFF      ///< Path not persisted in the checkpoint
+
+class RibCheckpoint;
+
+/**
+ * \class   AdjRib
+ *
+ * \brief   Unicast prefixes of a peer as sent to the message bus
+ * \details Each table and prefix type of the peer is a compressed (path compressed binary)
+ *          radix trie keyed on the prefix bits and length.  A prefix node holds its paths by
+ *          add path ID, each with the attribute set ID it was last sent with.
+ *
+ *          The parser uses it to drop advertisements that don't change the attribute set of
+ *          a path and withdrawals of paths that were never sent.
+ *
+ *          Every peer session starts a new generation.  Paths advertised again are confirmed
+ *          for the new generation; once the End-Of-RIB is received, sweep() returns the paths
+ *          that were not confirmed.  With a RibCheckpoint, the paths are persisted and loaded
+ *          again when openbmpd restarts.
+ *
+ *          Only used by one thread at a time, the parser of the peer.
+ */
+class AdjRib {
+public:
+    /**
+     * Path key
+     */
+    struct Key {
+        uint8_t     table;                  ///< RIB of the peer, see getTable()
+        uint8_t     type;                   ///< bgp::PREFIX_TYPE
+        uint8_t     len;                    ///< Length of prefix in bits
+        uint8_t     reserved;               ///< Always zero
+        uint32_t    path_id;                ///< Add path ID - zero if not used
+        uint8_t     prefix[16];             ///< Prefix in binary form
+    };
+
+    /**
+     * Class constructor
+     *
+     * \details The paths of the checkpoint are loaded and a new generation is started.
+     *
+     *  \param [in] logPtr      Pointer to existing Logger for app logging
+     *  \param [in] checkpoint  Checkpoint to persist the paths to, NULL for none.  Owned by the RIB.
+     */
+    AdjRib(Logger *logPtr, RibCheckpoint *checkpoint);
+
+    virtual ~AdjRib();
+
+    /**
+     * Get the table of the key from the BMP peer flags
+     *
+     * \param [in] peer         Peer entry of the message
+     */
+    static uint8_t getTable(const MsgBusInterface::obj_bgp_peer &peer);
+
+    /**
+     * Start a new generation, all paths need to be confirmed again
+     */
+    void newSession();
+
+    /**
+     * Add or update a path, confirming it for the current generation
+     *
+     * \param [in] key          Path key
+     * \param [in] attr_id      Attribute set ID of the path
+     *
+     * \return true if the path is new or its attribute set changed, false if unchanged
+     */
+    bool update(const Key &key, uint64_t attr_id);
+
+    /**
+     * Remove a path
+     *
+     * \param [in] key          Path key
+     *
+     * \return true if the path was present
+     */
+    bool remove(const Key &key);
+
+    /**
+     * Remove the paths of a table and type that were not confirmed for the current generation
+     *
+     * \param [in]  table       Table of the paths, see getTable()
+     * \param [in]  type        bgp::PREFIX_TYPE of the paths
+     * \param [out] stale       Keys of the removed paths
+     */
+    void sweep(uint8_t table, uint8_t type, std::vector<Key> &stale);
+
+    /**
+     * Get all paths, grouped by table and type
+     *
+     * \param [out] keys        Keys of the paths
+     */
+    void getPaths(std::vector<Key> &keys);
+
+    /**
+     * Remove all paths
+     */
+    void clear();
+
+    /**
+     * Get the number of paths
+     */
+    size_t size();
+
+private:
+    /**
+     * Path of a prefix
+     */
+    struct Path {
+        uint32_t    path_id;                ///< Add path ID
+        uint32_t    generation;             ///< Generation the path was last confirmed in
+        uint64_t    attr_id;                ///< Attribute set ID
+        uint32_t    record;                 ///< Checkpoint record, ADJ_RIB_NO_RECORD if none
+    };
+
+    /**
+     * Trie node, either a prefix (has paths) or a branch of two children
+     */
+    struct Node {
+        uint8_t     prefix[16];             ///< Prefix bits, only the first len bits are used
+        uint8_t     len;                    ///< Length of prefix in bits
+        Node        *child[2];              ///< Children by the bit after len
+        std::vector<Path> paths;            ///< Paths of the prefix, empty for a branch
+    };
+
+    Logger      *logger;                    ///< Logging class pointer
+    RibCheckpoint *checkpoint;              ///< Persisted paths, NULL if none
+    uint32_t    generation;                 ///< Current generation
+    size_t      paths;                      ///< Number of paths
+
+    std::map<uint16_t, Node *> roots;       ///< Trie of each table and type
+
+    /**
+     * Find the node of a prefix
+     *
+     * \param [in] key          Path key
+     * \param [in] create       Insert the node if not found
+     *
+     * \return node, NULL if not found
+     */
+    Node *findNode(const Key &key, bool create);
+
+    /**
+     * Remove a path from the trie, merging the nodes left without paths
+     *
+     * \param [in] key          Path key
+     *
+     * \return true if the path was present
+     */
+    bool removePath(const Key &key);
+
+    /**
+     * Free a trie
+     *
+     * \param [in] node         Root of the trie
+     */
+    void freeTrie(Node *node);
+};
+
+#endif /* ADJRIB_H_ */
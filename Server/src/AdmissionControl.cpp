@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#include "AdmissionControl.h"
+
+#include <chrono>
+#include <cstdio>
+
+std::mutex AdmissionControl::sinks_lock;
+std::set<MsgBusInterface *> AdmissionControl::sinks;
+
+/**
+ * Get the current time in milliseconds, not affected by clock changes
+ */
+static uint64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Class constructor
+ *
+ *  \param [in] logPtr  Pointer to existing Logger for app logging
+ *  \param [in] config  Pointer to the loaded configuration
+ */
+AdmissionControl::AdmissionControl(Logger *logPtr, Config *config) {
+    cfg = config;
+    logger = logPtr;
+
+    last_sample = 0;
+    rate = 1;
+    budget = 0;
+    overloaded = false;
+
+    cpu_busy = 0;
+    cpu_total = 0;
+
+    parse_pool = NULL;
+
+    // Prime the CPU counters, the first sample measures from here
+    cpuBusy();
+}
+
+/**
+ * Destructor
+ */
+AdmissionControl::~AdmissionControl() {
+}
+
+/**
+ * Set the parse pool to sample, NULL if routers are parsed in their own threads
+ *
+ * \param [in] pool     Parse pool
+ */
+void AdmissionControl::setParsePool(ParsePool *pool) {
+    parse_pool = pool;
+}
+
+/**
+ * Register the message bus of a router to be sampled
+ *
+ * \param [in] mbus     Message bus of the router
+ */
+AdmissionControl::Sink::Sink(MsgBusInterface *mbus) {
+    this->mbus = mbus;
+
+    std::lock_guard<std::mutex> guard(sinks_lock);
+    sinks.insert(mbus);
+}
+
+/**
+ * Unregister the message bus, it's no longer sampled once this returns
+ */
+AdmissionControl::Sink::~Sink() {
+    std::lock_guard<std::mutex> guard(sinks_lock);
+    sinks.erase(mbus);
+}
+
+/**
+ * Check if a new router can be admitted now
+ *
+ * \param [in] sessions     Active sessions, used to sample the router buffers
+ *
+ * \return true if a router can be admitted, call admitted() when it is
+ */
+bool AdmissionControl::admit(SessionTable *sessions) {
+    uint64_t now = nowMs();
+
+    if (now - last_sample >= ADMISSION_SAMPLE_MS) {
+        last_sample = now;
+        sample(sessions);
+    }
+
+    return budget > 0;
+}
+
+/**
+ * Count a router admitted
+ */
+void AdmissionControl::admitted() {
+    if (budget > 0)
+        --budget;
+}
+
+/**
+ * Sample the load and set the budget for the next interval
+ *
+ * \param [in] sessions     Active sessions
+ */
+void AdmissionControl::sample(SessionTable *sessions) {
+    int fill = bufferFill(sessions);
+    int parse_queue = parse_pool != NULL ? parse_pool->queueDepth() : 0;
+    int64_t backlog = sinkBacklog();
+    int cpu = cpuBusy();
+
+    bool over = fill > cfg->admission_max_buffer_fill
+                or parse_queue > ADMISSION_MAX_PARSE_QUEUE
+                or backlog > cfg->admission_max_backlog
+                or (cfg->admission_max_cpu > 0 and cpu > cfg->admission_max_cpu);
+
+    if (over) {
+        if (not overloaded)
+            LOG_INFO("Holding new router connections, buffer fill %d%%, parse queue %d, sink backlog %lld, cpu %d%%",
+                     fill, parse_queue, (long long)backlog, cpu);
+
+        budget = 0;
+        rate = 1;
+
+    } else {
+        if (overloaded)
+            LOG_INFO("Admitting new router connections, buffer fill %d%%, parse queue %d, sink backlog %lld, cpu %d%%",
+                     fill, parse_queue, (long long)backlog, cpu);
+
+        // Unused budget of the last interval doesn't carry over
+        budget = rate;
+
+        if (rate < ADMISSION_MAX_RATE)
+            rate *= 2;
+    }
+
+    overloaded = over;
+}
+
+/**
+ * Get the percent of buffered bytes of all router buffers
+ *
+ * \param [in] sessions     Active sessions
+ */
+int AdmissionControl::bufferFill(SessionTable *sessions) {
+    uint64_t used = 0;
+    uint64_t size = 0;
+
+    sessions->getSessions(session_list);
+
+    for (size_t i = 0; i < session_list.size(); i++) {
+        std::shared_ptr<RingBuffer> ring = std::atomic_load(&session_list[i]->client.ring);
+        if (not ring)
+            continue;
+
+        used += ring->used();
+        size += ring->size();
+    }
+
+    if (size == 0)
+        return 0;
+
+    return used * 100 / size;
+}
+
+/**
+ * Get the messages queued to the message bus by all routers
+ *
+ *  The message buses are sampled here rather than by the router threads, which only
+ *  run when their router sends data.
+ */
+int64_t AdmissionControl::sinkBacklog() {
+    int64_t backlog = 0;
+
+    std::lock_guard<std::mutex> guard(sinks_lock);
+
+    for (std::set<MsgBusInterface *>::iterator it = sinks.begin(); it != sinks.end(); ++it)
+        backlog += (*it)->getBacklog();
+
+    return backlog;
+}
+
+/**
+ * Get the percent of CPU busy since the previous call
+ *
+ * \return percent busy, -1 if not available
+ */
+int AdmissionControl::cpuBusy() {
+    unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
+    int busy = -1;
+
+    FILE *f = fopen("/proc/stat", "r");
+    if (f == NULL)
+        return -1;
+
+    user = nice = system = idle = iowait = irq = softirq = steal = 0;
+
+    if (fscanf(f, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+               &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal) >= 4) {
+
+        uint64_t total = user + nice + system + idle + iowait + irq + softirq + steal;
+        uint64_t total_busy = total - idle - iowait;
+
+        if (total > cpu_total)
+            busy = (total_busy - cpu_busy) * 100 / (total - cpu_total);
+
+        cpu_busy = total_busy;
+        cpu_total = total;
+    }
+
+    fclose(f);
+
+    return busy;
+}
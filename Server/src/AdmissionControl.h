@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#ifndef ADMISSIONCONTROL_H_
+#define ADMISSIONCONTROL_H_
+
+#include "SessionTable.h"
+#include "ParsePool.h"
+#include "MsgBusInterface.hpp"
+#include "Logger.h"
+#include "Config.h"
+
+#include <mutex>
+#include <set>
+#include <vector>
+
+#define ADMISSION_SAMPLE_MS         1000    ///< Interval the collector load is sampled at
+#define ADMISSION_MAX_RATE          64      ///< Max routers admitted per sample interval
+#define ADMISSION_MAX_PARSE_QUEUE   8       ///< Max lanes queued per parse thread to admit a router
+
+/**
+ * \class   AdmissionControl
+ *
+ * \brief   Admits new router sessions based on the load of the collector
+ * \details The load is sampled every ADMISSION_SAMPLE_MS from the fill of the router
+ *          buffers and the lanes queued to the parse pool (parsing falls behind), the
+ *          messages queued to the message bus of each router (the sink falls behind) and
+ *          the host CPU busy.
+ *
+ *          While all are below the configured limits, the number of routers admitted per
+ *          interval starts at one and doubles each interval, up to ADMISSION_MAX_RATE.  A new
+ *          router takes a moment before its RIB dump shows in the load, so routers are not
+ *          admitted all at once.  Once a limit is reached no router is admitted and the rate
+ *          starts over.
+ *
+ *          Called from the main thread only, except the Sink registration.
+ */
+class AdmissionControl {
+public:
+    /**
+     * Class constructor
+     *
+     *  \param [in] logPtr  Pointer to existing Logger for app logging
+     *  \param [in] config  Pointer to the loaded configuration
+     */
+    AdmissionControl(Logger *logPtr, Config *config);
+
+    virtual ~AdmissionControl();
+
+    /**
+     * Check if a new router can be admitted now
+     *
+     * \param [in] sessions     Active sessions, used to sample the router buffers
+     *
+     * \return true if a router can be admitted, call admitted() when it is
+     */
+    bool admit(SessionTable *sessions);
+
+    /**
+     * Count a router admitted
+     */
+    void admitted();
+
+    /**
+     * Set the parse pool to sample, NULL if routers are parsed in their own threads
+     *
+     * \param [in] pool     Parse pool
+     */
+    void setParsePool(ParsePool *pool);
+
+    /**
+     * Message bus of a router, its backlog is sampled while the object is in scope
+     *
+     * \details Created by the router thread for the lifetime of its message bus.
+     */
+    class Sink {
+    public:
+        Sink(MsgBusInterface *mbus);
+        ~Sink();
+
+    private:
+        MsgBusInterface *mbus;
+    };
+
+public:
+    Logger      *logger;                    ///< Logging class pointer
+
+private:
+    Config      *cfg;                       ///< Config pointer
+
+    uint64_t    last_sample;                ///< Time of the last sample in milliseconds
+    int         rate;                       ///< Routers admitted in the next interval below the limits
+    int         budget;                     ///< Routers that can still be admitted this interval
+    bool        overloaded;                 ///< True if a limit was reached in the last sample
+
+    uint64_t    cpu_busy;                   ///< Busy CPU time of the last sample, in ticks
+    uint64_t    cpu_total;                  ///< Total CPU time of the last sample, in ticks
+
+    std::vector<ThreadMgmt *> session_list; ///< Reused list of sessions to sample
+    ParsePool   *parse_pool;                ///< Parse pool to sample, NULL if not used
+
+    static std::mutex sinks_lock;           ///< Protects sinks
+    static std::set<MsgBusInterface *> sinks;   ///< Message buses of the active routers
+
+    /**
+     * Sample the load and set the budget for the next interval
+     *
+     * \param [in] sessions     Active sessions
+     */
+    void sample(SessionTable *sessions);
+
+    /**
+     * Get the percent of buffered bytes of all router buffers
+     *
+     * \param [in] sessions     Active sessions
+     */
+    int bufferFill(SessionTable *sessions);
+
+    /**
+     * Get the messages queued to the message bus by all routers
+     */
+    int64_t sinkBacklog();
+
+    /**
+     * Get the percent of CPU busy since the previous call
+     *
+     * \return percent busy, -1 if not available
+     */
+    int cpuBusy();
+};
+
+#endif /* ADMISSIONCONTROL_H_ */
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#include "AttrCache.h"
+
+/**
+ * Class constructor
+ *
+ *  \param [in] max_entries     Max attribute sets kept
+ */
+AttrCache::AttrCache(size_t max_entries) {
+    this->max_entries = max_entries > 0 ? max_entries : 1;
+
+    index.reserve(this->max_entries);
+}
+
+/**
+ * Destructor
+ */
+AttrCache::~AttrCache() {
+}
+
+/**
+ * Hash an attribute key (FNV-1a)
+ *
+ * \param [in] key          Raw attribute bytes
+ */
+uint64_t AttrCache::hash(const std::string &key) {
+    uint64_t h = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < key.size(); i++) {
+        h ^= (uint8_t)key[i];
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+/**
+ * Find an attribute set, making it the most recently used
+ *
+ * \param [in] key          Raw attribute bytes
+ * \param [in] key_hash     hash() of the key
+ *
+ * \return attribute object as sent, NULL if not found
+ */
+const MsgBusInterface::obj_path_attr *AttrCache::find(const std::string &key, uint64_t key_hash) {
+    std::unordered_map<uint64_t, entry_iter>::iterator it = index.find(key_hash);
+
+    // The hash only selects the entry, the bytes have to match
+    if (it == index.end() or it->second->key != key)
+        return NULL;
+
+    if (it->second != entries.begin())
+        entries.splice(entries.begin(), entries, it->second);
+
+    return &entries.front().attr;
+}
+
+/**
+ * Add an attribute set sent to the message bus, dropping the least recently used when full
+ *
+ * \param [in] key          Raw attribute bytes
+ * \param [in] key_hash     hash() of the key
+ * \param [in] attr         Attribute object as sent, including its hash ID
+ */
+void AttrCache::add(const std::string &key, uint64_t key_hash, const MsgBusInterface::obj_path_attr &attr) {
+    std::unordered_map<uint64_t, entry_iter>::iterator it = index.find(key_hash);
+
+    if (it != index.end()) {
+        // Same hash, either the same attributes again or a collision; the newest wins
+        entries.splice(entries.begin(), entries, it->second);
+
+    } else {
+        if (entries.size() >= max_entries) {
+            // Reuse the least recently used entry, keeps its string buffers
+            index.erase(entries.back().key_hash);
+            entries.splice(entries.begin(), entries, --entries.end());
+
+        } else
+            entries.push_front(Entry());
+
+        index[key_hash] = entries.begin();
+    }
+
+    Entry &entry = entries.front();
+    entry.key = key;
+    entry.key_hash = key_hash;
+    entry.attr = attr;
+}
+
+/**
+ * Remove all attribute sets
+ */
+void AttrCache::clear() {
+    index.clear();
+    entries.clear();
+}
+
+/**
+ * Get the number of attribute sets
+ */
+size_t AttrCache::size() {
+    return entries.size();
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#ifndef ATTRCACHE_H_
+#define ATTRCACHE_H_
+
+#include "MsgBusInterface.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+/**
+ * \class   AttrCache
+ *
+ * \brief   Path attribute sets of a peer already sent to the message bus, least recently used first out
+ * \details Entries are keyed on the raw path attribute bytes of the update, without the NLRI of
+ *          MP_REACH and MP_UNREACH, and hold the attribute object as sent with its hash ID.
+ *          During RIB dumps most updates of a peer repeat the attributes of a recent update, the
+ *          parser then skips decoding and printing them and doesn't send the base attribute again.
+ *
+ *          Only used by one thread at a time, the parser of the peer.
+ */
+class AttrCache {
+public:
+    /**
+     * Class constructor
+     *
+     *  \param [in] max_entries     Max attribute sets kept
+     */
+    AttrCache(size_t max_entries);
+
+    virtual ~AttrCache();
+
+    /**
+     * Hash an attribute key (FNV-1a)
+     *
+     * \param [in] key          Raw attribute bytes
+     */
+    static uint64_t hash(const std::string &key);
+
+    /**
+     * Find an attribute set, making it the most recently used
+     *
+     * \param [in] key          Raw attribute bytes
+     * \param [in] key_hash     hash() of the key
+     *
+     * \return attribute object as sent, NULL if not found
+     */
+    const MsgBusInterface::obj_path_attr *find(const std::string &key, uint64_t key_hash);
+
+    /**
+     * Add an attribute set sent to the message bus, dropping the least recently used when full
+     *
+     * \param [in] key          Raw attribute bytes
+     * \param [in] key_hash     hash() of the key
+     * \param [in] attr         Attribute object as sent, including its hash ID
+     */
+    void add(const std::string &key, uint64_t key_hash, const MsgBusInterface::obj_path_attr &attr);
+
+    /**
+     * Remove all attribute sets
+     */
+    void clear();
+
+    /**
+     * Get the number of attribute sets
+     */
+    size_t size();
+
+private:
+    /**
+     * Cached attribute set
+     */
+    struct Entry {
+        std::string key;                    ///< Raw attribute bytes
+        uint64_t    key_hash;               ///< Hash of the key
+        MsgBusInterface::obj_path_attr attr;    ///< Attribute object as sent
+    };
+
+    typedef std::list<Entry>::iterator entry_iter;
+
+    size_t      max_entries;                ///< Max attribute sets kept
+
+    std::list<Entry> entries;               ///< Attribute sets, most recently used first
+    std::unordered_map<uint64_t, entry_iter> index;     ///< Attribute sets by key hash
+};
+
+#endif /* ATTRCACHE_H_ */
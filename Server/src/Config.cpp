@@ -16,6 +16,7 @@
 #include <unistd.h>
 
 #include <arpa/inet.h>
+#include <sys/un.h>
 #include <yaml-cpp/yaml.h>
 #include <boost/xpressive/xpressive.hpp>
 #include <boost/exception/all.hpp>
@@ -39,11 +40,19 @@ Config::Config() {
     debug_bmp           = false;
     debug_msgbus        = false;
     bmp_buffer_size     = 15 * 1024 * 1024; // 15MB
+    bmp_buffer_max_size = 0;                // Fixed size
+    bmp_buffer_budget   = 0;                // Unlimited
+    bmp_spool_size      = 0;                // Disabled
+    bmp_spool_dir       = "/var/tmp";
     svr_ipv6            = false;
     svr_ipv4            = true;
     bind_ipv4           = "";
     bind_ipv6           = "";
+    listen_backlog      = 128;
+    listen_shards       = 1;
     heartbeat_interval  = 60 * 5;        // Default is 5 minutes
+    stats_interval      = 60 * 5;        // Default is 5 minutes
+    shutdown_timeout    = 10;
     kafka_brokers       = "localhost:9092";
     tx_max_bytes        = 1000000;
     rx_max_bytes        = 100000000;
@@ -58,7 +67,20 @@ Config::Config() {
     max_concurrent_routers = 2;
     initial_router_time = 60;
     calculate_baseline  = true;
+    baseline_updates    = 0;
     pat_enabled		= false;
+    admission_mode      = ADMISSION_LOAD;
+    admission_max_buffer_fill = 50;
+    admission_max_backlog = 100000;
+    admission_max_cpu   = 85;
+    io_mode             = IO_MODE_EPOLL;
+    io_threads          = 4;
+    parse_threads       = 0;                // Parse in the router reader thread
+    attr_cache_size     = 1024;
+    huge_pages          = HUGE_PAGES_THP;
+    numa                = false;
+    rib_enabled         = false;
+    rib_checkpoint_dir  = "";               // Disabled
     bzero(admin_id, sizeof(admin_id));
 
     /*
@@ -192,6 +214,59 @@ void Config::parseBase(const YAML::Node &node) {
             std::cout << "   Config: listen_ipv6: " << bind_ipv6 << "\n";
     }
 
+    if (node["listen_backlog"]) {
+        try {
+            listen_backlog = node["listen_backlog"].as<int>();
+
+            if (listen_backlog < 1 || listen_backlog > 65535)
+                throw "invalid listen_backlog, not within range of 1 - 65535";
+
+            if (debug_general)
+                std::cout << "   Config: listen_backlog: " << listen_backlog << std::endl;
+
+        } catch (YAML::TypedBadConversion<int> err) {
+            printWarning("listen_backlog is not of type int", node["listen_backlog"]);
+        }
+    }
+
+    if (node["listen_shards"]) {
+        try {
+            listen_shards = node["listen_shards"].as<int>();
+
+            if (listen_shards < 1 || listen_shards > 64)
+                throw "invalid listen_shards, not within range of 1 - 64";
+
+            if (debug_general)
+                std::cout << "   Config: listen_shards: " << listen_shards << std::endl;
+
+        } catch (YAML::TypedBadConversion<int> err) {
+            printWarning("listen_shards is not of type int", node["listen_shards"]);
+        }
+    }
+
+    if (node["listen_unix"]) {
+        try {
+            listen_unix.clear();
+
+            if (node["listen_unix"].IsSequence()) {
+                for (std::size_t i = 0; i < node["listen_unix"].size(); i++)
+                    listen_unix.push_back(node["listen_unix"][i].as<std::string>());
+            } else
+                listen_unix.push_back(node["listen_unix"].as<std::string>());
+
+            for (std::size_t i = 0; i < listen_unix.size(); i++) {
+                if (listen_unix[i].empty() || listen_unix[i].length() >= sizeof(((sockaddr_un *)0)->sun_path))
+                    throw "invalid listen_unix, path is empty or too long";
+
+                if (debug_general)
+                    std::cout << "   Config: listen_unix: " << listen_unix[i] << std::endl;
+            }
+
+        } catch (YAML::TypedBadConversion<std::string> err) {
+            printWarning("listen_unix is not of type string", node["listen_unix"]);
+        }
+    }
+
     if (node["listen_mode"]) {
         try {
             value = node["listen_mode"].as<std::string>();
@@ -201,6 +276,9 @@ void Config::parseBase(const YAML::Node &node) {
             } else if (value.compare("v6") == 0) {
                 svr_ipv6 = true;
                 svr_ipv4 = false;
+            } else if (value.compare("unix") == 0) {
+                svr_ipv6 = false;
+                svr_ipv4 = false;
             } else { /* don't care if it's v4v6 or not */
                 svr_ipv6 = true;
                 svr_ipv4 = true;
@@ -231,6 +309,139 @@ void Config::parseBase(const YAML::Node &node) {
                 printWarning("buffers.router is not of type int", node["buffers"]["router"]);
             }
         }
+
+        if (node["buffers"]["router_max"]) {
+            try {
+                bmp_buffer_max_size = node["buffers"]["router_max"].as<int>();
+
+                if (bmp_buffer_max_size != 0 and (bmp_buffer_max_size < 2 || bmp_buffer_max_size > 1024))
+                    throw "invalid router max buffer size, must be 0 or within range of 2 - 1024)";
+
+                bmp_buffer_max_size *= 1024 * 1024;  // MB to bytes
+
+                if (debug_general)
+                    std::cout << "   Config: bmp buffer max: " << bmp_buffer_max_size << std::endl;
+
+            } catch (YAML::TypedBadConversion<int> err) {
+                printWarning("buffers.router_max is not of type int", node["buffers"]["router_max"]);
+            }
+        }
+
+        if (node["buffers"]["budget"]) {
+            try {
+                bmp_buffer_budget = node["buffers"]["budget"].as<uint64_t>();
+
+                if (bmp_buffer_budget > 4194304)
+                    throw "invalid buffer budget, not within range of 0 - 4194304)";
+
+                bmp_buffer_budget *= 1024 * 1024;  // MB to bytes
+
+                if (debug_general)
+                    std::cout << "   Config: bmp buffer budget: " << bmp_buffer_budget << std::endl;
+
+            } catch (YAML::TypedBadConversion<uint64_t> err) {
+                printWarning("buffers.budget is not of type unsigned 64 bit", node["buffers"]["budget"]);
+            }
+        }
+
+        if (node["buffers"]["spool"]) {
+            try {
+                bmp_spool_size = node["buffers"]["spool"].as<uint64_t>();
+
+                if (bmp_spool_size != 0 and (bmp_spool_size < 64 || bmp_spool_size > 1048576))
+                    throw "invalid router spool size, must be 0 or within range of 64 - 1048576)";
+
+                bmp_spool_size *= 1024 * 1024;  // MB to bytes
+
+                if (debug_general)
+                    std::cout << "   Config: bmp spool: " << bmp_spool_size << std::endl;
+
+            } catch (YAML::TypedBadConversion<uint64_t> err) {
+                printWarning("buffers.spool is not of type unsigned 64 bit", node["buffers"]["spool"]);
+            }
+        }
+
+        if (node["buffers"]["spool_dir"]) {
+            try {
+                bmp_spool_dir = node["buffers"]["spool_dir"].as<std::string>();
+
+                if (debug_general)
+                    std::cout << "   Config: bmp spool dir: " << bmp_spool_dir << std::endl;
+
+            } catch (YAML::TypedBadConversion<std::string> err) {
+                printWarning("buffers.spool_dir is not of type string", node["buffers"]["spool_dir"]);
+            }
+        }
+    }
+
+    if (node["io"]) {
+        if (node["io"]["mode"]) {
+            try {
+                value = node["io"]["mode"].as<std::string>();
+
+                if (value.compare("epoll") == 0)
+                    io_mode = IO_MODE_EPOLL;
+                else if (value.compare("thread") == 0)
+                    io_mode = IO_MODE_THREAD;
+                else if (value.compare("io_uring") == 0)
+                    io_mode = IO_MODE_URING;
+                else
+                    throw "invalid io mode, expected epoll, io_uring or thread";
+
+                if (debug_general)
+                    std::cout << "   Config: io mode: " << value << std::endl;
+
+            } catch (YAML::TypedBadConversion<std::string> err) {
+                printWarning("io.mode is not of type string", node["io"]["mode"]);
+            }
+        }
+
+        if (node["io"]["threads"]) {
+            try {
+                io_threads = node["io"]["threads"].as<int>();
+
+                if (io_threads < 1 || io_threads > 64)
+                    throw "invalid io threads, not within range of 1 - 64";
+
+                if (debug_general)
+                    std::cout << "   Config: io threads: " << io_threads << std::endl;
+
+            } catch (YAML::TypedBadConversion<int> err) {
+                printWarning("io.threads is not of type int", node["io"]["threads"]);
+            }
+        }
+    }
+
+    if (node["parse"]) {
+        if (node["parse"]["threads"]) {
+            try {
+                parse_threads = node["parse"]["threads"].as<int>();
+
+                if (parse_threads < 0 || parse_threads > 256)
+                    throw "invalid parse threads, not within range of 0 - 256";
+
+                if (debug_general)
+                    std::cout << "   Config: parse threads: " << parse_threads << std::endl;
+
+            } catch (YAML::TypedBadConversion<int> err) {
+                printWarning("parse.threads is not of type int", node["parse"]["threads"]);
+            }
+        }
+
+        if (node["parse"]["attr_cache_size"]) {
+            try {
+                attr_cache_size = node["parse"]["attr_cache_size"].as<int>();
+
+                if (attr_cache_size < 0 || attr_cache_size > 1000000)
+                    throw "invalid parse attr_cache_size, not within range of 0 - 1000000";
+
+                if (debug_general)
+                    std::cout << "   Config: parse attr cache size: " << attr_cache_size << std::endl;
+
+            } catch (YAML::TypedBadConversion<int> err) {
+                printWarning("parse.attr_cache_size is not of type int", node["parse"]["attr_cache_size"]);
+            }
+        }
     }
 
     if (node["heartbeat"]) {
@@ -252,6 +463,101 @@ void Config::parseBase(const YAML::Node &node) {
         }
     }
 
+    if (node["stats"]) {
+        if (node["stats"]["interval"]) {
+            try {
+                stats_interval = node["stats"]["interval"].as<int>();
+
+                if (stats_interval < 0 || stats_interval > 86400)
+                    throw "invalid stats interval not within range of 0 - 86400)";
+
+                if (debug_general)
+                    std::cout << "   Config: stats interval: " << stats_interval << std::endl;
+
+            } catch (YAML::TypedBadConversion<int> err) {
+                printWarning("stats.interval is not of type int", node["stats"]["interval"]);
+            }
+        }
+    }
+
+    if (node["shutdown"]) {
+        if (node["shutdown"]["timeout"]) {
+            try {
+                shutdown_timeout = node["shutdown"]["timeout"].as<int>();
+
+                if (shutdown_timeout < 0 || shutdown_timeout > 3600)
+                    throw "invalid shutdown timeout not within range of 0 - 3600)";
+
+                if (debug_general)
+                    std::cout << "   Config: shutdown timeout: " << shutdown_timeout << std::endl;
+
+            } catch (YAML::TypedBadConversion<int> err) {
+                printWarning("shutdown.timeout is not of type int", node["shutdown"]["timeout"]);
+            }
+        }
+    }
+
+    if (node["memory"]) {
+        if (node["memory"]["huge_pages"]) {
+            try {
+                value = node["memory"]["huge_pages"].as<std::string>();
+
+                if (value.compare("none") == 0)
+                    huge_pages = HUGE_PAGES_NONE;
+                else if (value.compare("thp") == 0)
+                    huge_pages = HUGE_PAGES_THP;
+                else if (value.compare("explicit") == 0)
+                    huge_pages = HUGE_PAGES_EXPLICIT;
+                else
+                    throw "invalid memory huge_pages, expected none, thp or explicit";
+
+                if (debug_general)
+                    std::cout << "   Config: memory huge pages: " << value << std::endl;
+
+            } catch (YAML::TypedBadConversion<std::string> err) {
+                printWarning("memory.huge_pages is not of type string", node["memory"]["huge_pages"]);
+            }
+        }
+
+        if (node["memory"]["numa"]) {
+            try {
+                numa = node["memory"]["numa"].as<bool>();
+
+                if (debug_general)
+                    std::cout << "   Config: memory numa: " << numa << std::endl;
+
+            } catch (YAML::TypedBadConversion<bool> err) {
+                printWarning("memory.numa is not of type bool", node["memory"]["numa"]);
+            }
+        }
+    }
+
+    if (node["rib"]) {
+        if (node["rib"]["enabled"]) {
+            try {
+                rib_enabled = node["rib"]["enabled"].as<bool>();
+
+                if (debug_general)
+                    std::cout << "   Config: rib enabled: " << rib_enabled << std::endl;
+
+            } catch (YAML::TypedBadConversion<bool> err) {
+                printWarning("rib.enabled is not of type bool", node["rib"]["enabled"]);
+            }
+        }
+
+        if (node["rib"]["checkpoint_dir"]) {
+            try {
+                rib_checkpoint_dir = node["rib"]["checkpoint_dir"].as<std::string>();
+
+                if (debug_general)
+                    std::cout << "   Config: rib checkpoint dir: " << rib_checkpoint_dir << std::endl;
+
+            } catch (YAML::TypedBadConversion<std::string> err) {
+                printWarning("rib.checkpoint_dir is not of type string", node["rib"]["checkpoint_dir"]);
+            }
+        }
+    }
+
     if (node["startup"]) {
         if (node["startup"]["max_concurrent_routers"]) {
             try {
@@ -309,6 +615,67 @@ void Config::parseBase(const YAML::Node &node) {
                 printWarning("pat_enabled is not of type bool", node["startup"]["pat_enabled"]);
             }
         }
+
+        if (node["startup"]["admission"]) {
+            try {
+                value = node["startup"]["admission"].as<std::string>();
+
+                if (value.compare("load") == 0)
+                    admission_mode = ADMISSION_LOAD;
+                else if (value.compare("timer") == 0)
+                    admission_mode = ADMISSION_TIMER;
+                else
+                    throw "invalid admission, expected load or timer";
+
+                if (debug_general)
+                    std::cout << "   Config: admission: " << value << std::endl;
+
+            } catch (YAML::TypedBadConversion<std::string> err) {
+                printWarning("admission is not of type string", node["startup"]["admission"]);
+            }
+        }
+
+        if (node["startup"]["max_buffer_fill"]) {
+            try {
+                admission_max_buffer_fill = node["startup"]["max_buffer_fill"].as<int>();
+
+                if (admission_max_buffer_fill < 1 || admission_max_buffer_fill > 100)
+                    throw "invalid max buffer fill, not within range of 1 - 100 percent";
+
+                if (debug_general)
+                    std::cout << "   Config: max buffer fill: " << admission_max_buffer_fill << std::endl;
+
+            } catch (YAML::TypedBadConversion<int> err) {
+                printWarning("max_buffer_fill is not of type int", node["startup"]["max_buffer_fill"]);
+            }
+        }
+
+        if (node["startup"]["max_sink_backlog"]) {
+            try {
+                admission_max_backlog = node["startup"]["max_sink_backlog"].as<uint32_t>();
+
+                if (debug_general)
+                    std::cout << "   Config: max sink backlog: " << admission_max_backlog << std::endl;
+
+            } catch (YAML::TypedBadConversion<uint32_t> err) {
+                printWarning("max_sink_backlog is not of type unsigned int", node["startup"]["max_sink_backlog"]);
+            }
+        }
+
+        if (node["startup"]["max_cpu"]) {
+            try {
+                admission_max_cpu = node["startup"]["max_cpu"].as<int>();
+
+                if (admission_max_cpu < 0 || admission_max_cpu > 100)
+                    throw "invalid max cpu, not within range of 0 - 100 percent";
+
+                if (debug_general)
+                    std::cout << "   Config: max cpu: " << admission_max_cpu << std::endl;
+
+            } catch (YAML::TypedBadConversion<int> err) {
+                printWarning("max_cpu is not of type int", node["startup"]["max_cpu"]);
+            }
+        }
     }
 
 }
@@ -13,11 +13,15 @@
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
+#include <atomic>
+#include <mutex>
 #include <yaml-cpp/yaml.h>
 #include <boost/xpressive/xpressive.hpp>
 #include <boost/exception/all.hpp>
 
 #define MAX_THREADS 200
+#define MAX_SESSIONS 8192           ///< Max router sessions when using the event-driven (epoll) ingest
 
 using namespace boost::xpressive;
 
@@ -37,8 +41,15 @@ public:
     uint16_t    bmp_port;                 ///< BMP listening port
     std::string bind_ipv4;                ///< IP to listen on for IPv4
     std::string bind_ipv6;                ///< IP to listen on for IPv6
+    int         listen_backlog;           ///< Listen backlog of each listening socket
+    int         listen_shards;            ///< Number of SO_REUSEPORT listening sockets per address family
+    std::vector<std::string> listen_unix; ///< Unix domain socket paths to listen on for local routers
 
     int         bmp_buffer_size;          ///< BMP buffer size in bytes (min is 2M max is 128M)
+    int         bmp_buffer_max_size;      ///< Size in bytes the BMP buffer can grow to, zero for a fixed size
+    uint64_t    bmp_buffer_budget;        ///< Memory budget in bytes for all BMP buffers, zero for unlimited
+    uint64_t    bmp_spool_size;           ///< Per router disk spool size in bytes, zero to disable
+    std::string bmp_spool_dir;            ///< Directory for the per router spool files
     bool        svr_ipv4;                 ///< Indicates if server should listen for IPv4 connections
     bool        svr_ipv6;                 ///< Indicates if server should listen for IPv6 connections
 
@@ -48,6 +59,8 @@ public:
     bool        debug_msgbus;
 
     int         heartbeat_interval;      ///< Heartbeat interval in seconds for collector updates
+    int         stats_interval;          ///< Interval in seconds for logging router stats, zero to disable
+    int         shutdown_timeout;        ///< Seconds to drain the routers on shutdown before they are canceled
     int   	tx_max_bytes;            ///< Maximum transmit message size
     int 	rx_max_bytes;            ///< Maximum receive  message size
     int 	session_timeout;         ///< Client session timeout
@@ -63,6 +76,37 @@ public:
     bool        calculate_baseline;      ///<Indicates if router baseline time should be calculated
     bool        pat_enabled;             ///<Indicates if router hash needs to be based on INIT message instead of source IP
 
+    /**
+     * Router admission modes
+     */
+    enum ADMISSION_MODES { ADMISSION_TIMER=0, ADMISSION_LOAD };
+
+    int         admission_mode;          ///< How new routers are admitted, see ADMISSION_MODES
+    int         admission_max_buffer_fill;   ///< Max percent of the router buffers in use to admit a router
+    uint32_t    admission_max_backlog;   ///< Max messages queued to the message bus to admit a router
+    int         admission_max_cpu;       ///< Max percent of CPU busy to admit a router, zero to ignore CPU
+
+    /**
+     * Router socket ingest modes
+     */
+    enum IO_MODES { IO_MODE_THREAD=0, IO_MODE_EPOLL, IO_MODE_URING };
+
+    int         io_mode;                 ///< Router socket ingest mode, see IO_MODES
+    int         io_threads;              ///< Number of I/O worker threads used by the event-driven ingest
+    int         parse_threads;           ///< Number of shared parse threads, zero to parse in the router reader thread
+    int         attr_cache_size;         ///< Attribute sets cached per peer to skip decoding and sending them again, zero to disable
+
+    /**
+     * Huge page backing of the large buffers
+     */
+    enum HUGE_PAGES_MODES { HUGE_PAGES_NONE=0, HUGE_PAGES_THP, HUGE_PAGES_EXPLICIT };
+
+    int         huge_pages;              ///< Huge page backing of the router buffers, see HUGE_PAGES_MODES
+    bool        numa;                    ///< Place the I/O and parse threads and router buffers on NUMA nodes
+
+    bool        rib_enabled;             ///< Keep the RIB of each peer to drop updates that change nothing
+    std::string rib_checkpoint_dir;      ///< Directory of the per peer RIB checkpoints, empty to disable
+
     /**
      * matching structs and maps
      */
@@ -115,6 +159,8 @@ public:
      */
     std::map<std::string, float> router_baseline_time;
     typedef std::map<std::string, float>::iterator router_baseline_time_iter;
+    std::mutex  router_baseline_lock;           ///< Protects router_baseline_time, used by the router and main threads
+    std::atomic<uint32_t> baseline_updates;     ///< Incremented each time a router baseline time is added
 
     /*********************************************************************//**
      * Constructor for class
@@ -0,0 +1,500 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "IOEngine.h"
+#include "MemPolicy.h"
+
+/**
+ * Class constructor
+ *
+ *  \param [in] logPtr  Pointer to existing Logger for app logging
+ *  \param [in] config  Pointer to the loaded configuration
+ *
+ *  \throws (const char *) on error.
+ */
+IOEngine::IOEngine(Logger *logPtr, Config *config) : IOEngine(logPtr, config, true) {
+}
+
+/**
+ * Constructor for engines that derive from this class
+ *
+ *  \param [in] logPtr          Pointer to existing Logger for app logging
+ *  \param [in] config          Pointer to the loaded configuration
+ *  \param [in] start_workers   True to start the epoll I/O threads
+ *
+ *  \throws (const char *) on error.
+ */
+IOEngine::IOEngine(Logger *logPtr, Config *config, bool start_workers) {
+    debug = false;
+    cfg = config;
+    logger = logPtr;
+
+    if (cfg->debug_bmp)
+        enableDebug();
+
+    running = true;
+    draining = false;
+
+    if (not start_workers)
+        return;
+
+    for (int i = 0; i < cfg->io_threads; i++) {
+        IOWorker *w = new IOWorker;
+        w->sessions = 0;
+        w->thr = NULL;
+        w->node = MemPolicy::workerNode(i);
+
+        if ((w->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+            delete w;
+            throw "ERROR: IOEngine cannot create epoll instance";
+        }
+
+        if ((w->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+            close(w->epoll_fd);
+            delete w;
+            throw "ERROR: IOEngine cannot create eventfd";
+        }
+
+        // A NULL data pointer identifies the wake event
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        if (epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, w->wake_fd, &ev) < 0) {
+            close(w->wake_fd);
+            close(w->epoll_fd);
+            delete w;
+            throw "ERROR: IOEngine cannot add eventfd to epoll";
+        }
+
+        workers.push_back(w);
+        w->thr = new std::thread(&IOEngine::workerLoop, this, w);
+    }
+
+    LOG_INFO("I/O engine started with %d threads", cfg->io_threads);
+}
+
+/**
+ * Destructor
+ */
+IOEngine::~IOEngine() {
+    stop();
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        close(workers[i]->epoll_fd);
+        close(workers[i]->wake_fd);
+        delete workers[i];
+    }
+    workers.clear();
+}
+
+/**
+ * Stop reading all routers, used on shutdown
+ */
+void IOEngine::drain() {
+    if (draining.exchange(true))
+        return;
+
+    // The sessions are owned by the I/O threads, they stop reading on the wakeup
+    uint64_t wake = 1;
+    for (size_t i = 0; i < workers.size(); i++) {
+        IOWorker *w = workers[i];
+
+        {
+            std::lock_guard<std::mutex> guard(w->lock);
+            w->ready.insert(w->ready.end(), w->session_set.begin(), w->session_set.end());
+        }
+
+        write(w->wake_fd, &wake, sizeof(wake));
+    }
+}
+
+/**
+ * Stop all I/O threads and release all remaining sessions
+ */
+void IOEngine::stop() {
+    if (not running.exchange(false))
+        return;
+
+    uint64_t wake = 1;
+    for (size_t i = 0; i < workers.size(); i++)
+        write(workers[i]->wake_fd, &wake, sizeof(wake));
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        IOWorker *w = workers[i];
+
+        if (w->thr != NULL) {
+            if (w->thr->joinable())
+                w->thr->join();
+
+            delete w->thr;
+            w->thr = NULL;
+        }
+
+        // Closing the ring notifies the worker, which takes the lock
+        std::set<IOSession *> list;
+        {
+            std::lock_guard<std::mutex> guard(w->lock);
+            list.swap(w->session_set);
+            w->ready.clear();
+            w->sessions = 0;
+        }
+
+        for (std::set<IOSession *>::iterator it = list.begin(); it != list.end(); ++it) {
+            IOSession *s = *it;
+
+            close(s->rx.fd);
+            s->ring->close();
+
+            delete s;
+        }
+    }
+}
+
+/**
+ * Add a newly accepted router session
+ *
+ * \param [in,out] thr      Thread management entry of the accepted router
+ *
+ * \throws (const char *) on error.
+ */
+void IOEngine::addSession(ThreadMgmt *thr) {
+    fcntl(thr->client.c_sock, F_SETFL, fcntl(thr->client.c_sock, F_GETFL) | O_NONBLOCK);
+
+    IOSession *s = new IOSession;
+    s->rx.sess = s;
+    s->rx.fd = thr->client.c_sock;
+
+    snprintf(s->c_ip, sizeof(s->c_ip), "%s", thr->client.c_ip);
+
+    // Pick the I/O thread with the least sessions
+    IOWorker *w = workers[0];
+    for (size_t i = 1; i < workers.size(); i++) {
+        if (workers[i]->sessions < w->sessions)
+            w = workers[i];
+    }
+
+    // The router's memory and reader thread follow the node of its I/O thread
+    thr->client.numa_node = w->node;
+
+    s->ring = std::make_shared<RingBuffer>(cfg->bmp_buffer_size, cfg->bmp_buffer_max_size, w->node);
+    if (cfg->bmp_spool_size > 0 and not s->ring->enableSpool(cfg->bmp_spool_dir, cfg->bmp_spool_size))
+        LOG_WARN("%s: Unable to create spool file in %s: %s, buffering in memory only",
+                 s->c_ip, cfg->bmp_spool_dir.c_str(), strerror(errno));
+    s->rx_eof = false;
+    s->rx_watched = true;
+    s->paused = false;
+    s->closed = false;
+
+    thr->client.ring = s->ring;
+
+    // Parser wakes the I/O thread when it frees space in a full ring or closes it
+    s->ring->setNotify([this, w, s] { wakeSession(w, s); });
+
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = &s->rx;
+
+    {
+        // Registered under the lock so a wakeup can't pick up a session that is undone below
+        std::lock_guard<std::mutex> guard(w->lock);
+        w->session_set.insert(s);
+
+        if (epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, s->rx.fd, &ev) < 0) {
+            LOG_ERR("%s: sock=%d cannot be added to epoll: %s", s->c_ip, s->rx.fd, strerror(errno));
+            w->session_set.erase(s);
+            s->rx_watched = false;
+        } else
+            ++w->sessions;
+    }
+
+    if (not s->rx_watched) {
+        s->ring->close();
+        thr->client.ring.reset();
+        delete s;
+
+        throw "ERROR: IOEngine cannot add router socket to epoll";
+    }
+
+    SELF_DEBUG("%s: sock=%d added to I/O thread with %d sessions", s->c_ip, s->rx.fd, (int)w->sessions);
+}
+
+/**
+ * I/O thread loop
+ *
+ * \param [in] w        Worker that the thread runs
+ */
+void IOEngine::workerLoop(IOWorker *w) {
+    epoll_event events[IO_ENGINE_MAX_EVENTS];
+    std::vector<IOSession *> closed;
+
+    MemPolicy::bindThread(w->node);
+
+    while (running) {
+        int n = epoll_wait(w->epoll_fd, events, IO_ENGINE_MAX_EVENTS, -1);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+
+            LOG_ERR("I/O thread epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) {
+                uint64_t value;
+                read(w->wake_fd, &value, sizeof(value));
+
+                if (running)
+                    checkSessions(w, closed);
+                continue;
+            }
+
+            IOEndpoint *ep = static_cast<IOEndpoint *>(events[i].data.ptr);
+            IOSession *s = ep->sess;
+
+            if (s->closed)
+                continue;
+
+            readRouter(s);
+            updateSession(w, s);
+        }
+
+        // Sessions are freed after the batch since the batch can have more events for them
+        for (size_t i = 0; i < closed.size(); i++)
+            delete closed[i];
+        closed.clear();
+    }
+}
+
+/**
+ * Check the sessions queued to the worker after a wakeup
+ *
+ *  Only the sessions queued by their parser or by drain() are checked.  A session can
+ *  be queued more than once, or after it was closed, so sessions the worker no
+ *  longer owns are skipped.
+ *
+ * \param [in] w        Worker that was woken up
+ * \param [out] closed  Updated with the sessions that were closed
+ */
+void IOEngine::checkSessions(IOWorker *w, std::vector<IOSession *> &closed) {
+    std::vector<IOSession *> list;
+
+    {
+        std::lock_guard<std::mutex> guard(w->lock);
+        list.swap(w->ready);
+
+        size_t n = 0;
+        for (size_t i = 0; i < list.size(); i++) {
+            if (w->session_set.count(list[i]) > 0)
+                list[n++] = list[i];
+        }
+        list.resize(n);
+    }
+
+    for (size_t i = 0; i < list.size(); i++) {
+        IOSession *s = list[i];
+
+        // Closed by an earlier entry of the list
+        if (s->closed)
+            continue;
+
+        if (s->ring->isReadClosed()) {
+            closeSession(w, s);
+            closed.push_back(s);
+
+        } else if (draining and not s->rx_eof) {
+            // Shutting down, the parser gets end of stream after what is buffered
+            s->rx_eof = true;
+            updateSession(w, s);
+
+        } else if (s->paused) {
+            readRouter(s);
+            updateSession(w, s);
+        }
+    }
+}
+
+/**
+ * Queue a session to be checked by its I/O thread and wake the thread
+ *
+ * \param [in] w        Worker owning the session
+ * \param [in] s        Session to check
+ */
+void IOEngine::wakeSession(IOWorker *w, IOSession *s) {
+    bool wake;
+
+    {
+        std::lock_guard<std::mutex> guard(w->lock);
+        wake = w->ready.empty();
+        w->ready.push_back(s);
+    }
+
+    // The thread hasn't picked up the queue yet if it wasn't empty, it was already woken
+    if (wake) {
+        uint64_t value = 1;
+        write(w->wake_fd, &value, sizeof(value));
+    }
+}
+
+/**
+ * Read available data from the router socket into the ring buffer
+ *
+ * \param [in] s        Session to read
+ */
+void IOEngine::readRouter(IOSession *s) {
+    unsigned char *ptr;
+    size_t space;
+
+    while (not s->rx_eof and (space = s->ring->writeSpace(&ptr)) > 0) {
+        ssize_t bytes_read = read(s->rx.fd, ptr, space);
+
+        if (bytes_read > 0) {
+            s->ring->commitWrite(bytes_read);
+
+            if ((size_t)bytes_read < space)
+                break;                      // Socket has been drained
+
+        } else if (bytes_read == 0) {
+            LOG_INFO("%s: sock=%d: Router closed the connection", s->c_ip, s->rx.fd);
+            s->rx_eof = true;
+
+        } else if (errno == EINTR) {
+            continue;
+
+        } else if (errno == EAGAIN or errno == EWOULDBLOCK) {
+            break;
+
+        } else {
+            LOG_INFO("%s: sock=%d: Read error: %s", s->c_ip, s->rx.fd, strerror(errno));
+            s->rx_eof = true;
+        }
+    }
+}
+
+/**
+ * Add or remove the router socket of a session to/from epoll
+ *
+ *  A socket registered without events still reports errors and hang ups, so the
+ *  socket is removed from epoll instead while it must not be read.
+ *
+ * \param [in] w        Worker owning the session
+ * \param [in] s        Session to update
+ * \param [in] watch    True to watch the socket, false to stop watching it
+ */
+void IOEngine::watchRouter(IOWorker *w, IOSession *s, bool watch) {
+    if (s->rx_watched == watch)
+        return;
+
+    if (not watch) {
+        epoll_ctl(w->epoll_fd, EPOLL_CTL_DEL, s->rx.fd, NULL);
+        s->rx_watched = false;
+        return;
+    }
+
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = &s->rx;
+
+    if (epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, s->rx.fd, &ev) < 0) {
+        // The socket can't be read anymore, end the stream
+        LOG_ERR("%s: sock=%d cannot be added to epoll: %s", s->c_ip, s->rx.fd, strerror(errno));
+        s->rx_eof = true;
+        return;
+    }
+
+    s->rx_watched = true;
+}
+
+/**
+ * Re-evaluate the events the session needs based on its ring state
+ *
+ *  The router socket is only read while there is ring space, which pushes back on
+ *  the router TCP window the same way the client thread did when its buffer was full.
+ *  When the ring is full, the socket isn't watched until the parser wakes the I/O
+ *  thread once it frees space.
+ *
+ * \param [in] w        Worker owning the session
+ * \param [in] s        Session to update
+ */
+void IOEngine::updateSession(IOWorker *w, IOSession *s) {
+    unsigned char *ptr;
+
+    if (not s->rx_eof) {
+        if (s->ring->writeSpace(&ptr) == 0) {
+            s->ring->requestSpaceNotify();
+
+            // Space could have been freed before the notify was requested
+            if (s->ring->writeSpace(&ptr) == 0) {
+                s->paused = true;
+                watchRouter(w, s, false);
+                return;
+            }
+        }
+
+        s->paused = false;
+        watchRouter(w, s, true);
+
+        if (not s->rx_eof)
+            return;
+    }
+
+    s->paused = false;
+
+    // Router socket stays open until the parser is done with it, just stop watching it
+    watchRouter(w, s, false);
+
+    // Parser gets end of stream once it has consumed what is buffered
+    if (not s->ring->isWriteClosed())
+        s->ring->closeWrite();
+}
+
+/**
+ * Close the session.  Called once the parser has closed the ring.
+ *
+ *  The parser thread is done with the router socket once it closed the ring, so the
+ *  socket is closed here.  The session memory is freed by the caller.
+ *
+ * \param [in] w        Worker owning the session
+ * \param [in] s        Session to close
+ */
+void IOEngine::closeSession(IOWorker *w, IOSession *s) {
+    SELF_DEBUG("%s: sock=%d: closing I/O session", s->c_ip, s->rx.fd);
+
+    if (s->rx_watched)
+        epoll_ctl(w->epoll_fd, EPOLL_CTL_DEL, s->rx.fd, NULL);
+
+    close(s->rx.fd);
+
+    s->ring.reset();
+    s->closed = true;
+
+    std::lock_guard<std::mutex> guard(w->lock);
+    w->session_set.erase(s);
+    --w->sessions;
+}
+
+/*
+ * Enable/Disable debug
+ */
+void IOEngine::enableDebug() {
+    debug = true;
+}
+
+void IOEngine::disableDebug() {
+    debug = false;
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#ifndef IOENGINE_H_
+#define IOENGINE_H_
+
+#include "client_thread.h"
+#include "Logger.h"
+#include "Config.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#define IO_ENGINE_MAX_EVENTS    128         ///< Max number of epoll events handled per wakeup
+
+/**
+ * \class   IOEngine
+ *
+ * \brief   Event driven (epoll) router socket ingest
+ * \details A small fixed pool of I/O threads owns all router sockets.  Each router
+ *          socket is read directly into the per router ring buffer, which the parser
+ *          (BMPReader) consumes.  Nothing is polled on a timer, threads only wake when
+ *          a socket has data or when a parser frees space in (or closes) a full ring.
+ */
+class IOEngine {
+public:
+    /**
+     * Class constructor
+     *
+     *  \param [in] logPtr  Pointer to existing Logger for app logging
+     *  \param [in] config  Pointer to the loaded configuration
+     *
+     *  \throws (const char *) on error.
+     */
+    IOEngine(Logger *logPtr, Config *config);
+
+    virtual ~IOEngine();
+
+    /**
+     * Add a newly accepted router session
+     *
+     * \details The ring buffer used to feed the parser is created and set in the
+     *          client info.  The router socket is handed to the I/O thread with the
+     *          least number of sessions.
+     *
+     * \param [in,out] thr      Thread management entry of the accepted router
+     *
+     * \throws (const char *) on error.
+     */
+    virtual void addSession(ThreadMgmt *thr);
+
+    /**
+     * Stop reading all routers, used on shutdown
+     *
+     * \details The rings of all sessions are closed for writing, so the parsers end
+     *          once they consumed what is buffered.  Sessions are closed as usual once
+     *          their parser closed the ring.
+     */
+    virtual void drain();
+
+    /**
+     * Stop all I/O threads and release all remaining sessions
+     */
+    virtual void stop();
+
+    // Debug methods
+    void enableDebug();
+    void disableDebug();
+
+public:
+    Logger      *logger;                    ///< Logging class pointer
+
+protected:
+    Config      *cfg;                       ///< Config pointer
+    bool        debug;                      ///< debug flag to indicate debugging
+    std::atomic<bool> running;              ///< False once stop() has been called
+    std::atomic<bool> draining;             ///< True once drain() has been called
+
+    /**
+     * Constructor for engines that derive from this class
+     *
+     *  \param [in] logPtr          Pointer to existing Logger for app logging
+     *  \param [in] config          Pointer to the loaded configuration
+     *  \param [in] start_workers   True to start the epoll I/O threads
+     *
+     *  \throws (const char *) on error.
+     */
+    IOEngine(Logger *logPtr, Config *config, bool start_workers);
+
+private:
+    struct IOSession;
+
+    /**
+     * Epoll registration for a socket of a session; the epoll data pointer
+     * references this so that the owning session is known.
+     */
+    struct IOEndpoint {
+        IOSession       *sess;              ///< Session the socket belongs to
+        int             fd;                 ///< Socket file descriptor
+    };
+
+    /**
+     * Per router session state, owned by a single I/O thread after it's added
+     */
+    struct IOSession {
+        IOEndpoint      rx;                 ///< Router socket (read)
+
+        char            c_ip[46];           ///< Printed form of the router address, for logging
+
+        std::shared_ptr<RingBuffer> ring;   ///< Ring buffer shared with the parser
+
+        bool            rx_eof;             ///< True if the router closed the connection or errored
+        bool            rx_watched;         ///< True while the router socket is registered with epoll
+        bool            paused;             ///< True while reading is paused because the ring is full, not watched
+        bool            closed;             ///< True once closed, freed after the current event batch
+    };
+
+    /**
+     * I/O thread
+     */
+    struct IOWorker {
+        int                     epoll_fd;   ///< Epoll instance of the thread
+        int                     wake_fd;    ///< eventfd used to wake the thread (stop, ring space/close)
+        std::thread             *thr;       ///< Thread running workerLoop()
+        int                     node;       ///< NUMA node the thread runs on, -1 for any
+        std::atomic<int>        sessions;   ///< Number of sessions owned by the thread
+        std::mutex              lock;       ///< Protects session_set and ready
+        std::set<IOSession *>   session_set;///< Sessions owned by the thread
+        std::vector<IOSession *> ready;     ///< Sessions to check, queued by their parser or drain(), can be stale
+    };
+
+    std::vector<IOWorker *> workers;        ///< I/O threads
+
+    /**
+     * I/O thread loop
+     *
+     * \param [in] w        Worker that the thread runs
+     */
+    void workerLoop(IOWorker *w);
+
+    /**
+     * Check the sessions queued to the worker after a wakeup
+     *
+     * \param [in] w        Worker that was woken up
+     * \param [out] closed  Updated with the sessions that were closed
+     */
+    void checkSessions(IOWorker *w, std::vector<IOSession *> &closed);
+
+    /**
+     * Queue a session to be checked by its I/O thread and wake the thread
+     *
+     * \details Called by the parser when it frees space in a full ring or closes it.
+     *          The session is not accessed, the I/O thread can free it once the ring
+     *          is closed.
+     *
+     * \param [in] w        Worker owning the session
+     * \param [in] s        Session to check
+     */
+    void wakeSession(IOWorker *w, IOSession *s);
+
+    /**
+     * Read available data from the router socket into the ring buffer
+     *
+     * \param [in] s        Session to read
+     */
+    void readRouter(IOSession *s);
+
+    /**
+     * Add or remove the router socket of a session to/from epoll
+     *
+     * \param [in] w        Worker owning the session
+     * \param [in] s        Session to update
+     * \param [in] watch    True to watch the socket, false to stop watching it
+     */
+    void watchRouter(IOWorker *w, IOSession *s, bool watch);
+
+    /**
+     * Re-evaluate the events the session needs based on its buffer state
+     *
+     * \param [in] w        Worker owning the session
+     * \param [in] s        Session to update
+     */
+    void updateSession(IOWorker *w, IOSession *s);
+
+    /**
+     * Close the session.  Called once the parser has closed the ring.
+     *
+     * \param [in] w        Worker owning the session
+     * \param [in] s        Session to close
+     */
+    void closeSession(IOWorker *w, IOSession *s);
+};
+
+#endif /* IOENGINE_H_ */
@@ -0,0 +1,667 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#include <sys/eventfd.h>
+#include <sys/utsname.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+
+#include "IOUringEngine.h"
+#include "MemPolicy.h"
+
+/**
+ * User data of receive cancel completions, which are ignored
+ */
+static char cancel_tag;
+
+/**
+ * Class constructor
+ *
+ *  \param [in] logPtr  Pointer to existing Logger for app logging
+ *  \param [in] config  Pointer to the loaded configuration
+ *
+ *  \throws (const char *) on error.
+ */
+IOUringEngine::IOUringEngine(Logger *logPtr, Config *config) : IOEngine(logPtr, config, false) {
+    int ret;
+
+    for (int i = 0; i < cfg->io_threads; i++) {
+        UringWorker *w = new UringWorker;
+        w->sessions = 0;
+        w->thr = NULL;
+        w->node = MemPolicy::workerNode(i);
+
+        if (io_uring_queue_init(IO_URING_ENTRIES, &w->uring, 0) < 0) {
+            delete w;
+            throw "ERROR: IOUringEngine cannot create io_uring instance";
+        }
+
+        w->buf_ring = io_uring_setup_buf_ring(&w->uring, IO_URING_BUF_COUNT, IO_URING_BUF_GROUP, 0, &ret);
+        if (w->buf_ring == NULL) {
+            io_uring_queue_exit(&w->uring);
+            delete w;
+            throw "ERROR: IOUringEngine cannot register receive buffers";
+        }
+
+        if ((w->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+            io_uring_free_buf_ring(&w->uring, w->buf_ring, IO_URING_BUF_COUNT, IO_URING_BUF_GROUP);
+            io_uring_queue_exit(&w->uring);
+            delete w;
+            throw "ERROR: IOUringEngine cannot create eventfd";
+        }
+
+        // Hand all receive buffers to the kernel
+        w->bufs = MemPolicy::alloc(IO_URING_BUF_COUNT * IO_URING_BUF_SIZE, w->node);
+        if (w->bufs == NULL) {
+            close(w->wake_fd);
+            io_uring_free_buf_ring(&w->uring, w->buf_ring, IO_URING_BUF_COUNT, IO_URING_BUF_GROUP);
+            io_uring_queue_exit(&w->uring);
+            delete w;
+            throw "ERROR: IOUringEngine cannot allocate receive buffers";
+        }
+
+        for (int bid = 0; bid < IO_URING_BUF_COUNT; bid++)
+            io_uring_buf_ring_add(w->buf_ring, w->bufs + bid * IO_URING_BUF_SIZE, IO_URING_BUF_SIZE, bid,
+                                  io_uring_buf_ring_mask(IO_URING_BUF_COUNT), bid);
+        io_uring_buf_ring_advance(w->buf_ring, IO_URING_BUF_COUNT);
+        w->bufs_free = IO_URING_BUF_COUNT;
+
+        armWake(w);
+
+        uring_workers.push_back(w);
+        w->thr = new std::thread(&IOUringEngine::workerLoop, this, w);
+    }
+
+    LOG_INFO("io_uring I/O engine started with %d threads", cfg->io_threads);
+}
+
+/**
+ * Destructor
+ */
+IOUringEngine::~IOUringEngine() {
+    stop();
+
+    for (size_t i = 0; i < uring_workers.size(); i++) {
+        UringWorker *w = uring_workers[i];
+
+        io_uring_free_buf_ring(&w->uring, w->buf_ring, IO_URING_BUF_COUNT, IO_URING_BUF_GROUP);
+        io_uring_queue_exit(&w->uring);
+        close(w->wake_fd);
+
+        MemPolicy::release(w->bufs, IO_URING_BUF_COUNT * IO_URING_BUF_SIZE);
+        delete w;
+    }
+    uring_workers.clear();
+}
+
+/**
+ * Check if the kernel supports what the engine needs
+ *
+ * \return true if supported, false if the epoll engine should be used instead
+ */
+bool IOUringEngine::isSupported() {
+    struct utsname uts;
+    int major = 0, minor = 0;
+
+    // Multishot receive was added in 6.0, older kernels fail it on the first completion
+    if (uname(&uts) != 0 or sscanf(uts.release, "%d.%d", &major, &minor) != 2 or major < 6)
+        return false;
+
+    struct io_uring uring;
+    if (io_uring_queue_init(8, &uring, 0) < 0)
+        return false;
+
+    bool supported = false;
+    int ret;
+
+    struct io_uring_buf_ring *buf_ring = io_uring_setup_buf_ring(&uring, 1, IO_URING_BUF_GROUP, 0, &ret);
+    if (buf_ring != NULL) {
+        io_uring_free_buf_ring(&uring, buf_ring, 1, IO_URING_BUF_GROUP);
+        supported = true;
+    }
+
+    io_uring_queue_exit(&uring);
+
+    return supported;
+}
+
+/**
+ * Stop reading all routers, used on shutdown
+ */
+void IOUringEngine::drain() {
+    if (draining.exchange(true))
+        return;
+
+    // The sessions are owned by the I/O threads, they stop receiving on the wakeup
+    uint64_t wake = 1;
+    for (size_t i = 0; i < uring_workers.size(); i++) {
+        UringWorker *w = uring_workers[i];
+
+        {
+            std::lock_guard<std::mutex> guard(w->lock);
+            w->ready.insert(w->ready.end(), w->session_set.begin(), w->session_set.end());
+        }
+
+        write(w->wake_fd, &wake, sizeof(wake));
+    }
+}
+
+/**
+ * Stop all I/O threads and release all remaining sessions
+ */
+void IOUringEngine::stop() {
+    if (not running.exchange(false))
+        return;
+
+    uint64_t wake = 1;
+    for (size_t i = 0; i < uring_workers.size(); i++)
+        write(uring_workers[i]->wake_fd, &wake, sizeof(wake));
+
+    for (size_t i = 0; i < uring_workers.size(); i++) {
+        UringWorker *w = uring_workers[i];
+
+        if (w->thr != NULL) {
+            if (w->thr->joinable())
+                w->thr->join();
+
+            delete w->thr;
+            w->thr = NULL;
+        }
+
+        // Closing the ring notifies the worker, which takes the lock
+        std::set<UringSession *> list;
+        {
+            std::lock_guard<std::mutex> guard(w->lock);
+            list.swap(w->session_set);
+            list.insert(w->new_sessions.begin(), w->new_sessions.end());
+            w->new_sessions.clear();
+            w->ready.clear();
+            w->sessions = 0;
+        }
+        w->starved.clear();
+
+        for (std::set<UringSession *>::iterator it = list.begin(); it != list.end(); ++it) {
+            UringSession *s = *it;
+
+            close(s->fd);
+            s->ring->close();
+
+            delete s;
+        }
+    }
+}
+
+/**
+ * Add a newly accepted router session
+ *
+ * \param [in,out] thr      Thread management entry of the accepted router
+ */
+void IOUringEngine::addSession(ThreadMgmt *thr) {
+    UringSession *s = new UringSession;
+    s->fd = thr->client.c_sock;
+
+    snprintf(s->c_ip, sizeof(s->c_ip), "%s", thr->client.c_ip);
+
+    // Pick the I/O thread with the least sessions
+    UringWorker *w = uring_workers[0];
+    for (size_t i = 1; i < uring_workers.size(); i++) {
+        if (uring_workers[i]->sessions < w->sessions)
+            w = uring_workers[i];
+    }
+
+    // The router's memory and reader thread follow the node of its I/O thread
+    thr->client.numa_node = w->node;
+
+    s->ring = std::make_shared<RingBuffer>(cfg->bmp_buffer_size, cfg->bmp_buffer_max_size, w->node);
+    if (cfg->bmp_spool_size > 0 and not s->ring->enableSpool(cfg->bmp_spool_dir, cfg->bmp_spool_size))
+        LOG_WARN("%s: Unable to create spool file in %s: %s, buffering in memory only",
+                 s->c_ip, cfg->bmp_spool_dir.c_str(), strerror(errno));
+    s->recv_armed = false;
+    s->canceling = false;
+    s->rx_eof = false;
+    s->paused = false;
+    s->closing = false;
+
+    thr->client.ring = s->ring;
+
+    // Parser wakes the I/O thread when it frees space in a full ring or closes it
+    s->ring->setNotify([this, w, s] { wakeSession(w, s); });
+
+    {
+        std::lock_guard<std::mutex> guard(w->lock);
+        w->new_sessions.push_back(s);
+        ++w->sessions;
+    }
+
+    // Only the I/O thread submits to its io_uring, wake it to arm the receive
+    uint64_t wake = 1;
+    write(w->wake_fd, &wake, sizeof(wake));
+
+    SELF_DEBUG("%s: sock=%d added to io_uring I/O thread with %d sessions", s->c_ip, s->fd, (int)w->sessions);
+}
+
+/**
+ * I/O thread loop
+ *
+ * \param [in] w        Worker that the thread runs
+ */
+void IOUringEngine::workerLoop(UringWorker *w) {
+    struct io_uring_cqe *cqes[IO_URING_CQE_BATCH];
+
+    MemPolicy::bindThread(w->node);
+
+    while (running) {
+        int ret = io_uring_submit_and_wait(&w->uring, 1);
+
+        if (ret < 0 and ret != -EINTR) {
+            LOG_ERR("I/O thread io_uring wait failed: %s", strerror(-ret));
+            break;
+        }
+
+        unsigned n = io_uring_peek_batch_cqe(&w->uring, cqes, IO_URING_CQE_BATCH);
+        bool woken = false;
+
+        for (unsigned i = 0; i < n; i++) {
+            void *data = io_uring_cqe_get_data(cqes[i]);
+
+            if (data == NULL) {
+                woken = true;
+
+                if (not (cqes[i]->flags & IORING_CQE_F_MORE))
+                    armWake(w);
+
+            } else if (data != &cancel_tag) {
+                handleRecv(w, static_cast<UringSession *>(data), cqes[i]);
+            }
+        }
+
+        io_uring_cq_advance(&w->uring, n);
+
+        if (woken and running) {
+            uint64_t value;
+            read(w->wake_fd, &value, sizeof(value));
+
+            checkSessions(w);
+        }
+
+        // Re-arm sessions that ran out of receive buffers now that some are free again
+        if (w->bufs_free > 0 and not w->starved.empty()) {
+            std::vector<UringSession *> list;
+            list.swap(w->starved);
+
+            for (size_t i = 0; i < list.size(); i++) {
+                UringSession *s = list[i];
+
+                if (not s->recv_armed and not s->paused and not s->rx_eof and not s->closing)
+                    armRecv(w, s);
+            }
+        }
+    }
+}
+
+/**
+ * Get a submission queue entry, submitting queued entries if the queue is full
+ *
+ * \param [in] w        Worker owning the io_uring
+ *
+ * \return submission queue entry, never NULL
+ */
+struct io_uring_sqe *IOUringEngine::getSqe(UringWorker *w) {
+    struct io_uring_sqe *sqe;
+
+    while ((sqe = io_uring_get_sqe(&w->uring)) == NULL)
+        io_uring_submit(&w->uring);
+
+    return sqe;
+}
+
+/**
+ * Arm the wake eventfd poll
+ *
+ * \param [in] w        Worker to arm
+ */
+void IOUringEngine::armWake(UringWorker *w) {
+    struct io_uring_sqe *sqe = getSqe(w);
+
+    // A NULL data pointer identifies the wake event
+    io_uring_prep_poll_multishot(sqe, w->wake_fd, POLLIN);
+    io_uring_sqe_set_data(sqe, NULL);
+}
+
+/**
+ * Arm the multishot receive of the session
+ *
+ * \param [in] w        Worker owning the session
+ * \param [in] s        Session to arm
+ */
+void IOUringEngine::armRecv(UringWorker *w, UringSession *s) {
+    struct io_uring_sqe *sqe = getSqe(w);
+
+    // Kernel picks a buffer from the registered buffer ring for each completion
+    io_uring_prep_recv_multishot(sqe, s->fd, NULL, 0, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = IO_URING_BUF_GROUP;
+    io_uring_sqe_set_data(sqe, s);
+
+    s->recv_armed = true;
+}
+
+/**
+ * Cancel the multishot receive of the session
+ *
+ * \param [in] w        Worker owning the session
+ * \param [in] s        Session to cancel
+ */
+void IOUringEngine::cancelRecv(UringWorker *w, UringSession *s) {
+    if (not s->recv_armed or s->canceling)
+        return;
+
+    struct io_uring_sqe *sqe = getSqe(w);
+
+    io_uring_prep_cancel(sqe, s, 0);
+    io_uring_sqe_set_data(sqe, &cancel_tag);
+
+    s->canceling = true;
+}
+
+/**
+ * Handle a receive completion
+ *
+ * \param [in] w        Worker owning the session
+ * \param [in] s        Session of the completion
+ * \param [in] cqe      Completion
+ */
+void IOUringEngine::handleRecv(UringWorker *w, UringSession *s, struct io_uring_cqe *cqe) {
+    int res = cqe->res;
+
+    if (not (cqe->flags & IORING_CQE_F_MORE)) {
+        s->recv_armed = false;
+        s->canceling = false;
+    }
+
+    if (res > 0) {
+        unsigned short bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        unsigned char *buf = w->bufs + bid * IO_URING_BUF_SIZE;
+
+        --w->bufs_free;
+
+        if (s->closing or s->rx_eof) {
+            // Received after the session stopped reading (drain), it's not passed on
+            recycleBuffer(w, bid);
+
+        } else if (not s->pending.empty()) {
+            // Data received before the cancel took effect, keep it in order
+            PendingData p = { bid, 0, (uint32_t)res };
+            s->pending.push_back(p);
+
+        } else {
+            size_t written = writeRing(s, buf, res);
+
+            if (written == (size_t)res) {
+                recycleBuffer(w, bid);
+
+            } else {
+                PendingData p = { bid, (uint32_t)written, (uint32_t)(res - written) };
+                s->pending.push_back(p);
+
+                pauseSession(w, s);
+            }
+        }
+
+    } else if (res == 0) {
+        LOG_INFO("%s: sock=%d: Router closed the connection", s->c_ip, s->fd);
+        s->rx_eof = true;
+
+    } else if (res == -ENOBUFS) {
+        // All receive buffers are in use, the receive is re-armed once one is recycled
+        w->starved.push_back(s);
+
+    } else if (res != -ECANCELED) {
+        LOG_INFO("%s: sock=%d: Read error: %s", s->c_ip, s->fd, strerror(-res));
+        s->rx_eof = true;
+    }
+
+    if (s->closing) {
+        closeSession(w, s);
+        return;
+    }
+
+    if (s->rx_eof) {
+        // Parser gets end of stream once it has consumed what is buffered
+        if (s->pending.empty())
+            s->ring->closeWrite();
+
+    } else if (not s->recv_armed and not s->paused and res != -ENOBUFS) {
+        // Receive ended without being paused (canceled after a resume or the completion queue overflowed)
+        armRecv(w, s);
+    }
+}
+
+/**
+ * Check the new sessions and the sessions queued to the worker after a wakeup
+ *
+ *  Only the sessions queued by their parser or by drain() are checked, new sessions
+ *  are armed.  A session can be queued more than once, or after it was freed, so the
+ *  queue is deduplicated and sessions the worker no longer owns are skipped.
+ *
+ * \param [in] w        Worker that was woken up
+ */
+void IOUringEngine::checkSessions(UringWorker *w) {
+    std::vector<UringSession *> added;
+    std::vector<UringSession *> list;
+
+    {
+        std::lock_guard<std::mutex> guard(w->lock);
+        added.swap(w->new_sessions);
+        w->session_set.insert(added.begin(), added.end());
+
+        list.swap(w->ready);
+
+        // Sessions added while draining are stopped right away
+        if (draining)
+            list.insert(list.end(), added.begin(), added.end());
+
+        std::sort(list.begin(), list.end());
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+
+        size_t n = 0;
+        for (size_t i = 0; i < list.size(); i++) {
+            if (w->session_set.count(list[i]) > 0)
+                list[n++] = list[i];
+        }
+        list.resize(n);
+    }
+
+    for (size_t i = 0; i < added.size(); i++)
+        armRecv(w, added[i]);
+
+    for (size_t i = 0; i < list.size(); i++) {
+        UringSession *s = list[i];
+
+        if (s->closing)
+            continue;
+
+        if (s->ring->isReadClosed()) {
+            s->closing = true;
+            closeSession(w, s);
+
+        } else if (draining and not s->rx_eof) {
+            // Shutting down, the parser gets end of stream after what is pending
+            s->rx_eof = true;
+            cancelRecv(w, s);
+
+            if (not s->paused)
+                s->ring->closeWrite();
+
+        } else if (s->paused) {
+            drainPending(w, s);
+        }
+    }
+}
+
+/**
+ * Queue a session to be checked by its I/O thread and wake the thread
+ *
+ * \param [in] w        Worker owning the session
+ * \param [in] s        Session to check
+ */
+void IOUringEngine::wakeSession(UringWorker *w, UringSession *s) {
+    bool wake;
+
+    {
+        std::lock_guard<std::mutex> guard(w->lock);
+        wake = w->ready.empty();
+        w->ready.push_back(s);
+    }
+
+    // The thread hasn't picked up the queue yet if it wasn't empty, it was already woken
+    if (wake) {
+        uint64_t value = 1;
+        write(w->wake_fd, &value, sizeof(value));
+    }
+}
+
+/**
+ * Pause receiving because the ring buffer is full
+ *
+ * \param [in] w        Worker owning the session
+ * \param [in] s        Session to pause
+ */
+void IOUringEngine::pauseSession(UringWorker *w, UringSession *s) {
+    unsigned char *ptr;
+
+    s->paused = true;
+    cancelRecv(w, s);
+
+    s->ring->requestSpaceNotify();
+
+    // Space could have been freed before the notify was requested
+    if (s->ring->writeSpace(&ptr) > 0)
+        wakeSession(w, s);
+}
+
+/**
+ * Move pending data into the ring buffer and resume receiving if all fit
+ *
+ * \param [in] w        Worker owning the session
+ * \param [in] s        Session to drain
+ */
+void IOUringEngine::drainPending(UringWorker *w, UringSession *s) {
+    while (not s->pending.empty()) {
+        PendingData &p = s->pending.front();
+
+        size_t written = writeRing(s, w->bufs + p.bid * IO_URING_BUF_SIZE + p.offset, p.len);
+        p.offset += written;
+        p.len -= written;
+
+        if (p.len > 0) {
+            // Ring is full again
+            pauseSession(w, s);
+            return;
+        }
+
+        recycleBuffer(w, p.bid);
+        s->pending.pop_front();
+    }
+
+    s->paused = false;
+
+    if (s->rx_eof)
+        s->ring->closeWrite();
+    else if (not s->recv_armed)
+        armRecv(w, s);
+}
+
+/**
+ * Copy received data into the ring buffer
+ *
+ * \param [in] s        Session to copy to
+ * \param [in] data     Received data
+ * \param [in] len      Length of the data
+ *
+ * \return number of bytes copied, less than len if the ring is full
+ */
+size_t IOUringEngine::writeRing(UringSession *s, const unsigned char *data, size_t len) {
+    unsigned char *ptr;
+    size_t space;
+    size_t written = 0;
+
+    while (written < len and (space = s->ring->writeSpace(&ptr)) > 0) {
+        if (space > len - written)
+            space = len - written;
+
+        memcpy(ptr, data + written, space);
+        s->ring->commitWrite(space);
+
+        written += space;
+    }
+
+    return written;
+}
+
+/**
+ * Give a receive buffer back to the kernel
+ *
+ * \param [in] w        Worker owning the buffer
+ * \param [in] bid      Receive buffer ID
+ */
+void IOUringEngine::recycleBuffer(UringWorker *w, unsigned short bid) {
+    io_uring_buf_ring_add(w->buf_ring, w->bufs + bid * IO_URING_BUF_SIZE, IO_URING_BUF_SIZE, bid,
+                          io_uring_buf_ring_mask(IO_URING_BUF_COUNT), 0);
+    io_uring_buf_ring_advance(w->buf_ring, 1);
+
+    ++w->bufs_free;
+}
+
+/**
+ * Close the session if the parser closed the ring and nothing references it anymore
+ *
+ *  The parser thread is done with the router socket once it closed the ring.  The
+ *  session is only freed once the kernel ended the receive, since the receive
+ *  completions reference it.
+ *
+ * \param [in] w        Worker owning the session
+ * \param [in] s        Session to close
+ *
+ * \return true if the session was closed and freed
+ */
+bool IOUringEngine::closeSession(UringWorker *w, UringSession *s) {
+    if (s->recv_armed) {
+        cancelRecv(w, s);
+        return false;
+    }
+
+    SELF_DEBUG("%s: sock=%d: closing io_uring session", s->c_ip, s->fd);
+
+    close(s->fd);
+
+    while (not s->pending.empty()) {
+        recycleBuffer(w, s->pending.front().bid);
+        s->pending.pop_front();
+    }
+
+    w->starved.erase(std::remove(w->starved.begin(), w->starved.end(), s), w->starved.end());
+
+    s->ring.reset();
+
+    {
+        std::lock_guard<std::mutex> guard(w->lock);
+        w->session_set.erase(s);
+        --w->sessions;
+    }
+
+    delete s;
+
+    return true;
+}
@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#ifndef IOURINGENGINE_H_
+#define IOURINGENGINE_H_
+
+#include "IOEngine.h"
+
+#include <liburing.h>
+
+#include <deque>
+
+#define IO_URING_ENTRIES        1024        ///< Submission queue entries per I/O thread
+#define IO_URING_CQE_BATCH      256         ///< Max number of completions handled per wakeup
+#define IO_URING_BUF_COUNT      256         ///< Number of receive buffers per I/O thread, must be a power of 2
+#define IO_URING_BUF_SIZE       32768       ///< Size of each receive buffer
+#define IO_URING_BUF_GROUP      0           ///< Buffer group ID of the receive buffers
+
+/**
+ * \class   IOUringEngine
+ *
+ * \brief   io_uring router socket ingest
+ * \details Same model as IOEngine, a small fixed pool of I/O threads owns all router
+ *          sockets, but each router socket has a single multishot receive armed that
+ *          completes into buffers registered with the kernel.  Completions are
+ *          handled in batches and copied into the per router ring buffer.
+ *
+ *          When a ring buffer is full, the receive is canceled and the remaining data
+ *          is held in its receive buffer until the parser frees space, which pushes back
+ *          on the router TCP window the same way as the epoll engine.
+ */
+class IOUringEngine : public IOEngine {
+public:
+    /**
+     * Class constructor
+     *
+     *  \param [in] logPtr  Pointer to existing Logger for app logging
+     *  \param [in] config  Pointer to the loaded configuration
+     *
+     *  \throws (const char *) on error.
+     */
+    IOUringEngine(Logger *logPtr, Config *config);
+
+    virtual ~IOUringEngine();
+
+    /**
+     * Check if the kernel supports what the engine needs
+     *
+     * \details Multishot receive with a registered buffer ring requires Linux 6.0
+     *
+     * \return true if supported, false if the epoll engine should be used instead
+     */
+    static bool isSupported();
+
+    /**
+     * Add a newly accepted router session
+     *
+     * \details The ring buffer used to feed the parser is created and set in the
+     *          client info.  The session is handed to the I/O thread with the least
+     *          number of sessions, which arms the receive.
+     *
+     * \param [in,out] thr      Thread management entry of the accepted router
+     */
+    void addSession(ThreadMgmt *thr);
+
+    /**
+     * Stop reading all routers, used on shutdown
+     *
+     * \details The receives are canceled and the rings closed for writing once the
+     *          pending data is in them, so the parsers end after what is buffered.
+     */
+    void drain();
+
+    /**
+     * Stop all I/O threads and release all remaining sessions
+     */
+    void stop();
+
+private:
+    /**
+     * Received data that didn't fit in the ring buffer, still in its receive buffer
+     */
+    struct PendingData {
+        unsigned short  bid;                ///< Receive buffer ID
+        uint32_t        offset;             ///< Offset of the remaining data in the buffer
+        uint32_t        len;                ///< Length of the remaining data
+    };
+
+    /**
+     * Per router session state, owned by a single I/O thread after it's added
+     */
+    struct UringSession {
+        int             fd;                 ///< Router socket
+        char            c_ip[46];           ///< Printed form of the router address, for logging
+
+        std::shared_ptr<RingBuffer> ring;   ///< Ring buffer shared with the parser
+        std::deque<PendingData> pending;    ///< Received data waiting for ring space, in order
+
+        bool            recv_armed;         ///< True while the multishot receive is active
+        bool            canceling;          ///< True once the receive cancel is submitted, until it ended
+        bool            rx_eof;             ///< True if the router closed the connection or errored
+        bool            paused;             ///< True while receiving is paused because the ring is full
+        bool            closing;            ///< True once the parser closed, freed when the receive ended
+    };
+
+    /**
+     * I/O thread
+     */
+    struct UringWorker {
+        struct io_uring         uring;      ///< io_uring instance of the thread
+        struct io_uring_buf_ring *buf_ring; ///< Registered receive buffer ring
+        unsigned char           *bufs;      ///< Receive buffer memory
+        int                     bufs_free;  ///< Number of receive buffers owned by the kernel
+
+        int                     wake_fd;    ///< eventfd used to wake the thread (stop, new session, ring space/close)
+        std::thread             *thr;       ///< Thread running workerLoop()
+        int                     node;       ///< NUMA node the thread runs on, -1 for any
+        std::atomic<int>        sessions;   ///< Number of sessions owned by the thread
+
+        std::mutex              lock;       ///< Protects session_set, new_sessions and ready
+        std::set<UringSession *> session_set;   ///< Sessions owned by the thread
+        std::vector<UringSession *> new_sessions;   ///< Sessions added but not yet armed
+        std::vector<UringSession *> ready;          ///< Sessions to check, queued by their parser or drain(), can be stale
+        std::vector<UringSession *> starved;        ///< Sessions waiting for a receive buffer to be re-armed
+    };
+
+    std::vector<UringWorker *> uring_workers;   ///< I/O threads
+
+    /**
+     * I/O thread loop
+     *
+     * \param [in] w        Worker that the thread runs
+     */
+    void workerLoop(UringWorker *w);
+
+    /**
+     * Get a submission queue entry, submitting queued entries if the queue is full
+     *
+     * \param [in] w        Worker owning the io_uring
+     *
+     * \return submission queue entry, never NULL
+     */
+    struct io_uring_sqe *getSqe(UringWorker *w);
+
+    /**
+     * Arm the wake eventfd poll
+     *
+     * \param [in] w        Worker to arm
+     */
+    void armWake(UringWorker *w);
+
+    /**
+     * Arm the multishot receive of the session
+     *
+     * \param [in] w        Worker owning the session
+     * \param [in] s        Session to arm
+     */
+    void armRecv(UringWorker *w, UringSession *s);
+
+    /**
+     * Cancel the multishot receive of the session
+     *
+     * \param [in] w        Worker owning the session
+     * \param [in] s        Session to cancel
+     */
+    void cancelRecv(UringWorker *w, UringSession *s);
+
+    /**
+     * Handle a receive completion
+     *
+     * \param [in] w        Worker owning the session
+     * \param [in] s        Session of the completion
+     * \param [in] cqe      Completion
+     */
+    void handleRecv(UringWorker *w, UringSession *s, struct io_uring_cqe *cqe);
+
+    /**
+     * Check the new sessions and the sessions queued to the worker after a wakeup
+     *
+     * \param [in] w        Worker that was woken up
+     */
+    void checkSessions(UringWorker *w);
+
+    /**
+     * Queue a session to be checked by its I/O thread and wake the thread
+     *
+     * \details Called by the parser when it frees space in a full ring or closes it.
+     *          The session is not accessed, the I/O thread can free it once the ring
+     *          is closed.
+     *
+     * \param [in] w        Worker owning the session
+     * \param [in] s        Session to check
+     */
+    void wakeSession(UringWorker *w, UringSession *s);
+
+    /**
+     * Pause receiving because the ring buffer is full
+     *
+     * \param [in] w        Worker owning the session
+     * \param [in] s        Session to pause
+     */
+    void pauseSession(UringWorker *w, UringSession *s);
+
+    /**
+     * Move pending data into the ring buffer and resume receiving if all fit
+     *
+     * \param [in] w        Worker owning the session
+     * \param [in] s        Session to drain
+     */
+    void drainPending(UringWorker *w, UringSession *s);
+
+    /**
+     * Copy received data into the ring buffer
+     *
+     * \param [in] s        Session to copy to
+     * \param [in] data     Received data
+     * \param [in] len      Length of the data
+     *
+     * \return number of bytes copied, less than len if the ring is full
+     */
+    size_t writeRing(UringSession *s, const unsigned char *data, size_t len);
+
+    /**
+     * Give a receive buffer back to the kernel
+     *
+     * \param [in] w        Worker owning the buffer
+     * \param [in] bid      Receive buffer ID
+     */
+    void recycleBuffer(UringWorker *w, unsigned short bid);
+
+    /**
+     * Close the session if the parser closed the ring and nothing references it anymore
+     *
+     * \param [in] w        Worker owning the session
+     * \param [in] s        Session to close
+     *
+     * \return true if the session was closed and freed
+     */
+    bool closeSession(UringWorker *w, UringSession *s);
+};
+
+#endif /* IOURINGENGINE_H_ */
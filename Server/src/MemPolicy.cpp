@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#include "MemPolicy.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED      1               ///< Allocate on the node, fall back to others when it's full
+#endif
+
+#define MEM_MAX_NODES       1024            ///< Max node number supported by the node mask
+
+Logger *MemPolicy::logger = NULL;
+bool MemPolicy::debug = false;
+int MemPolicy::huge_pages = Config::HUGE_PAGES_NONE;
+std::vector<int> MemPolicy::nodes;
+std::vector<cpu_set_t> MemPolicy::node_cpus;
+std::atomic<unsigned int> MemPolicy::next_node(0);
+
+/**
+ * Read the NUMA topology and the allocation policy
+ *
+ *  \param [in] logPtr  Pointer to existing Logger for app logging
+ *  \param [in] config  Pointer to the loaded configuration
+ */
+void MemPolicy::setup(Logger *logPtr, Config *config) {
+    logger = logPtr;
+    debug = config->debug_general;
+    huge_pages = config->huge_pages;
+
+    nodes.clear();
+    node_cpus.clear();
+
+    if (not config->numa)
+        return;
+
+    DIR *dir = opendir("/sys/devices/system/node");
+    if (dir == NULL) {
+        LOG_WARN("NUMA placement is enabled, but the node topology is not available");
+        return;
+    }
+
+    dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        int node;
+        if (sscanf(ent->d_name, "node%d", &node) == 1 and node >= 0 and node < MEM_MAX_NODES)
+            nodes.push_back(node);
+    }
+    closedir(dir);
+
+    std::sort(nodes.begin(), nodes.end());
+
+    // Memory only nodes have no threads to place
+    for (size_t i = 0; i < nodes.size(); ) {
+        char path[128];
+        char list[4096] = { 0 };
+        cpu_set_t cpus;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", nodes[i]);
+
+        FILE *f = fopen(path, "r");
+        if (f != NULL) {
+            if (fgets(list, sizeof(list), f) == NULL)
+                list[0] = 0;
+            fclose(f);
+        }
+
+        if (parseCpuList(list, cpus) > 0) {
+            node_cpus.push_back(cpus);
+            i++;
+        } else
+            nodes.erase(nodes.begin() + i);
+    }
+
+    if (nodes.size() < 2) {
+        LOG_INFO("Single NUMA node, threads and buffers are not placed");
+        nodes.clear();
+        node_cpus.clear();
+        return;
+    }
+
+    LOG_INFO("Placing threads and buffers over %d NUMA nodes", (int)nodes.size());
+}
+
+/**
+ * Get the mapped size of a buffer, rounded to whole (huge) pages
+ *
+ * \param [in] size     Requested size in bytes
+ */
+size_t MemPolicy::mapSize(size_t size) {
+    size_t page = sysconf(_SC_PAGESIZE);
+
+    if (huge_pages != Config::HUGE_PAGES_NONE and size >= MEM_HUGE_PAGE_SIZE)
+        page = MEM_HUGE_PAGE_SIZE;
+
+    return (size + page - 1) / page * page;
+}
+
+/**
+ * Allocate a large buffer
+ *
+ * \param [in] size     Size in bytes
+ * \param [in] node     NUMA node to place the memory on, -1 for any
+ *
+ * \return buffer, NULL if out of memory
+ */
+unsigned char *MemPolicy::alloc(size_t size, int node) {
+    size_t len = mapSize(size);
+    void *ptr = MAP_FAILED;
+
+    if (huge_pages == Config::HUGE_PAGES_EXPLICIT and len % MEM_HUGE_PAGE_SIZE == 0) {
+        ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if (ptr == MAP_FAILED)
+            SELF_DEBUG("No explicit huge pages available for %zu bytes, using transparent huge pages", len);
+    }
+
+    if (ptr == MAP_FAILED) {
+        ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+            return NULL;
+
+        if (huge_pages != Config::HUGE_PAGES_NONE and len % MEM_HUGE_PAGE_SIZE == 0)
+            madvise(ptr, len, MADV_HUGEPAGE);
+    }
+
+    // Pages are placed on first touch, so binding before any write is enough
+    if (node >= 0 and node < MEM_MAX_NODES) {
+        unsigned long mask[MEM_MAX_NODES / (8 * sizeof(unsigned long))] = { 0 };
+        mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+
+        if (syscall(SYS_mbind, ptr, len, MPOL_PREFERRED, mask, MEM_MAX_NODES, 0) != 0)
+            SELF_DEBUG("Unable to bind %zu bytes to NUMA node %d: %s", len, node, strerror(errno));
+    }
+
+    return (unsigned char *)ptr;
+}
+
+/**
+ * Free a buffer from alloc()
+ *
+ * \param [in] ptr      Buffer, NULL is ignored
+ * \param [in] size     Size the buffer was allocated with
+ */
+void MemPolicy::release(unsigned char *ptr, size_t size) {
+    if (ptr != NULL)
+        munmap(ptr, mapSize(size));
+}
+
+/**
+ * Get the NUMA node of a worker thread
+ *
+ * \param [in] index    Index of the worker in its pool
+ *
+ * \return node, -1 if NUMA placement is disabled
+ */
+int MemPolicy::workerNode(int index) {
+    if (nodes.empty())
+        return -1;
+
+    return nodes[index % nodes.size()];
+}
+
+/**
+ * Get the NUMA node for a router not placed by an I/O thread, round robin
+ *
+ * \return node, -1 if NUMA placement is disabled
+ */
+int MemPolicy::nextNode() {
+    if (nodes.empty())
+        return -1;
+
+    return nodes[next_node++ % nodes.size()];
+}
+
+/**
+ * Bind the calling thread to the CPUs of a NUMA node
+ *
+ * \details Threads started by the calling thread inherit the binding.
+ *
+ * \param [in] node     NUMA node, -1 to leave the thread unbound
+ */
+void MemPolicy::bindThread(int node) {
+    for (size_t i = 0; node >= 0 and i < nodes.size(); i++) {
+        if (nodes[i] != node)
+            continue;
+
+        int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &node_cpus[i]);
+        if (ret != 0)
+            LOG_WARN("Unable to bind thread to NUMA node %d: %s", node, strerror(ret));
+
+        break;
+    }
+}
+
+/**
+ * Parse a sysfs cpu list, such as "0-7,16-23"
+ *
+ * \param [in]  list    Printed cpu list
+ * \param [out] cpus    CPU set
+ *
+ * \return number of CPUs in the list
+ */
+int MemPolicy::parseCpuList(const char *list, cpu_set_t &cpus) {
+    const char *p = list;
+
+    CPU_ZERO(&cpus);
+
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+
+        if (end == p)
+            break;
+
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            p = end;
+        }
+
+        for (long cpu = first; cpu <= last and cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, &cpus);
+
+        if (*p != ',')
+            break;
+        p++;
+    }
+
+    return CPU_COUNT(&cpus);
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#ifndef MEMPOLICY_H_
+#define MEMPOLICY_H_
+
+#include "Logger.h"
+#include "Config.h"
+
+#include <sched.h>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#define MEM_HUGE_PAGE_SIZE      (2 * 1024 * 1024)   ///< Size of a (transparent) huge page
+
+/**
+ * \class   MemPolicy
+ *
+ * \brief   Allocation and placement policy for the ingest buffers and threads
+ * \details Large buffers (router rings, receive buffers) are mapped directly and backed by
+ *          transparent or explicit huge pages, per the memory.huge_pages config, to save
+ *          TLB misses on large RIB dumps.
+ *
+ *          With memory.numa enabled on a host with more than one NUMA node, the I/O and
+ *          parse threads are spread over the nodes and bound to the CPUs of their node.  A
+ *          router is placed on the node of its I/O thread, its ring is bound to that node and
+ *          its reader and parse work prefer the threads of that node.  Memory allocated by
+ *          those threads (parser state, messages) lands on the same node by first touch.
+ *
+ *          The topology is read from sysfs and memory is bound with the mbind system call,
+ *          so libnuma is not needed.  setup() must be called before any other thread starts.
+ */
+class MemPolicy {
+public:
+    /**
+     * Read the NUMA topology and the allocation policy
+     *
+     *  \param [in] logPtr  Pointer to existing Logger for app logging
+     *  \param [in] config  Pointer to the loaded configuration
+     */
+    static void setup(Logger *logPtr, Config *config);
+
+    /**
+     * Allocate a large buffer
+     *
+     * \param [in] size     Size in bytes
+     * \param [in] node     NUMA node to place the memory on, -1 for any
+     *
+     * \return buffer, NULL if out of memory
+     */
+    static unsigned char *alloc(size_t size, int node);
+
+    /**
+     * Free a buffer from alloc()
+     *
+     * \param [in] ptr      Buffer, NULL is ignored
+     * \param [in] size     Size the buffer was allocated with
+     */
+    static void release(unsigned char *ptr, size_t size);
+
+    /**
+     * Get the NUMA node of a worker thread
+     *
+     * \param [in] index    Index of the worker in its pool
+     *
+     * \return node, -1 if NUMA placement is disabled
+     */
+    static int workerNode(int index);
+
+    /**
+     * Get the NUMA node for a router not placed by an I/O thread, round robin
+     *
+     * \return node, -1 if NUMA placement is disabled
+     */
+    static int nextNode();
+
+    /**
+     * Bind the calling thread to the CPUs of a NUMA node
+     *
+     * \details Threads started by the calling thread inherit the binding.
+     *
+     * \param [in] node     NUMA node, -1 to leave the thread unbound
+     */
+    static void bindThread(int node);
+
+private:
+    static Logger   *logger;                ///< Logging class pointer
+    static bool     debug;                  ///< debug flag to indicate debugging
+    static int      huge_pages;             ///< Config::HUGE_PAGES_MODES of the large buffers
+    static std::vector<int> nodes;          ///< Node numbers with CPUs, empty if NUMA placement is disabled
+    static std::vector<cpu_set_t> node_cpus;    ///< CPUs of each entry in nodes
+    static std::atomic<unsigned int> next_node; ///< Round robin index for nextNode()
+
+    /**
+     * Get the mapped size of a buffer, rounded to whole (huge) pages
+     *
+     * \param [in] size     Requested size in bytes
+     */
+    static size_t mapSize(size_t size);
+
+    /**
+     * Parse a sysfs cpu list, such as "0-7,16-23"
+     *
+     * \param [in]  list    Printed cpu list
+     * \param [out] cpus    CPU set
+     *
+     * \return number of CPUs in the list
+     */
+    static int parseCpuList(const char *list, cpu_set_t &cpus);
+};
+
+#endif /* MEMPOLICY_H_ */
@@ -17,8 +17,12 @@
 #include <string>
 #include <cstdio>
 #include <ctime>
+#include <memory>
 #include <sys/time.h>
 
+#define MSGBUS_RAW_HEADROOM     256     ///< Bytes reserved in front of a raw BMP packet for message bus headers
+#define PREFIX_STR_LEN          46      ///< Max printed prefix length including the NUL, see prefix_toStr()
+
 /**
  * \class   MsgBusInterface
  *
@@ -230,7 +234,6 @@ public:
         u_char      path_attr_hash_id[16];  ///< path attrs hash_id
         u_char      peer_hash_id[16];       ///< BGP peer hash ID, need it here for withdraw routes support
         u_char      isIPv4;                 ///< 0 if IPv6, 1 if IPv4
-        char        prefix[46];             ///< IPv4/IPv6 prefix in printed form
         u_char      prefix_len;             ///< Length of prefix in bits
         uint8_t     prefix_bin[16];         ///< Prefix in binary form
         uint8_t     prefix_bcast_bin[16];   ///< Broadcast address/last address in binary form
@@ -276,6 +279,32 @@ public:
         VPN_ACTION_DEL,
     };
 
+    /**
+     * OBJECT: bmp_raw
+     *
+     * Raw BMP packet, shared by reference with the message bus so that it isn't copied
+     *
+     * \details The packet is stored after MSGBUS_RAW_HEADROOM bytes of headroom, which the
+     *          message bus can use to prefix its own headers in place.
+     */
+    struct obj_bmp_raw {
+        u_char      *buf;                   ///< Headroom followed by the packet
+        size_t      data_len;               ///< Length of the packet in bytes
+
+        obj_bmp_raw(size_t size) {
+            buf = new u_char[MSGBUS_RAW_HEADROOM + size];
+            data_len = 0;
+        }
+
+        ~obj_bmp_raw() {
+            delete [] buf;
+        }
+
+        u_char *data() {
+            return buf + MSGBUS_RAW_HEADROOM;
+        }
+    };
+
     /**
      * OBJECT: stats_reports
      *
@@ -489,6 +518,25 @@ public:
     virtual void update_unicastPrefix(obj_bgp_peer &peer, std::vector<obj_rib> &rib, obj_path_attr *attr,
                                       unicast_prefix_action_code code) = 0;
 
+    /*****************************************************************//**
+     * \brief       Remove all RIB objects of a peer
+     *
+     * \details     Called on PEER DOWN when the parser doesn't keep the RIB
+     *              of the peer, so its prefixes can't be withdrawn one by one.
+     *              Implementations that store prefixes remove the ones of the
+     *              peer, streaming ones send a marker that the consumers use to
+     *              remove them.
+     *
+     *              The prefixes may be removed in batches, one per call, so a
+     *              shared message bus isn't held for long.  The caller repeats
+     *              the call until it returns false.
+     *
+     * \param[in]       peer    Peer object
+     *
+     * \returns true if prefixes of the peer are left, false when done
+     *****************************************************************/
+    virtual bool flush_PeerPrefixes(obj_bgp_peer &peer) = 0;
+
      /*****************************************************************//**
      * \brief       Add/Update vpn objects
      *
@@ -547,7 +595,7 @@ public:
      * \param[in]   code       Linkstate action code
      *****************************************************************/
     virtual void update_LsNode(obj_bgp_peer &peer, obj_path_attr &attr,
-                                std::list<MsgBusInterface::obj_ls_node> &nodes,
+                                std::vector<MsgBusInterface::obj_ls_node> &nodes,
                                 ls_action_code code) = 0;
 
     /*****************************************************************//**
@@ -564,7 +612,7 @@ public:
      *              supplied data for each object.
      *****************************************************************/
     virtual void update_LsLink(obj_bgp_peer &peer, obj_path_attr &attr,
-                             std::list<MsgBusInterface::obj_ls_link> &links,
+                             std::vector<MsgBusInterface::obj_ls_link> &links,
                              ls_action_code code) = 0;
 
     /*****************************************************************//**
@@ -581,7 +629,7 @@ public:
      *              supplied data for each object.
      *****************************************************************/
     virtual void update_LsPrefix(obj_bgp_peer &peer, obj_path_attr &attr,
-                                std::list<MsgBusInterface::obj_ls_prefix> &prefixes,
+                                std::vector<MsgBusInterface::obj_ls_prefix> &prefixes,
                                 ls_action_code code) = 0;
 
     /*****************************************************************//**
@@ -591,13 +639,34 @@ public:
      *
      * \param[in]    r_hash     Router hash
      * \param[in]    peer       Peer object
-     * \param[in]    data       Packet raw data
-     * \param[in]    data_len   Length in bytes for the raw data
+     * \param[in]    packet     Raw packet, a reference can be kept until it's sent.
+     *                          The packet must not be changed once passed.
      *
      * \returns     The hash_id will be updated based on the
      *              supplied data for each object.
      *****************************************************************/
-    virtual void send_bmp_raw(u_char *r_hash, obj_bgp_peer &peer, u_char *data, size_t data_len) = 0;
+    virtual void send_bmp_raw(u_char *r_hash, obj_bgp_peer &peer, const std::shared_ptr<obj_bmp_raw> &packet) = 0;
+
+    /*****************************************************************//**
+     * \brief       Get the number of messages not yet delivered
+     *
+     * \details     Used by the router admission control, which calls it from the
+     *              main thread.  Implementations that write synchronously have
+     *              no backlog.
+     *
+     * \returns     Number of messages queued to the message bus
+     *****************************************************************/
+    virtual uint32_t getBacklog() { return 0; }
+
+    /*****************************************************************//**
+     * \brief       Check if raw BMP packets are sent
+     *
+     * \details     Used to avoid keeping the parser's packet buffer referenced
+     *              by queued messages when send_bmp_raw() discards them.
+     *
+     * \returns     True if send_bmp_raw() sends the packet
+     *****************************************************************/
+    virtual bool isRawEnabled() { return true; }
 
 
     /* ---------------------------------------------------------------------------
@@ -628,6 +697,119 @@ public:
         hash_str = s;
     }
 
+    /**
+     * \brief       binary prefix to printed string format
+     *
+     * \details     Prefixes travel in binary form and are only printed when written, such as
+     *              in redis keys and kafka messages.  The output is the same as inet_ntop().
+     *
+     * \param[in]   prefix_bin    Prefix in binary form, 4 or 16 bytes
+     * \param[in]   isIPv4        True if IPv4, false if IPv6
+     * \param[out]  buf           Storage of at least PREFIX_STR_LEN bytes, NUL terminated
+     *
+     * \return      Length of the printed prefix
+     */
+    static size_t prefix_toStr(const uint8_t *prefix_bin, bool isIPv4, char *buf) {
+        static const char hex[] = "0123456789abcdef";
+        char *p = buf;
+
+        if (isIPv4) {
+            p = ipv4_toStr(prefix_bin, p);
+            *p = 0;
+            return p - buf;
+        }
+
+        uint16_t words[8];
+        int best = -1, best_len = 0;
+
+        for (int i = 0; i < 8; i++)
+            words[i] = prefix_bin[i * 2] << 8 | prefix_bin[i * 2 + 1];
+
+        // Longest run of zero words, the first one if several; a single zero word isn't compressed
+        for (int i = 0; i < 8; ) {
+            if (words[i] != 0) {
+                i++;
+                continue;
+            }
+
+            int start = i;
+            while (i < 8 and words[i] == 0)
+                i++;
+
+            if (i - start > best_len) {
+                best = start;
+                best_len = i - start;
+            }
+        }
+
+        if (best_len < 2)
+            best = -1;
+
+        for (int i = 0; i < 8; i++) {
+            if (best >= 0 and i >= best and i < best + best_len) {
+                if (i == best)
+                    *p++ = ':';
+                continue;
+            }
+
+            if (i != 0)
+                *p++ = ':';
+
+            // IPv4 compatible and mapped addresses end with the IPv4 address
+            if (i == 6 and best == 0 and (best_len == 6 or (best_len == 5 and words[5] == 0xffff))) {
+                p = ipv4_toStr(prefix_bin + 12, p);
+                *p = 0;
+                return p - buf;
+            }
+
+            bool lead = true;
+            for (int shift = 12; shift >= 0; shift -= 4) {
+                int nibble = (words[i] >> shift) & 0xF;
+
+                if (lead and nibble == 0 and shift > 0)
+                    continue;
+
+                lead = false;
+                *p++ = hex[nibble];
+            }
+        }
+
+        if (best >= 0 and best + best_len == 8)
+            *p++ = ':';
+
+        *p = 0;
+        return p - buf;
+    }
+
+    /**
+     * \brief       IPv4 address to printed string format, not NUL terminated
+     *
+     * \param[in]   addr          IPv4 address in binary form
+     * \param[out]  p             Storage of at least 15 bytes
+     *
+     * \return      End of the printed address
+     */
+    static char *ipv4_toStr(const uint8_t *addr, char *p) {
+        for (int i = 0; i < 4; i++) {
+            unsigned int value = addr[i];
+
+            if (i != 0)
+                *p++ = '.';
+
+            if (value >= 100) {
+                *p++ = '0' + value / 100;
+                value %= 100;
+                *p++ = '0' + value / 10;
+
+            } else if (value >= 10)
+                *p++ = '0' + value / 10;
+
+            *p++ = '0' + value % 10;
+        }
+
+        return p;
+    }
+
     /**
      * \brief       Time in seconds to printed string format
      *
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2013-2016 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#ifndef MSGBUSLOCKED_HPP_
+#define MSGBUSLOCKED_HPP_
+
+#include "MsgBusInterface.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+/**
+ * \class   MsgBusLocked
+ *
+ * \brief   Serializes the calls to a message bus implementation
+ * \details The message bus implementations keep per connection state (buffers, sequence
+ *          numbers, peer cache) and are not thread safe.  When the messages of a router
+ *          are parsed by the parse pool, the peers of the router call the message bus
+ *          from different threads, so each call is made under a lock.
+ *
+ *          Each user (the router reader, each peer) has its own instance sharing the lock
+ *          of the router.  Users set to priority get the lock before the others waiting.
+ */
+class MsgBusLocked : public MsgBusInterface {
+public:
+    /**
+     * Lock shared by the users of a message bus, priority users are let in first
+     */
+    class Gate {
+    public:
+        Gate() {
+            busy = false;
+            priority_waiting = 0;
+        }
+
+        void acquire(bool priority) {
+            std::unique_lock<std::mutex> guard(lock);
+
+            if (priority) {
+                ++priority_waiting;
+                cond.wait(guard, [this] { return not busy; });
+                --priority_waiting;
+
+            } else {
+                cond.wait(guard, [this] { return not busy and priority_waiting == 0; });
+            }
+
+            busy = true;
+        }
+
+        void release() {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                busy = false;
+            }
+
+            cond.notify_all();
+        }
+
+    private:
+        std::mutex      lock;               ///< Protects busy and priority_waiting
+        std::condition_variable cond;       ///< Signaled when the message bus is released
+        bool            busy;               ///< True while a user calls the message bus
+        int             priority_waiting;   ///< Number of priority users waiting
+    };
+
+    /**
+     * Class constructor
+     *
+     * \param [in] mbus_ptr     Message bus implementation to forward to, not owned
+     * \param [in] gate_ptr     Lock shared with the other users, NULL to create one
+     */
+    explicit MsgBusLocked(MsgBusInterface *mbus_ptr, std::shared_ptr<Gate> gate_ptr = std::shared_ptr<Gate>()) {
+        mbus = mbus_ptr;
+        gate = gate_ptr ? gate_ptr : std::make_shared<Gate>();
+        priority = false;
+        ribSeq = 0;
+    }
+
+    virtual ~MsgBusLocked() { };
+
+    /**
+     * Create another user of the message bus, sharing the lock
+     *
+     * \return new instance, freed by the caller
+     */
+    MsgBusLocked *share() {
+        return new MsgBusLocked(mbus, gate);
+    }
+
+    /**
+     * Set the priority of this user
+     *
+     * \param [in] high     True to get the lock before the normal users
+     */
+    void setPriority(bool high) {
+        priority = high;
+    }
+
+    /**
+     * Get the RIB sequence of the message bus implementation
+     */
+    uint64_t getRibSeq() {
+        Hold hold(this);
+        return mbus->ribSeq;
+    }
+
+    void update_Collector(struct obj_collector &c_obj, collector_action_code action_code) {
+        Hold hold(this);
+        mbus->update_Collector(c_obj, action_code);
+    }
+
+    void update_Router(struct obj_router &r_object, router_action_code code) {
+        Hold hold(this);
+        mbus->update_Router(r_object, code);
+    }
+
+    void update_Peer(obj_bgp_peer &peer, obj_peer_up_event *up, obj_peer_down_event *down, peer_action_code code) {
+        Hold hold(this);
+        mbus->update_Peer(peer, up, down, code);
+    }
+
+    void update_baseAttribute(obj_bgp_peer &peer, obj_path_attr &attr, base_attr_action_code code) {
+        Hold hold(this);
+        mbus->update_baseAttribute(peer, attr, code);
+    }
+
+    void update_unicastPrefix(obj_bgp_peer &peer, std::vector<obj_rib> &rib, obj_path_attr *attr,
+                              unicast_prefix_action_code code) {
+        Hold hold(this);
+        mbus->update_unicastPrefix(peer, rib, attr, code);
+    }
+
+    bool flush_PeerPrefixes(obj_bgp_peer &peer) {
+        Hold hold(this);
+        return mbus->flush_PeerPrefixes(peer);
+    }
+
+    void update_L3Vpn(obj_bgp_peer &peer, std::vector<obj_vpn> &vpn, obj_path_attr *attr,
+                      vpn_action_code code) {
+        Hold hold(this);
+        mbus->update_L3Vpn(peer, vpn, attr, code);
+    }
+
+    void update_eVPN(obj_bgp_peer &peer, std::vector<obj_evpn> &vpn, obj_path_attr *attr,
+                     vpn_action_code code) {
+        Hold hold(this);
+        mbus->update_eVPN(peer, vpn, attr, code);
+    }
+
+    void add_StatReport(obj_bgp_peer &peer, obj_stats_report &stats) {
+        Hold hold(this);
+        mbus->add_StatReport(peer, stats);
+    }
+
+    void update_LsNode(obj_bgp_peer &peer, obj_path_attr &attr,
+                       std::vector<MsgBusInterface::obj_ls_node> &nodes,
+                       ls_action_code code) {
+        Hold hold(this);
+        mbus->update_LsNode(peer, attr, nodes, code);
+    }
+
+    void update_LsLink(obj_bgp_peer &peer, obj_path_attr &attr,
+                       std::vector<MsgBusInterface::obj_ls_link> &links,
+                       ls_action_code code) {
+        Hold hold(this);
+        mbus->update_LsLink(peer, attr, links, code);
+    }
+
+    void update_LsPrefix(obj_bgp_peer &peer, obj_path_attr &attr,
+                         std::vector<MsgBusInterface::obj_ls_prefix> &prefixes,
+                         ls_action_code code) {
+        Hold hold(this);
+        mbus->update_LsPrefix(peer, attr, prefixes, code);
+    }
+
+    void send_bmp_raw(u_char *r_hash, obj_bgp_peer &peer, const std::shared_ptr<obj_bmp_raw> &packet) {
+        Hold hold(this);
+        mbus->send_bmp_raw(r_hash, peer, packet);
+    }
+
+    uint32_t getBacklog() {
+        Hold hold(this);
+        return mbus->getBacklog();
+    }
+
+    bool isRawEnabled() {
+        Hold hold(this);
+        return mbus->isRawEnabled();
+    }
+
+private:
+    /**
+     * Holds the gate for the scope of a call
+     */
+    struct Hold {
+        explicit Hold(MsgBusLocked *user) : gate(user->gate.get()) {
+            gate->acquire(user->priority);
+        }
+
+        ~Hold() {
+            gate->release();
+        }
+
+        Gate *gate;
+    };
+
+    MsgBusInterface *mbus;                  ///< Message bus implementation
+    std::shared_ptr<Gate> gate;             ///< Serializes the calls to mbus
+    std::atomic<bool> priority;             ///< True if the user gets the lock first
+};
+
+#endif /* MSGBUSLOCKED_HPP_ */
@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#include "ParsePool.h"
+#include "MemPolicy.h"
+
+/**
+ * Lane constructor
+ */
+ParsePool::Lane::Lane() {
+    scheduled = false;
+    home = -1;
+    node = -1;
+    priority = false;
+}
+
+/**
+ * Set the priority of the lane, takes effect the next time the lane is queued
+ *
+ * \param [in] high    True to run the lane before the normal lanes
+ */
+void ParsePool::Lane::setPriority(bool high) {
+    priority = high;
+}
+
+/**
+ * Set the NUMA node of the lane, must be set before the first task is submitted
+ *
+ * \param [in] node    NUMA node of the router, -1 for any
+ */
+void ParsePool::Lane::setNode(int node) {
+    this->node = node;
+}
+
+/**
+ * Wait until the lane has no tasks and is no longer queued or running
+ *
+ * \details The submitter must not submit tasks while waiting.
+ */
+void ParsePool::Lane::waitIdle() {
+    std::unique_lock<std::mutex> guard(lock);
+    idle_cond.wait(guard, [this] { return not scheduled; });
+}
+
+/**
+ * Class constructor
+ *
+ *  \param [in] logPtr  Pointer to existing Logger for app logging
+ *  \param [in] config  Pointer to the loaded configuration
+ */
+ParsePool::ParsePool(Logger *logPtr, Config *config) {
+    cfg = config;
+    logger = logPtr;
+
+    running = true;
+    next_home = 0;
+    queued = 0;
+    priority_queued = 0;
+
+    for (int i = 0; i < cfg->parse_threads; i++) {
+        Worker *w = new Worker;
+        w->thr = NULL;
+        w->node = MemPolicy::workerNode(i);
+        workers.push_back(w);
+    }
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i]->thr = new std::thread(&ParsePool::workerLoop, this, (int)i);
+
+    LOG_INFO("Started %d parse threads", cfg->parse_threads);
+}
+
+/**
+ * Destructor
+ */
+ParsePool::~ParsePool() {
+    stop();
+
+    for (size_t i = 0; i < workers.size(); i++)
+        delete workers[i];
+
+    workers.clear();
+}
+
+/**
+ * Stop all parse threads once the queued tasks have run
+ */
+void ParsePool::stop() {
+    if (not running.exchange(false))
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(idle_lock);
+        idle_cond.notify_all();
+    }
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        if (workers[i]->thr != NULL) {
+            if (workers[i]->thr->joinable())
+                workers[i]->thr->join();
+
+            delete workers[i]->thr;
+            workers[i]->thr = NULL;
+        }
+    }
+}
+
+/**
+ * Get the number of lanes waiting for a parse thread, can be called by any thread
+ *
+ * \return average number of lanes queued per parse thread
+ */
+int ParsePool::queueDepth() {
+    if (workers.empty())
+        return 0;
+
+    return (queued + priority_queued) / (int)workers.size();
+}
+
+/**
+ * Submit a task to a lane
+ *
+ * \param [in] lane     Lane to run the task on, after the tasks already submitted to it
+ * \param [in] task     Task to run, must not throw
+ */
+void ParsePool::submit(Lane *lane, const Task &task) {
+    {
+        std::lock_guard<std::mutex> guard(lane->lock);
+        lane->tasks.push_back(task);
+
+        // Already queued or running, the thread running it picks up the task
+        if (lane->scheduled)
+            return;
+
+        lane->scheduled = true;
+
+        // Keep a lane on the same thread while it's not stolen, for cache locality
+        if (lane->home < 0)
+            lane->home = pickHome(lane->node);
+    }
+
+    schedule(lane, lane->home);
+}
+
+/**
+ * Get the parse thread to queue a new lane on, round robin over the threads of the node
+ *
+ * \param [in] node     NUMA node of the lane, -1 for any
+ *
+ * \return index of the worker
+ */
+int ParsePool::pickHome(int node) {
+    unsigned int start = next_home++;
+
+    for (size_t i = 0; node >= 0 and i < workers.size(); i++) {
+        int index = (start + i) % workers.size();
+
+        if (workers[index]->node == node)
+            return index;
+    }
+
+    return start % workers.size();
+}
+
+/**
+ * Queue a lane with tasks on a parse thread
+ *
+ * \param [in] lane     Lane to queue
+ * \param [in] index    Index of the worker to queue the lane on
+ */
+void ParsePool::schedule(Lane *lane, int index) {
+    {
+        std::lock_guard<std::mutex> guard(workers[index]->lock);
+
+        if (lane->priority) {
+            workers[index]->priority_lanes.push_back(lane);
+            priority_queued++;
+        } else
+            workers[index]->lanes.push_back(lane);
+    }
+
+    queued++;
+
+    std::lock_guard<std::mutex> guard(idle_lock);
+    idle_cond.notify_one();
+}
+
+/**
+ * Take a lane from one of the queues of a worker
+ *
+ * \param [in] w        Worker to take the lane from
+ * \param [in] priority True to take from the priority queue, false for the normal queue
+ * \param [in] front    True to take the oldest lane (own queue), false for the newest (steal)
+ *
+ * \return lane, NULL if the queue is empty
+ */
+ParsePool::Lane *ParsePool::takeLane(Worker *w, bool priority, bool front) {
+    Lane *lane = NULL;
+    std::lock_guard<std::mutex> guard(w->lock);
+    std::deque<Lane *> &q = priority ? w->priority_lanes : w->lanes;
+
+    if (not q.empty()) {
+        if (front) {
+            lane = q.front();
+            q.pop_front();
+        } else {
+            lane = q.back();
+            q.pop_back();
+        }
+
+        if (priority)
+            priority_queued--;
+    }
+
+    return lane;
+}
+
+/**
+ * Get the next lane to run, from the worker's own queue or stolen from another
+ *
+ * \details Priority lanes of all threads are taken before the normal lanes.
+ *
+ * \param [in] index    Index of the worker
+ *
+ * \return lane to run, NULL if no lane is queued
+ */
+ParsePool::Lane *ParsePool::nextLane(int index) {
+    Lane *lane = NULL;
+
+    int node = workers[index]->node;
+
+    for (int priority = 1; lane == NULL and priority >= 0; priority--) {
+        lane = takeLane(workers[index], priority, true);
+
+        /*
+         * Steal from the back of the other threads' queues, oldest work stays with its owner.
+         *      Threads of the same NUMA node are tried first.
+         */
+        for (int local = 1; lane == NULL and local >= 0; local--) {
+            for (size_t i = 1; lane == NULL and i < workers.size(); i++) {
+                Worker *w = workers[(index + i) % workers.size()];
+
+                if ((w->node == node) == (local == 1))
+                    lane = takeLane(w, priority, false);
+            }
+        }
+    }
+
+    if (lane != NULL)
+        queued--;
+
+    return lane;
+}
+
+/**
+ * Run up to PARSE_LANE_BATCH tasks of a lane
+ *
+ * \details A normal lane stops early when a priority lane is waiting.
+ *
+ * \param [in] lane     Lane to run
+ *
+ * \return true if the lane still has tasks and must be queued again
+ */
+bool ParsePool::runLane(Lane *lane) {
+    bool priority = lane->priority;
+
+    for (int i = 0; i < PARSE_LANE_BATCH; i++) {
+        Task task;
+
+        if (i > 0 and not priority and priority_queued > 0)
+            break;
+
+        {
+            std::lock_guard<std::mutex> guard(lane->lock);
+
+            if (lane->tasks.empty()) {
+                lane->scheduled = false;
+                lane->idle_cond.notify_all();
+                return false;
+            }
+
+            task.swap(lane->tasks.front());
+            lane->tasks.pop_front();
+        }
+
+        task();
+    }
+
+    /*
+     * Last access of the lane once it's idle, the owner can free it as soon as the
+     *      lock is released. The notify is done under the lock for the same reason.
+     */
+    std::lock_guard<std::mutex> guard(lane->lock);
+    if (lane->tasks.empty()) {
+        lane->scheduled = false;
+        lane->idle_cond.notify_all();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Parse thread loop
+ *
+ * \param [in] index    Index of the worker that the thread runs
+ */
+void ParsePool::workerLoop(int index) {
+    MemPolicy::bindThread(workers[index]->node);
+
+    while (true) {
+        Lane *lane = nextLane(index);
+
+        if (lane == NULL) {
+            if (not running)
+                break;
+
+            std::unique_lock<std::mutex> guard(idle_lock);
+            idle_cond.wait(guard, [this] { return queued > 0 or not running; });
+            continue;
+        }
+
+        // Requeue a busy lane at the back of this thread, so other lanes get a turn
+        if (runLane(lane)) {
+            lane->home = index;
+            schedule(lane, index);
+        }
+    }
+}
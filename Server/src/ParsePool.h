@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#ifndef PARSEPOOL_H_
+#define PARSEPOOL_H_
+
+#include "Logger.h"
+#include "Config.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define PARSE_LANE_BATCH        64          ///< Max tasks of a lane run before the lane is requeued
+
+/**
+ * \class   ParsePool
+ *
+ * \brief   Work stealing pool of parse threads
+ * \details Tasks are submitted to a lane, tasks of the same lane run strictly in order
+ *          and never concurrently.  Tasks of different lanes run in parallel.  BMPReader
+ *          uses one lane per (router, peer).
+ *
+ *          A lane with tasks is queued on one of the parse threads.  Each thread runs the
+ *          lanes of its own queue, and when that's empty it steals lanes from the other
+ *          threads, so a single router with many busy peers is spread over all threads.
+ *          With NUMA placement, a lane is queued on a thread of its router's node and
+ *          threads steal from their own node first.
+ *
+ *          Priority lanes are queued separately and run before any other lane, own or
+ *          stolen.  BMPReader uses them for peers that finished their initial RIB dump, so
+ *          live updates are not queued behind the dumps of other peers.
+ */
+class ParsePool {
+public:
+    typedef std::function<void()> Task;
+
+    /**
+     * Ordered queue of tasks, owned by the submitter
+     *
+     * \details The lane must not be destroyed while it has tasks, waitIdle() waits until
+     *          the parse thread no longer references it.
+     */
+    class Lane {
+    public:
+        Lane();
+
+        /**
+         * Set the priority of the lane, takes effect the next time the lane is queued
+         *
+         * \param [in] high    True to run the lane before the normal lanes
+         */
+        void setPriority(bool high);
+
+        /**
+         * Set the NUMA node of the lane, must be set before the first task is submitted
+         *
+         * \param [in] node    NUMA node of the router, -1 for any
+         */
+        void setNode(int node);
+
+        /**
+         * Wait until the lane has no tasks and is no longer queued or running
+         *
+         * \details The submitter must not submit tasks while waiting.
+         */
+        void waitIdle();
+
+    private:
+        friend class ParsePool;
+
+        std::mutex          lock;           ///< Protects tasks and scheduled
+        std::deque<Task>    tasks;          ///< Tasks waiting to run, in order
+        bool                scheduled;      ///< True while the lane is queued or running
+        std::condition_variable idle_cond;  ///< Signaled when scheduled is cleared
+        int                 home;           ///< Parse thread the lane is queued on when submitted
+        int                 node;           ///< NUMA node of the lane's router, -1 for any
+        std::atomic<bool>   priority;       ///< True if the lane is queued as a priority lane
+    };
+
+    /**
+     * Class constructor
+     *
+     *  \param [in] logPtr  Pointer to existing Logger for app logging
+     *  \param [in] config  Pointer to the loaded configuration
+     */
+    ParsePool(Logger *logPtr, Config *config);
+
+    virtual ~ParsePool();
+
+    /**
+     * Submit a task to a lane
+     *
+     * \param [in] lane     Lane to run the task on, after the tasks already submitted to it
+     * \param [in] task     Task to run, must not throw
+     */
+    void submit(Lane *lane, const Task &task);
+
+    /**
+     * Stop all parse threads once the queued tasks have run
+     */
+    void stop();
+
+    /**
+     * Get the number of lanes waiting for a parse thread, can be called by any thread
+     *
+     * \return average number of lanes queued per parse thread
+     */
+    int queueDepth();
+
+public:
+    Logger      *logger;                    ///< Logging class pointer
+
+private:
+    /**
+     * Parse thread
+     */
+    struct Worker {
+        std::mutex          lock;           ///< Protects lanes and priority_lanes
+        std::deque<Lane *>  lanes;          ///< Lanes queued on the thread
+        std::deque<Lane *>  priority_lanes; ///< Priority lanes queued on the thread
+        std::thread         *thr;           ///< Thread running workerLoop()
+        int                 node;           ///< NUMA node the thread runs on, -1 for any
+    };
+
+    Config      *cfg;                       ///< Config pointer
+    std::atomic<bool> running;              ///< False once stop() has been called
+
+    std::vector<Worker *> workers;          ///< Parse threads
+    std::atomic<unsigned int> next_home;    ///< Round robin parse thread for new lanes
+
+    std::mutex  idle_lock;                  ///< Lock for idle_cond
+    std::condition_variable idle_cond;      ///< Signaled when a lane is queued
+    std::atomic<int> queued;                ///< Number of lanes queued on all threads
+    std::atomic<int> priority_queued;       ///< Number of priority lanes queued on all threads
+
+    /**
+     * Parse thread loop
+     *
+     * \param [in] index    Index of the worker that the thread runs
+     */
+    void workerLoop(int index);
+
+    /**
+     * Queue a lane with tasks on a parse thread
+     *
+     * \param [in] lane     Lane to queue
+     * \param [in] index    Index of the worker to queue the lane on
+     */
+    void schedule(Lane *lane, int index);
+
+    /**
+     * Get the next lane to run, from the worker's own queue or stolen from another
+     *
+     * \details Priority lanes of all threads are taken before the normal lanes.
+     *
+     * \param [in] index    Index of the worker
+     *
+     * \return lane to run, NULL if no lane is queued
+     */
+    Lane *nextLane(int index);
+
+    /**
+     * Get the parse thread to queue a new lane on, round robin over the threads of the node
+     *
+     * \param [in] node     NUMA node of the lane, -1 for any
+     *
+     * \return index of the worker
+     */
+    int pickHome(int node);
+
+    /**
+     * Take a lane from one of the queues of a worker
+     *
+     * \param [in] w        Worker to take the lane from
+     * \param [in] priority True to take from the priority queue, false for the normal queue
+     * \param [in] front    True to take the oldest lane (own queue), false for the newest (steal)
+     *
+     * \return lane, NULL if the queue is empty
+     */
+    Lane *takeLane(Worker *w, bool priority, bool front);
+
+    /**
+     * Run up to PARSE_LANE_BATCH tasks of a lane
+     *
+     * \details A normal lane stops early when a priority lane is waiting.
+     *
+     * \param [in] lane     Lane to run
+     *
+     * \return true if the lane still has tasks and must be queued again
+     */
+    bool runLane(Lane *lane);
+};
+
+#endif /* PARSEPOOL_H_ */
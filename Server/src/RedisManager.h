@@ -35,6 +35,8 @@
 #define BMP_TABLE_RIB_OUT          "BGP_RIB_OUT_TABLE"
 #define BMP_TABLE_NEI_PREFIX       "BGP_NEIGHBOR"
 
+#define BMP_DEL_BATCH              1000     ///< Max keys per DEL when removing the entries of a peer
+
 
 /**
  * BMP_CFG_TABLE_* defines config db tables.
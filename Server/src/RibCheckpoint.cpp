@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#include "RibCheckpoint.h"
+#include "md5.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+/**
+ * Open or create a checkpoint file
+ *
+ *  \param [in] logPtr  Pointer to existing Logger for app logging
+ *  \param [in] path    Path of the checkpoint file
+ *
+ *  \throws (const char *) on error.
+ */
+RibCheckpoint::RibCheckpoint(Logger *logPtr, const std::string &path) {
+    logger = logPtr;
+    this->path = path;
+
+    header = NULL;
+    records = NULL;
+    map_size = 0;
+
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+        throw "RibCheckpoint: Unable to open the checkpoint file";
+
+    try {
+        load();
+
+    } catch (char const *str) {
+        close(fd);
+        throw;
+    }
+}
+
+/**
+ * Destructor
+ */
+RibCheckpoint::~RibCheckpoint() {
+    if (header != NULL)
+        munmap(header, map_size);
+
+    close(fd);
+}
+
+/**
+ * Get the path of the checkpoint of a peer
+ *
+ * \param [in] dir          Checkpoint directory
+ * \param [in] router_hash  Hash ID of the router
+ * \param [in] peer_key     Peer address and RD
+ */
+std::string RibCheckpoint::getPath(const std::string &dir, const u_char *router_hash, const std::string &peer_key) {
+    MD5 hash;
+    hash.update((unsigned char *)router_hash, 16);
+    hash.update((unsigned char *)peer_key.c_str(), peer_key.length());
+    hash.finalize();
+
+    unsigned char *hash_raw = hash.raw_digest();
+    std::string hash_str;
+    MsgBusInterface::hash_toStr(hash_raw, hash_str);
+    delete[] hash_raw;
+
+    return dir + "/" + hash_str + ".rib";
+}
+
+/**
+ * Check if a directory has any checkpoint
+ *
+ * \param [in] dir          Checkpoint directory
+ */
+bool RibCheckpoint::exists(const std::string &dir) {
+    bool found = false;
+
+    DIR *d = opendir(dir.c_str());
+    if (d == NULL)
+        return false;
+
+    dirent *ent;
+    while (not found and (ent = readdir(d)) != NULL) {
+        size_t len = strlen(ent->d_name);
+        found = len > 4 and strcmp(ent->d_name + len - 4, ".rib") == 0;
+    }
+
+    closedir(d);
+
+    return found;
+}
+
+/**
+ * Get the generation of the last session
+ */
+uint32_t RibCheckpoint::getGeneration() {
+    return header->generation;
+}
+
+/**
+ * Set the generation of the current session
+ *
+ * \param [in] generation   Generation, not zero
+ */
+void RibCheckpoint::setGeneration(uint32_t generation) {
+    header->generation = generation;
+}
+
+/**
+ * Get the number of records, used or free
+ */
+uint32_t RibCheckpoint::capacity() {
+    return header->records;
+}
+
+/**
+ * Read a record
+ *
+ * \param [in]  record      Record index
+ * \param [out] key         Path key
+ * \param [out] attr_id     Attribute set ID of the path
+ * \param [out] generation  Generation the path was last confirmed in
+ *
+ * \return false if the record is free
+ */
+bool RibCheckpoint::getRecord(uint32_t record, AdjRib::Key &key, uint64_t &attr_id, uint32_t &generation) {
+    Record &rec = records[record];
+
+    if (rec.generation == 0)
+        return false;
+
+    key = rec.key;
+    attr_id = rec.attr_id;
+    generation = rec.generation;
+
+    return true;
+}
+
+/**
+ * Add a record for a path
+ *
+ * \param [in] key          Path key
+ * \param [in] attr_id      Attribute set ID of the path
+ * \param [in] generation   Generation the path is confirmed in, not zero
+ *
+ * \return record index, ADJ_RIB_NO_RECORD if the file can't be grown
+ */
+uint32_t RibCheckpoint::add(const AdjRib::Key &key, uint64_t attr_id, uint32_t generation) {
+    if (free_records.empty() and not grow())
+        return ADJ_RIB_NO_RECORD;
+
+    uint32_t i = free_records.back();
+    free_records.pop_back();
+
+    Record &rec = records[i];
+    rec.key = key;
+    rec.attr_id = attr_id;
+    rec.reserved = 0;
+    rec.generation = generation;            // Set last, marks the record in use
+
+    return i;
+}
+
+/**
+ * Update the record of a path
+ *
+ * \param [in] record       Record index from add()
+ * \param [in] attr_id      Attribute set ID of the path
+ * \param [in] generation   Generation the path is confirmed in, not zero
+ */
+void RibCheckpoint::set(uint32_t record, uint64_t attr_id, uint32_t generation) {
+    records[record].attr_id = attr_id;
+    records[record].generation = generation;
+}
+
+/**
+ * Free the record of a path
+ *
+ * \param [in] record       Record index from add()
+ */
+void RibCheckpoint::release(uint32_t record) {
+    records[record].generation = 0;
+    free_records.push_back(record);
+}
+
+/**
+ * Free all records
+ */
+void RibCheckpoint::clear() {
+    free_records.clear();
+
+    for (uint32_t i = header->records; i > 0; i--) {
+        records[i - 1].generation = 0;
+        free_records.push_back(i - 1);
+    }
+}
+
+/**
+ * Map the file, initializing it if it's not a valid checkpoint
+ *
+ *  \throws (const char *) on error.
+ */
+void RibCheckpoint::load() {
+    struct stat st;
+
+    if (fstat(fd, &st) != 0)
+        throw "RibCheckpoint: Unable to stat the checkpoint file";
+
+    if ((size_t)st.st_size >= sizeof(Header)) {
+        void *ptr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED)
+            throw "RibCheckpoint: Unable to map the checkpoint file";
+
+        header = (Header *)ptr;
+        map_size = st.st_size;
+
+        if (header->magic != RIB_CHECKPOINT_MAGIC or header->version != RIB_CHECKPOINT_VERSION
+                or header->record_size != sizeof(Record)
+                or (size_t)st.st_size != sizeof(Header) + (size_t)header->records * sizeof(Record)) {
+
+            LOG_WARN("%s: Not a valid RIB checkpoint, starting over", path.c_str());
+
+            munmap(header, map_size);
+            header = NULL;
+        }
+    }
+
+    if (header == NULL) {
+        size_t size = sizeof(Header) + RIB_CHECKPOINT_MIN_RECORDS * sizeof(Record);
+
+        /*
+         * Allocate all blocks now, running out of disk while writing to the mapping
+         *      would be a SIGBUS instead of an error.
+         */
+        if (ftruncate(fd, 0) != 0 or posix_fallocate(fd, 0, size) != 0)
+            throw "RibCheckpoint: Unable to allocate the checkpoint file";
+
+        void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED)
+            throw "RibCheckpoint: Unable to map the checkpoint file";
+
+        header = (Header *)ptr;
+        map_size = size;
+
+        header->magic = RIB_CHECKPOINT_MAGIC;
+        header->version = RIB_CHECKPOINT_VERSION;
+        header->record_size = sizeof(Record);
+        header->generation = 0;
+        header->records = RIB_CHECKPOINT_MIN_RECORDS;
+    }
+
+    records = (Record *)(header + 1);
+
+    free_records.clear();
+
+    for (uint32_t i = header->records; i > 0; i--) {
+        if (records[i - 1].generation == 0)
+            free_records.push_back(i - 1);
+    }
+
+    if (free_records.size() < header->records)
+        LOG_INFO("%s: Loaded %u paths from the RIB checkpoint", path.c_str(),
+                 header->records - (uint32_t)free_records.size());
+}
+
+/**
+ * Grow the file to twice the records
+ *
+ * \return false if the file can't be grown
+ */
+bool RibCheckpoint::grow() {
+    uint32_t old_records = header->records;
+    uint32_t new_records = old_records * 2;
+    size_t size = sizeof(Header) + (size_t)new_records * sizeof(Record);
+
+    int rval = posix_fallocate(fd, 0, size);
+    if (rval != 0) {
+        LOG_WARN("%s: Unable to grow the RIB checkpoint: %s", path.c_str(), strerror(rval));
+        return false;
+    }
+
+    void *ptr = mremap(header, map_size, size, MREMAP_MAYMOVE);
+    if (ptr == MAP_FAILED) {
+        LOG_WARN("%s: Unable to map the grown RIB checkpoint: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    header = (Header *)ptr;
+    records = (Record *)(header + 1);
+    map_size = size;
+
+    header->records = new_records;
+
+    for (uint32_t i = new_records; i > old_records; i--)
+        free_records.push_back(i - 1);
+
+    return true;
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#ifndef RIBCHECKPOINT_H_
+#define RIBCHECKPOINT_H_
+
+#include "AdjRib.h"
+#include "Logger.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define RIB_CHECKPOINT_MAGIC        0x4f425243      ///< "OBRC", identifies a checkpoint file
+#define RIB_CHECKPOINT_VERSION      1               ///< Version of the checkpoint file layout
+#define RIB_CHECKPOINT_MIN_RECORDS  4096            ///< Records of a new checkpoint, doubled when full
+
+/**
+ * \class   RibCheckpoint
+ *
+ * \brief   Paths of a peer RIB, persisted in a memory mapped file
+ * \details Each record is a path of the AdjRib of the peer with its attribute set ID and the
+ *          generation it was last confirmed in.  Records are written in place to the shared
+ *          mapping, so the checkpoint is current whenever openbmpd stops, including a crash.
+ *
+ *          The AdjRib loads the records when it is created and keeps the record of each path.
+ *          Only used by one thread at a time, the parser of the peer.
+ */
+class RibCheckpoint {
+public:
+    /**
+     * Open or create a checkpoint file
+     *
+     * \details An existing file that isn't a valid checkpoint is started over.
+     *
+     *  \param [in] logPtr  Pointer to existing Logger for app logging
+     *  \param [in] path    Path of the checkpoint file
+     *
+     *  \throws (const char *) on error.
+     */
+    RibCheckpoint(Logger *logPtr, const std::string &path);
+
+    virtual ~RibCheckpoint();
+
+    /**
+     * Get the path of the checkpoint of a peer
+     *
+     * \param [in] dir          Checkpoint directory
+     * \param [in] router_hash  Hash ID of the router
+     * \param [in] peer_key     Peer address and RD
+     */
+    static std::string getPath(const std::string &dir, const u_char *router_hash, const std::string &peer_key);
+
+    /**
+     * Check if a directory has any checkpoint
+     *
+     * \param [in] dir          Checkpoint directory
+     */
+    static bool exists(const std::string &dir);
+
+    /**
+     * Get the generation of the last session
+     */
+    uint32_t getGeneration();
+
+    /**
+     * Set the generation of the current session
+     *
+     * \param [in] generation   Generation, not zero
+     */
+    void setGeneration(uint32_t generation);
+
+    /**
+     * Get the number of records, used or free
+     */
+    uint32_t capacity();
+
+    /**
+     * Read a record
+     *
+     * \param [in]  record      Record index
+     * \param [out] key         Path key
+     * \param [out] attr_id     Attribute set ID of the path
+     * \param [out] generation  Generation the path was last confirmed in
+     *
+     * \return false if the record is free
+     */
+    bool getRecord(uint32_t record, AdjRib::Key &key, uint64_t &attr_id, uint32_t &generation);
+
+    /**
+     * Add a record for a path
+     *
+     * \param [in] key          Path key
+     * \param [in] attr_id      Attribute set ID of the path
+     * \param [in] generation   Generation the path is confirmed in, not zero
+     *
+     * \return record index, ADJ_RIB_NO_RECORD if the file can't be grown
+     */
+    uint32_t add(const AdjRib::Key &key, uint64_t attr_id, uint32_t generation);
+
+    /**
+     * Update the record of a path
+     *
+     * \param [in] record       Record index from add()
+     * \param [in] attr_id      Attribute set ID of the path
+     * \param [in] generation   Generation the path is confirmed in, not zero
+     */
+    void set(uint32_t record, uint64_t attr_id, uint32_t generation);
+
+    /**
+     * Free the record of a path
+     *
+     * \param [in] record       Record index from add()
+     */
+    void release(uint32_t record);
+
+    /**
+     * Free all records
+     */
+    void clear();
+
+private:
+    /**
+     * File header, followed by the records
+     */
+    struct Header {
+        uint32_t    magic;                  ///< RIB_CHECKPOINT_MAGIC
+        uint32_t    version;                ///< RIB_CHECKPOINT_VERSION
+        uint32_t    record_size;            ///< sizeof(Record)
+        uint32_t    generation;             ///< Current generation
+        uint32_t    records;                ///< Number of records in the file
+        uint32_t    reserved[3];
+    };
+
+    /**
+     * Record of a path
+     */
+    struct Record {
+        AdjRib::Key key;                    ///< Path key
+        uint64_t    attr_id;                ///< Attribute set ID
+        uint32_t    generation;             ///< Generation the path was last confirmed in, zero if free
+        uint32_t    reserved;
+    };
+
+    Logger      *logger;                    ///< Logging class pointer
+    std::string path;                       ///< Path of the checkpoint file
+    int         fd;                         ///< Checkpoint file
+    Header      *header;                    ///< Mapped file
+    Record      *records;                   ///< Records of the mapped file
+    size_t      map_size;                   ///< Size of the mapping
+
+    std::vector<uint32_t> free_records;     ///< Free record indexes, lowest last
+
+    /**
+     * Map the file, initializing it if it's not a valid checkpoint
+     *
+     *  \throws (const char *) on error.
+     */
+    void load();
+
+    /**
+     * Grow the file to twice the records
+     *
+     * \return false if the file can't be grown
+     */
+    bool grow();
+};
+
+#endif /* RIBCHECKPOINT_H_ */
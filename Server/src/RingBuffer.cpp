@@ -0,0 +1,643 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "RingBuffer.h"
+#include "MemPolicy.h"
+
+std::atomic<uint64_t> RingBuffer::mem_used(0);
+uint64_t RingBuffer::mem_budget = 0;
+
+/**
+ * Constructor for class
+ *
+ * \param [in] size     Initial and minimum size of the ring in bytes
+ * \param [in] max_size Max size the ring can grow to, zero or less than size for a fixed size
+ * \param [in] node     NUMA node to place the ring memory on, -1 for any
+ */
+RingBuffer::RingBuffer(size_t size, size_t max_size, int node) {
+    buf_size = size;
+    this->node = node;
+
+    // Large and long lived, mapped directly so it can use huge pages
+    buf = MemPolicy::alloc(size, node);
+    if (buf == NULL)
+        throw std::bad_alloc();
+
+    min_size = size;
+    this->max_size = max_size > size ? max_size : size;
+    high_watermark = size / 100 * RING_HIGH_WATERMARK;
+
+    reading = false;
+    resizing = false;
+    peak_used = 0;
+    shrink_check = time(NULL) + RING_SHRINK_INTERVAL;
+
+    stat_messages = 0;
+    stat_stalls = 0;
+    stat_stall_us = 0;
+    stat_wraps = 0;
+    stat_peak = 0;
+    stalled = false;
+
+    mem_used += size;
+
+    head = 0;
+    tail = 0;
+    write_closed = false;
+    read_closed = false;
+    consumer_waiting = false;
+    producer_waiting = false;
+
+    spool = NULL;
+    spool_fd = -1;
+    spool_size = 0;
+    spool_head = 0;
+    spool_tail = 0;
+    spool_released = 0;
+    spooling = false;
+}
+
+RingBuffer::~RingBuffer() {
+    MemPolicy::release(buf, buf_size);
+    mem_used -= buf_size;
+
+    if (spool != NULL) {
+        munmap(spool, spool_size);
+        ::close(spool_fd);
+    }
+}
+
+/**
+ * Enable the disk spool, must be called before any data is written
+ *
+ * \param [in] dir      Directory to create the spool file in
+ * \param [in] size     Size of the spool in bytes
+ *
+ * \return true if enabled, false if the spool file could not be created (errno is set)
+ */
+bool RingBuffer::enableSpool(const std::string &dir, size_t size) {
+    std::string path = dir + "/openbmpd-spool.XXXXXX";
+    char *tmpl = strdup(path.c_str());
+
+    int fd = mkstemp(tmpl);
+    if (fd < 0) {
+        free(tmpl);
+        return false;
+    }
+
+    unlink(tmpl);
+    free(tmpl);
+
+    /*
+     * Allocate all blocks now, running out of disk while writing to the mapping
+     *      would be a SIGBUS instead of an error.
+     */
+    int rval = posix_fallocate(fd, 0, size);
+    if (rval != 0) {
+        ::close(fd);
+        errno = rval;
+        return false;
+    }
+
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+
+    spool = (unsigned char *)ptr;
+    spool_fd = fd;
+    spool_size = size;
+
+    return true;
+}
+
+/**
+ * Get the contiguous free space at the write position
+ *
+ * \param [out] ptr     Updated with the pointer to write to
+ *
+ * \return number of bytes that can be written to ptr, zero if the ring is full
+ */
+size_t RingBuffer::writeSpace(unsigned char **ptr) {
+    // Consumer drained the spool, which means the ring is empty as well
+    if (spooling and spool_head.load() == spool_tail.load(std::memory_order_relaxed))
+        spooling = false;
+
+    if (not spooling) {
+        size_t ring_used = (size_t)(tail.load(std::memory_order_relaxed) - head.load());
+
+        if (ring_used >= high_watermark) {
+            // Sustained backlog, grow the ring before spilling to disk
+            size_t new_size = buf_size * 2 < max_size ? buf_size * 2 : max_size;
+
+            // Only a hint, resize() reserves the memory; on a lost race the next call spools
+            if (new_size > buf_size and (mem_budget == 0 or mem_used + (new_size - buf_size) <= mem_budget))
+                resize(new_size);       // Retried on the next call if the consumer is busy
+
+            else if (spool != NULL)
+                spooling = true;
+
+        } else if (buf_size > min_size) {
+            checkShrink(ring_used);
+        }
+    }
+
+    if (spooling) {
+        uint64_t t = spool_tail.load(std::memory_order_relaxed);
+        size_t free_space = spool_size - (size_t)(t - spool_head.load());
+        size_t pos = t % spool_size;
+
+        *ptr = spool + pos;
+
+        return trackStall(free_space < spool_size - pos ? free_space : spool_size - pos);
+    }
+
+    size_t size = buf_size;
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    size_t free_space = size - (size_t)(t - head.load());
+    size_t pos = t % size;
+
+    *ptr = buf + pos;
+
+    return trackStall(free_space < size - pos ? free_space : size - pos);
+}
+
+/**
+ * Track producer stalls, called with the space returned by writeSpace()
+ *
+ * \param [in] space    Space available to the producer
+ *
+ * \return space
+ */
+size_t RingBuffer::trackStall(size_t space) {
+    if (space == 0 and not stalled) {
+        stalled = true;
+        stall_start = std::chrono::steady_clock::now();
+        stat_stalls++;
+
+    } else if (space > 0 and stalled) {
+        stalled = false;
+        stat_stall_us += std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - stall_start).count();
+    }
+
+    return space;
+}
+
+/**
+ * Replace the ring memory with a buffer of a different size, called by the producer
+ *
+ * \param [in] new_size Size of the new ring, must fit the buffered data
+ *
+ * \return true if resized, false if over budget or the consumer is reading
+ */
+bool RingBuffer::resize(size_t new_size) {
+    size_t old_size = buf_size;
+    size_t grow = new_size > old_size ? new_size - old_size : 0;
+
+    if (reading)
+        return false;
+
+    // Reserve first, rings of other routers grow from other I/O threads at the same time
+    if (grow > 0 and mem_used.fetch_add(grow) + grow > mem_budget and mem_budget > 0) {
+        mem_used -= grow;
+        return false;
+    }
+
+    unsigned char *new_buf = MemPolicy::alloc(new_size, node);
+    if (new_buf == NULL) {
+        mem_used -= grow;
+        return false;
+    }
+
+    /*
+     * Both flags are sequentially consistent, so either the consumer sees resizing and
+     *      waits in beginRead(), or this sees reading and backs off.
+     */
+    resizing = true;
+    if (reading) {
+        std::lock_guard<std::mutex> guard(lock);
+        resizing = false;
+        data_cond.notify_all();
+
+        MemPolicy::release(new_buf, new_size);
+        mem_used -= grow;
+        return false;
+    }
+
+    // Keep every byte at its position modulo the size, so head and tail stay valid
+    uint64_t h = head;
+    uint64_t t = tail;
+
+    while (h < t) {
+        size_t old_pos = h % old_size;
+        size_t new_pos = h % new_size;
+        size_t len = t - h;
+
+        if (len > old_size - old_pos)
+            len = old_size - old_pos;
+        if (len > new_size - new_pos)
+            len = new_size - new_pos;
+
+        memcpy(new_buf + new_pos, buf + old_pos, len);
+        h += len;
+    }
+
+    MemPolicy::release(buf, old_size);
+    buf = new_buf;
+    buf_size = new_size;
+    high_watermark = new_size / 100 * RING_HIGH_WATERMARK;
+
+    if (grow == 0)
+        mem_used -= old_size - new_size;
+
+    peak_used = 0;
+    shrink_check = time(NULL) + RING_SHRINK_INTERVAL;
+
+    std::lock_guard<std::mutex> guard(lock);
+    resizing = false;
+    data_cond.notify_all();
+
+    return true;
+}
+
+/**
+ * Shrink the ring if its usage stayed low for RING_SHRINK_INTERVAL, called by the producer
+ *
+ * \param [in] ring_used    Current ring usage
+ */
+void RingBuffer::checkShrink(size_t ring_used) {
+    if (ring_used > peak_used)
+        peak_used = ring_used;
+
+    time_t now = time(NULL);
+    if (now < shrink_check)
+        return;
+
+    if (peak_used < buf_size / 4) {
+        size_t new_size = buf_size / 2 > min_size ? buf_size / 2 : min_size;
+        resize(new_size);
+    }
+
+    peak_used = ring_used;
+    shrink_check = now + RING_SHRINK_INTERVAL;
+}
+
+/**
+ * Wait for a resize to finish and mark the consumer as accessing the ring
+ */
+void RingBuffer::beginRead() {
+    reading = true;
+
+    while (resizing) {
+        reading = false;
+
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            data_cond.wait(guard, [this] { return not resizing; });
+        }
+
+        reading = true;
+    }
+}
+
+/**
+ * Commit bytes written to the pointer returned by writeSpace()
+ *
+ * \param [in] len      Number of bytes written
+ */
+void RingBuffer::commitWrite(size_t len) {
+    if (spooling) {
+        spool_tail.fetch_add(len);
+
+    } else {
+        uint64_t t = tail.fetch_add(len);
+        size_t size = buf_size;
+
+        if (t % size + len >= size)
+            stat_wraps++;
+    }
+
+    size_t u = used();
+    if (u > stat_peak)
+        stat_peak = u;
+
+    if (consumer_waiting) {
+        std::lock_guard<std::mutex> guard(lock);
+        data_cond.notify_one();
+    }
+}
+
+/**
+ * Indicate end of stream, the consumer reads the remaining data and then gets EOF
+ */
+void RingBuffer::closeWrite() {
+    std::lock_guard<std::mutex> guard(lock);
+    write_closed = true;
+    data_cond.notify_one();
+}
+
+/**
+ * Wait for free space
+ *
+ * \param [in] timeout  Max time to wait in milliseconds
+ *
+ * \return true if there is free space, false if timed out or the consumer closed
+ */
+bool RingBuffer::waitForSpace(int timeout) {
+    std::unique_lock<std::mutex> guard(lock);
+
+    producer_waiting = true;
+    space_cond.wait_for(guard, std::chrono::milliseconds(timeout), [this] {
+        return read_closed or freeSpace() > 0;
+    });
+    producer_waiting = false;
+
+    return not read_closed and freeSpace() > 0;
+}
+
+/**
+ * Free space that the producer can write to, ring or spool
+ */
+size_t RingBuffer::freeSpace() {
+    size_t ring_used = tail - head;
+
+    // Same decision as writeSpace(), without switching or growing
+    if (spool != NULL and (spooling ? spool_head != spool_tail : ring_used >= high_watermark))
+        return spool_size - (size_t)(spool_tail - spool_head);
+
+    return buf_size - ring_used;
+}
+
+/**
+ * Request a notification when the consumer frees space
+ */
+void RingBuffer::requestSpaceNotify() {
+    producer_waiting = true;
+}
+
+/**
+ * Set the callback for space and consumer close notifications
+ *
+ * \param [in] notify   Callback, or an empty function to use the condition variable
+ */
+void RingBuffer::setNotify(const std::function<void()> &notify) {
+    this->notify = notify;
+}
+
+/**
+ * Notify the producer of free space or consumer close
+ */
+void RingBuffer::notifyProducer() {
+    if (notify) {
+        notify();
+
+    } else {
+        std::lock_guard<std::mutex> guard(lock);
+        space_cond.notify_one();
+    }
+}
+
+/**
+ * Wait until at least len bytes are available or the stream ended
+ *
+ * \return number of bytes available
+ */
+size_t RingBuffer::waitForData(size_t len) {
+    size_t avail = used();
+
+    if (avail >= len or write_closed)
+        return avail;
+
+    std::unique_lock<std::mutex> guard(lock);
+
+    consumer_waiting = true;
+    data_cond.wait(guard, [this, len] {
+        return used() >= len or write_closed;
+    });
+    consumer_waiting = false;
+
+    return used();
+}
+
+/**
+ * Read from the ring, blocking until data is available
+ *
+ * \param [out] buf         Buffer to copy the data into
+ * \param [in]  len         Number of bytes to read
+ * \param [in]  wait_all    True to wait until len bytes are available (MSG_WAITALL)
+ * \param [in]  peek        True to leave the data in the ring (MSG_PEEK)
+ *
+ * \return number of bytes read, zero on end of stream. Less than len is only returned
+ *         if wait_all is false or the stream ended.
+ */
+ssize_t RingBuffer::read(void *dst, size_t len, bool wait_all, bool peek) {
+    if (len == 0 or read_closed)
+        return 0;
+
+    // The ring can never hold more than its size
+    if (len > buf_size)
+        len = buf_size;
+
+    size_t avail = waitForData(wait_all ? len : 1);
+
+    if (avail < len)
+        len = avail;
+
+    if (len == 0)
+        return 0;
+
+    beginRead();
+
+    /*
+     * Spool data is always newer than ring data. Loading the spool tail first makes
+     *      sure that all ring data written before it is seen.
+     */
+    uint64_t st = spool_tail.load();
+    uint64_t h = head.load(std::memory_order_relaxed);
+    size_t ring_len = (size_t)(tail.load() - h);
+
+    if (ring_len > len)
+        ring_len = len;
+
+    size_t size = buf_size;
+    size_t pos = h % size;
+    size_t first = size - pos < ring_len ? size - pos : ring_len;
+
+    memcpy(dst, buf + pos, first);
+    if (first < ring_len)
+        memcpy((unsigned char *)dst + first, buf, ring_len - first);
+
+    // Rest comes from the spool
+    uint64_t sh = spool_head.load(std::memory_order_relaxed);
+    size_t spool_len = 0;
+
+    if (ring_len < len and spool != NULL) {
+        unsigned char *spool_dst = (unsigned char *)dst + ring_len;
+
+        spool_len = (size_t)(st - sh);
+        if (spool_len > len - ring_len)
+            spool_len = len - ring_len;
+
+        pos = sh % spool_size;
+        first = spool_size - pos < spool_len ? spool_size - pos : spool_len;
+
+        memcpy(spool_dst, spool + pos, first);
+        if (first < spool_len)
+            memcpy(spool_dst + first, spool, spool_len - first);
+    }
+
+    reading = false;
+
+    if (not peek) {
+        head.store(h + ring_len);
+
+        if (spool_len > 0) {
+            releaseSpool(sh + spool_len);
+            spool_head.store(sh + spool_len);
+        }
+
+        if (producer_waiting.exchange(false))
+            notifyProducer();
+    }
+
+    return ring_len + spool_len;
+}
+
+/**
+ * Release the memory of consumed spool chunks
+ *
+ * \details Done before the consumed position is published, so the producer can't be
+ *          writing to a chunk while it's released.
+ *
+ * \param [in] pos      Spool position consumed up to
+ */
+void RingBuffer::releaseSpool(uint64_t pos) {
+    while (pos - spool_released >= RING_SPOOL_RELEASE_SIZE) {
+        size_t off = spool_released % spool_size;
+        size_t len = spool_size - off < RING_SPOOL_RELEASE_SIZE ? spool_size - off : RING_SPOOL_RELEASE_SIZE;
+
+        // Drop the pages from the mapping and the page cache, the file blocks stay allocated
+        madvise(spool + off, len, MADV_DONTNEED);
+        posix_fadvise(spool_fd, off, len, POSIX_FADV_DONTNEED);
+
+        spool_released += len;
+    }
+}
+
+/**
+ * Consumer is done, no more data will be read.  The producer is notified.
+ */
+void RingBuffer::closeRead() {
+    if (read_closed.exchange(true))
+        return;
+
+    producer_waiting = false;
+
+    notifyProducer();
+}
+
+/**
+ * Close both sides and discard any buffered data
+ */
+void RingBuffer::close() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        write_closed = true;
+        read_closed = true;
+        head = tail.load();
+        spool_head = spool_tail.load();
+
+        data_cond.notify_all();
+        space_cond.notify_all();
+    }
+
+    if (notify)
+        notifyProducer();
+}
+
+/**
+ * Number of bytes buffered, including the spool
+ */
+size_t RingBuffer::used() {
+    return (size_t)(spool_tail - spool_head) + (size_t)(tail - head);
+}
+
+/**
+ * Current size of the ring in bytes
+ */
+size_t RingBuffer::size() {
+    return buf_size;
+}
+
+/**
+ * Count a message parsed from the ring, called by the consumer
+ */
+void RingBuffer::countMessage() {
+    stat_messages++;
+}
+
+/**
+ * Get the counters of the ring, can be called by any thread
+ *
+ * \param [out] stats   Updated with the counters
+ */
+void RingBuffer::getStats(Stats &stats) {
+    stats.bytes_out = head + spool_head;
+    stats.bytes_in = tail + spool_tail;
+    stats.messages = stat_messages;
+    stats.used = used();
+    stats.peak_used = stat_peak.exchange(stats.used);
+    if (stats.peak_used < stats.used)
+        stats.peak_used = stats.used;
+    stats.size = buf_size;
+    stats.stalls = stat_stalls;
+    stats.stall_ms = stat_stall_us / 1000;
+    stats.wraps = stat_wraps;
+}
+
+/**
+ * Set the global memory budget for all rings
+ *
+ * \param [in] budget   Budget in bytes, zero for unlimited
+ */
+void RingBuffer::setMemoryBudget(uint64_t budget) {
+    mem_budget = budget;
+}
+
+/**
+ * Memory allocated by all rings in bytes
+ */
+uint64_t RingBuffer::memoryUsed() {
+    return mem_used;
+}
+
+/**
+ * True if the consumer has closed
+ */
+bool RingBuffer::isReadClosed() {
+    return read_closed;
+}
+
+/**
+ * True if the producer has closed (end of stream)
+ */
+bool RingBuffer::isWriteClosed() {
+    return write_closed;
+}
@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#ifndef RINGBUFFER_H_
+#define RINGBUFFER_H_
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#define RING_HIGH_WATERMARK         75                  ///< Percent of the ring used before it's grown or new data goes to the spool
+#define RING_SHRINK_INTERVAL        60                  ///< Seconds of low usage before the ring is shrunk
+#define RING_SPOOL_RELEASE_SIZE     (16 * 1024 * 1024)  ///< Consumed spool space is dropped from memory in chunks of this size
+
+/**
+ * \class   RingBuffer
+ *
+ * \brief   Single producer, single consumer byte ring shared by the router socket
+ *          reader and the BMP parser
+ * \details The producer (client thread or I/O thread) reads the router socket directly
+ *          into the free space of the ring and commits it.  The consumer (BMPReader/parseBMP)
+ *          reads the committed bytes directly from the ring.  Positions are monotonic
+ *          byte counters, so the only shared state on the fast path is two atomics.
+ *
+ *          Either side only takes the lock when it has to sleep, or when it has to wake
+ *          the other side up.
+ *
+ *          The ring starts at its minimum size and is grown by the producer, up to the max
+ *          size and within the global memory budget, when it passes the high watermark.
+ *          It's shrunk again after a period of low usage.  A resize copies the data to a
+ *          new buffer, which is only done while the consumer isn't accessing the ring.
+ *
+ *          An optional spool file can be enabled to absorb bursts larger than the ring.
+ *          Once the ring passes the high watermark, the producer writes to the spool (a
+ *          second ring, mmap'd from a file) until the consumer has drained it.  Spool data
+ *          is always newer than ring data, so the consumer reads the ring first.
+ */
+class RingBuffer {
+public:
+    /**
+     * Counters of the ring, see getStats()
+     */
+    struct Stats {
+        uint64_t    bytes_in;               ///< Bytes received from the router
+        uint64_t    bytes_out;              ///< Bytes handed to the parser
+        uint64_t    messages;               ///< Messages parsed, see countMessage()
+        size_t      used;                   ///< Bytes buffered, including the spool
+        size_t      peak_used;              ///< Peak bytes buffered since the previous getStats()
+        size_t      size;                   ///< Current size of the ring
+        uint64_t    stalls;                 ///< Number of times the producer found no space
+        uint64_t    stall_ms;               ///< Total time the producer had no space, in milliseconds
+        uint64_t    wraps;                  ///< Number of times the write position wrapped around the ring
+    };
+
+    /**
+     * Constructor for class
+     *
+     * \param [in] size     Initial and minimum size of the ring in bytes
+     * \param [in] max_size Max size the ring can grow to, zero or less than size for a fixed size
+     * \param [in] node     NUMA node to place the ring memory on, -1 for any
+     */
+    RingBuffer(size_t size, size_t max_size = 0, int node = -1);
+
+    virtual ~RingBuffer();
+
+    /**
+     * Enable the disk spool, must be called before any data is written
+     *
+     * \details The spool file is created in dir, fully allocated and unlinked, so
+     *          it's freed when the ring is destroyed, even if the process dies.
+     *
+     * \param [in] dir      Directory to create the spool file in
+     * \param [in] size     Size of the spool in bytes
+     *
+     * \return true if enabled, false if the spool file could not be created (errno is set)
+     */
+    bool enableSpool(const std::string &dir, size_t size);
+
+    /*
+     * Producer methods
+     */
+
+    /**
+     * Get the contiguous free space at the write position
+     *
+     * \param [out] ptr     Updated with the pointer to write to
+     *
+     * \return number of bytes that can be written to ptr, zero if the ring is full
+     */
+    size_t writeSpace(unsigned char **ptr);
+
+    /**
+     * Commit bytes written to the pointer returned by writeSpace()
+     *
+     * \param [in] len      Number of bytes written
+     */
+    void commitWrite(size_t len);
+
+    /**
+     * Indicate end of stream, the consumer reads the remaining data and then gets EOF
+     */
+    void closeWrite();
+
+    /**
+     * Wait for free space
+     *
+     * \param [in] timeout  Max time to wait in milliseconds
+     *
+     * \return true if there is free space, false if timed out or the consumer closed
+     */
+    bool waitForSpace(int timeout);
+
+    /**
+     * Request a notification when the consumer frees space
+     *
+     * \details Used by a producer that cannot block, the notify callback is called
+     *          when space is freed.  The caller must check for free space again after
+     *          calling this, since space could have been freed before the request.
+     */
+    void requestSpaceNotify();
+
+    /**
+     * Set the callback for space and consumer close notifications
+     *
+     * \details The callback is called by the consumer thread, or by the thread calling
+     *          close().  It must be set before the consumer starts.
+     *
+     * \param [in] notify   Callback, or an empty function to use the condition variable
+     */
+    void setNotify(const std::function<void()> &notify);
+
+    /*
+     * Consumer methods
+     */
+
+    /**
+     * Read from the ring, blocking until data is available
+     *
+     * \param [out] buf         Buffer to copy the data into
+     * \param [in]  len         Number of bytes to read
+     * \param [in]  wait_all    True to wait until len bytes are available (MSG_WAITALL)
+     * \param [in]  peek        True to leave the data in the ring (MSG_PEEK)
+     *
+     * \return number of bytes read, zero on end of stream. Less than len is only returned
+     *         if wait_all is false or the stream ended.
+     */
+    ssize_t read(void *buf, size_t len, bool wait_all, bool peek);
+
+    /**
+     * Consumer is done, no more data will be read.  The producer is notified.
+     */
+    void closeRead();
+
+    /*
+     * Either side
+     */
+
+    /**
+     * Close both sides and discard any buffered data
+     */
+    void close();
+
+    /**
+     * Number of bytes buffered, including the spool
+     */
+    size_t used();
+
+    /**
+     * Current size of the ring in bytes
+     */
+    size_t size();
+
+    /**
+     * Count a message parsed from the ring, called by the consumer
+     */
+    void countMessage();
+
+    /**
+     * Get the counters of the ring, can be called by any thread
+     *
+     * \details Counters are monotonic, except for used and peak_used.  The peak is
+     *          reset to the current usage by every call.
+     *
+     * \param [out] stats   Updated with the counters
+     */
+    void getStats(Stats &stats);
+
+    /**
+     * Set the global memory budget for all rings
+     *
+     * \details Rings are not grown beyond their initial size if that would exceed
+     *          the budget.  The initial size is always allocated.
+     *
+     * \param [in] budget   Budget in bytes, zero for unlimited
+     */
+    static void setMemoryBudget(uint64_t budget);
+
+    /**
+     * Memory allocated by all rings in bytes
+     */
+    static uint64_t memoryUsed();
+
+    /**
+     * True if the consumer has closed
+     */
+    bool isReadClosed();
+
+    /**
+     * True if the producer has closed (end of stream)
+     */
+    bool isWriteClosed();
+
+private:
+    unsigned char           *buf;               ///< Ring memory
+    std::atomic<size_t>     buf_size;           ///< Current size of the ring in bytes
+    int                     node;               ///< NUMA node of the ring memory, -1 for any
+    size_t                  min_size;           ///< Size the ring is shrunk back to
+    size_t                  max_size;           ///< Size the ring can grow to
+    size_t                  high_watermark;     ///< Ring usage at which the ring is grown or spooled
+
+    std::atomic<bool>       reading;            ///< Consumer is accessing the ring memory
+    std::atomic<bool>       resizing;           ///< Producer is replacing the ring memory
+
+    size_t                  peak_used;          ///< Producer only - peak usage since the last shrink check
+    time_t                  shrink_check;       ///< Producer only - time of the next shrink check
+
+    std::atomic<uint64_t>   stat_messages;      ///< Messages parsed
+    std::atomic<uint64_t>   stat_stalls;        ///< Number of times the producer found no space
+    std::atomic<uint64_t>   stat_stall_us;      ///< Total time without space in microseconds
+    std::atomic<uint64_t>   stat_wraps;         ///< Number of ring wraps
+    std::atomic<size_t>     stat_peak;          ///< Peak usage since the previous getStats()
+    bool                    stalled;            ///< Producer only - true while there is no space
+    std::chrono::steady_clock::time_point stall_start;  ///< Producer only - time the current stall started
+
+    static std::atomic<uint64_t> mem_used;      ///< Memory allocated by all rings
+    static uint64_t         mem_budget;         ///< Global memory budget, zero for unlimited
+
+    std::atomic<uint64_t>   head;               ///< Total bytes consumed
+    std::atomic<uint64_t>   tail;               ///< Total bytes produced
+
+    std::atomic<bool>       write_closed;       ///< Producer closed, end of stream
+    std::atomic<bool>       read_closed;        ///< Consumer closed
+
+    std::atomic<bool>       consumer_waiting;   ///< Consumer is (about to be) sleeping on data_cond
+    std::atomic<bool>       producer_waiting;   ///< Producer wants to be notified of free space
+
+    std::function<void()>   notify;             ///< Notifies the producer, empty to use space_cond
+
+    unsigned char           *spool;             ///< mmap'd spool file, NULL if the spool is disabled
+    int                     spool_fd;           ///< Spool file descriptor
+    size_t                  spool_size;         ///< Size of the spool in bytes
+
+    std::atomic<uint64_t>   spool_head;         ///< Total bytes consumed from the spool
+    std::atomic<uint64_t>   spool_tail;         ///< Total bytes produced to the spool
+    uint64_t                spool_released;     ///< Consumer only - spool position up to which memory was released
+    bool                    spooling;           ///< Producer only - true while writes go to the spool
+
+    std::mutex              lock;               ///< Lock for the condition variables
+    std::condition_variable data_cond;          ///< Signaled when data is committed or stream ends
+    std::condition_variable space_cond;         ///< Signaled when space is freed or consumer closes
+
+    /**
+     * Wait until at least len bytes are available or the stream ended
+     *
+     * \return number of bytes available
+     */
+    size_t waitForData(size_t len);
+
+    /**
+     * Notify the producer of free space or consumer close
+     */
+    void notifyProducer();
+
+    /**
+     * Free space that the producer can write to, ring or spool
+     */
+    size_t freeSpace();
+
+    /**
+     * Replace the ring memory with a buffer of a different size, called by the producer
+     *
+     * \param [in] new_size Size of the new ring, must fit the buffered data
+     *
+     * \return true if resized, false if over budget or the consumer is reading
+     */
+    bool resize(size_t new_size);
+
+    /**
+     * Shrink the ring if its usage stayed low for RING_SHRINK_INTERVAL, called by the producer
+     *
+     * \param [in] ring_used    Current ring usage
+     */
+    void checkShrink(size_t ring_used);
+
+    /**
+     * Wait for a resize to finish and mark the consumer as accessing the ring
+     */
+    void beginRead();
+
+    /**
+     * Track producer stalls, called with the space returned by writeSpace()
+     *
+     * \param [in] space    Space available to the producer
+     *
+     * \return space
+     */
+    size_t trackStall(size_t space);
+
+    /**
+     * Release the memory of consumed spool chunks
+     *
+     * \param [in] pos      Spool position consumed up to
+     */
+    void releaseSpool(uint64_t pos);
+};
+
+#endif /* RINGBUFFER_H_ */
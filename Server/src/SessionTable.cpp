@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#include "SessionTable.h"
+
+#include <sys/time.h>
+#include <cstring>
+
+/**
+ * Class constructor
+ *
+ *  \param [in] logPtr  Pointer to existing Logger for app logging
+ *  \param [in] config  Pointer to the loaded configuration
+ */
+SessionTable::SessionTable(Logger *logPtr, Config *config) {
+    cfg = config;
+    logger = logPtr;
+
+    next_id = 1;
+    concurrent = 0;
+    baseline_updates = cfg->baseline_updates;
+    router_list_dirty = true;
+}
+
+/**
+ * Destructor
+ */
+SessionTable::~SessionTable() {
+    cancelAll();
+}
+
+/**
+ * Add a started session
+ *
+ * \details The session counts as a concurrent router until its baseline time passed.
+ *
+ * \param [in] thr      Thread management entry of the session, owned by the table
+ */
+void SessionTable::add(ThreadMgmt *thr) {
+    thr->session_id = next_id++;
+    thr->sessions = this;
+    thr->baselineTimeout = false;
+
+    sessions[thr->session_id] = thr;
+    ++concurrent;
+
+    Deadline d;
+    d.time = getDeadline(thr);
+    d.id = thr->session_id;
+    deadlines.push(d);
+
+    router_list_dirty = true;
+}
+
+/**
+ * Post a session as ended, called by the session thread as the last use of thr
+ *
+ * \param [in] thr      Thread management entry of the session
+ */
+void SessionTable::finished(ThreadMgmt *thr) {
+    std::lock_guard<std::mutex> guard(finished_lock);
+    finished_list.push_back(thr);
+}
+
+/**
+ * Join and free the sessions that ended
+ *
+ * \return number of sessions removed
+ */
+int SessionTable::reap() {
+    std::vector<ThreadMgmt *> ended;
+
+    {
+        std::lock_guard<std::mutex> guard(finished_lock);
+        if (finished_list.empty())
+            return 0;
+
+        ended.swap(finished_list);
+    }
+
+    for (size_t i = 0; i < ended.size(); i++) {
+        ThreadMgmt *thr = ended[i];
+
+        // Join the thread to clean up
+        pthread_join(thr->thr, NULL);
+
+        // A deadline still in the heap is skipped once the session is gone
+        if (not thr->baselineTimeout)
+            --concurrent;
+
+        sessions.erase(thr->session_id);
+        delete thr;
+    }
+
+    router_list_dirty = true;
+
+    return ended.size();
+}
+
+/**
+ * Stop counting the routers past their baseline time as concurrent routers
+ */
+void SessionTable::checkBaselines() {
+    // A router finished its RIB dump, its deadline moved
+    if (baseline_updates != cfg->baseline_updates) {
+        baseline_updates = cfg->baseline_updates;
+        rebuildDeadlines();
+    }
+
+    timeval now;
+    gettimeofday(&now, NULL);
+
+    while (not deadlines.empty() and deadlines.top().time <= now.tv_sec) {
+        Deadline d = deadlines.top();
+        deadlines.pop();
+
+        std::unordered_map<uint64_t, ThreadMgmt *>::iterator it = sessions.find(d.id);
+        if (it == sessions.end() or it->second->baselineTimeout)
+            continue;
+
+        // The router hash can change with the init message, check with the current one
+        d.time = getDeadline(it->second);
+
+        if (d.time <= now.tv_sec) {
+            --concurrent;
+            it->second->baselineTimeout = true;     // Indicating that this router is not counted in the concurrent routers count
+
+        } else {
+            deadlines.push(d);
+        }
+    }
+}
+
+/**
+ * Recompute the deadlines of all routers still within their baseline
+ */
+void SessionTable::rebuildDeadlines() {
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline> > rebuilt;
+
+    for (std::unordered_map<uint64_t, ThreadMgmt *>::iterator it = sessions.begin();
+            it != sessions.end(); ++it) {
+
+        if (it->second->baselineTimeout)
+            continue;
+
+        Deadline d;
+        d.time = getDeadline(it->second);
+        d.id = it->first;
+        rebuilt.push(d);
+    }
+
+    deadlines.swap(rebuilt);
+}
+
+/**
+ * Get the time the baseline of a session passes
+ *
+ * \details The baseline of the router is used if known, otherwise initial_router_time.
+ *
+ * \param [in] thr      Thread management entry of the session
+ *
+ * \return time in seconds since epoch
+ */
+time_t SessionTable::getDeadline(ThreadMgmt *thr) {
+    int initial_time = cfg->initial_router_time;
+
+    //if calculate_baseline is true and the baseline time for the router is calculated, use the baseline time
+    if (cfg->calculate_baseline) {
+        std::string hash(reinterpret_cast<char*>(thr->client.hash_id), 16);
+
+        std::lock_guard<std::mutex> guard(cfg->router_baseline_lock);
+        Config::router_baseline_time_iter it = cfg->router_baseline_time.find(hash);
+
+        if (it != cfg->router_baseline_time.end())
+            initial_time = it->second;
+    }
+
+    return thr->client.startTime.tv_sec + initial_time;
+}
+
+/**
+ * Ask all sessions to stop reading their router and end once the buffered data is parsed
+ */
+void SessionTable::drainAll() {
+    for (std::unordered_map<uint64_t, ThreadMgmt *>::iterator it = sessions.begin();
+            it != sessions.end(); ++it)
+        it->second->draining = true;
+}
+
+/**
+ * Cancel and join all sessions, used on shutdown
+ */
+void SessionTable::cancelAll() {
+    std::unordered_map<uint64_t, ThreadMgmt *>::iterator it;
+
+    // Cancel all before joining any, so that the sessions tear down in parallel
+    for (it = sessions.begin(); it != sessions.end(); ++it) {
+        if (it->second->running) {
+            pthread_cancel(it->second->thr);
+            it->second->running = false;
+        }
+    }
+
+    for (it = sessions.begin(); it != sessions.end(); ++it) {
+        pthread_join(it->second->thr, NULL);
+        delete it->second;
+    }
+
+    sessions.clear();
+    concurrent = 0;
+
+    std::lock_guard<std::mutex> guard(finished_lock);
+    finished_list.clear();
+
+    router_list_dirty = true;
+}
+
+/**
+ * Get the number of active sessions
+ */
+size_t SessionTable::size() {
+    return sessions.size();
+}
+
+/**
+ * Get the number of routers still within their baseline time
+ */
+int SessionTable::concurrentRouters() {
+    return concurrent;
+}
+
+/**
+ * Get the list of sessions, for periodic reporting
+ *
+ * \param [out] list    Thread management entries of the active sessions
+ */
+void SessionTable::getSessions(std::vector<ThreadMgmt *> &list) {
+    list.clear();
+    list.reserve(sessions.size());
+
+    for (std::unordered_map<uint64_t, ThreadMgmt *>::iterator it = sessions.begin();
+            it != sessions.end(); ++it)
+        list.push_back(it->second);
+}
+
+/**
+ * Get the printed list of router addresses
+ *
+ * \details The list is only rebuilt after sessions were added or removed, and only
+ *          up to the size of the buffer.
+ *
+ * \param [out] buf     Buffer for the comma separated router addresses
+ * \param [in]  len     Size of the buffer
+ */
+void SessionTable::getRouterList(char *buf, size_t len) {
+    if (router_list_dirty) {
+        router_list.clear();
+
+        for (std::unordered_map<uint64_t, ThreadMgmt *>::iterator it = sessions.begin();
+                it != sessions.end() and router_list.size() < len; ++it) {
+
+            if (router_list.size() > 0)
+                router_list.append(", ");
+
+            router_list.append(it->second->client.c_ip);
+        }
+
+        router_list_dirty = false;
+    }
+
+    snprintf(buf, len, "%s", router_list.c_str());
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2013-2015 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+#ifndef SESSIONTABLE_H_
+#define SESSIONTABLE_H_
+
+#include "client_thread.h"
+#include "Logger.h"
+#include "Config.h"
+
+#include <mutex>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * \class   SessionTable
+ *
+ * \brief   Registry of the active router sessions
+ * \details Sessions are indexed by session ID, so adding and removing one doesn't
+ *          depend on the number of routers.  Session threads post themselves when they
+ *          end and only those are joined, instead of polling every session on each
+ *          accept.
+ *
+ *          Routers count against max_concurrent_routers until their initial RIB dump
+ *          time (baseline) has passed.  The deadlines are kept in a heap, ordered by
+ *          time, and are only re-evaluated when a router records a new baseline.
+ *
+ *          All methods are called from the main thread, except finished().
+ */
+class SessionTable {
+public:
+    /**
+     * Class constructor
+     *
+     *  \param [in] logPtr  Pointer to existing Logger for app logging
+     *  \param [in] config  Pointer to the loaded configuration
+     */
+    SessionTable(Logger *logPtr, Config *config);
+
+    virtual ~SessionTable();
+
+    /**
+     * Add a started session
+     *
+     * \details The session counts as a concurrent router until its baseline time passed.
+     *
+     * \param [in] thr      Thread management entry of the session, owned by the table
+     */
+    void add(ThreadMgmt *thr);
+
+    /**
+     * Post a session as ended, called by the session thread as the last use of thr
+     *
+     * \param [in] thr      Thread management entry of the session
+     */
+    void finished(ThreadMgmt *thr);
+
+    /**
+     * Join and free the sessions that ended
+     *
+     * \return number of sessions removed
+     */
+    int reap();
+
+    /**
+     * Stop counting the routers past their baseline time as concurrent routers
+     */
+    void checkBaselines();
+
+    /**
+     * Ask all sessions to stop reading their router and end once the buffered data is parsed
+     *
+     * \details Sessions post that they ended as usual, reap() frees them.
+     */
+    void drainAll();
+
+    /**
+     * Cancel and join all sessions, used on shutdown
+     */
+    void cancelAll();
+
+    /**
+     * Get the number of active sessions
+     */
+    size_t size();
+
+    /**
+     * Get the number of routers still within their baseline time
+     */
+    int concurrentRouters();
+
+    /**
+     * Get the list of sessions, for periodic reporting
+     *
+     * \param [out] list    Thread management entries of the active sessions
+     */
+    void getSessions(std::vector<ThreadMgmt *> &list);
+
+    /**
+     * Get the printed list of router addresses
+     *
+     * \details The list is only rebuilt after sessions were added or removed, and only
+     *          up to the size of the buffer.
+     *
+     * \param [out] buf     Buffer for the comma separated router addresses
+     * \param [in]  len     Size of the buffer
+     */
+    void getRouterList(char *buf, size_t len);
+
+public:
+    Logger      *logger;                    ///< Logging class pointer
+
+private:
+    /**
+     * Baseline deadline of a session
+     */
+    struct Deadline {
+        time_t      time;                   ///< Time the baseline passes
+        uint64_t    id;                     ///< Session ID
+
+        bool operator>(const Deadline &other) const {
+            return time > other.time;
+        }
+    };
+
+    Config      *cfg;                       ///< Config pointer
+
+    uint64_t    next_id;                    ///< Session ID of the next added session
+    std::unordered_map<uint64_t, ThreadMgmt *> sessions;    ///< Active sessions by session ID
+    int         concurrent;                 ///< Number of sessions within their baseline time
+
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline> > deadlines;    ///< Earliest first
+    uint32_t    baseline_updates;           ///< Config baseline_updates the deadlines are based on
+
+    std::mutex  finished_lock;              ///< Protects finished_list
+    std::vector<ThreadMgmt *> finished_list;    ///< Sessions posted as ended, not yet joined
+
+    std::string router_list;                ///< Cached printed router list
+    bool        router_list_dirty;          ///< True if sessions changed since router_list was built
+
+    /**
+     * Get the time the baseline of a session passes
+     *
+     * \details The baseline of the router is used if known, otherwise initial_router_time.
+     *
+     * \param [in] thr      Thread management entry of the session
+     *
+     * \return time in seconds since epoch
+     */
+    time_t getDeadline(ThreadMgmt *thr);
+
+    /**
+     * Recompute the deadlines of all routers still within their baseline
+     */
+    void rebuildDeadlines();
+};
+
+#endif /* SESSIONTABLE_H_ */
@@ -112,20 +112,8 @@ void MPReachAttr::parseAfi(mp_reach_nlri &nlri, UpdateMsg::parsed_update_data &p
 
         case bgp::BGP_AFI_L2VPN :
         {
-            u_char      ip_raw[16];
-            char        ip_char[40];
-
-            bzero(ip_raw, sizeof(ip_raw));
-
             // Next-hop is an IP address - Change/set the next-hop attribute in parsed data to use this next-hop
-            if (nlri.nh_len > 16)
-                memcpy(ip_raw, nlri.next_hop, 16);
-            else
-                memcpy(ip_raw, nlri.next_hop, nlri.nh_len);
-
-            inet_ntop(nlri.nh_len == 4 ? AF_INET : AF_INET6, ip_raw, ip_char, sizeof(ip_char));
-
-            parsed_data.attrs[ATTR_TYPE_NEXT_HOP] = std::string(ip_char);
+            UpdateMsg::setNextHop(parsed_data, nlri.next_hop, nlri.nh_len, nlri.nh_len == 4);
 
             // parse by safi
             switch (nlri.safi) {
@@ -160,11 +148,8 @@ void MPReachAttr::parseAfi(mp_reach_nlri &nlri, UpdateMsg::parsed_update_data &p
  * \param [out]  parsed_data    Reference to parsed_update_data; will be updated with all parsed data
  */
 void MPReachAttr::parseAfi_IPv4IPv6(bool isIPv4, mp_reach_nlri &nlri, UpdateMsg::parsed_update_data &parsed_data) {
-    u_char      ip_raw[16];
-    char        ip_char[40];
+    NlriBatch::DECODE_STATUS status = NlriBatch::NLRI_OK;
 
-    bzero(ip_raw, sizeof(ip_raw));
-    
     /*
      * Decode based on SAFI
      */
@@ -172,32 +157,18 @@ void MPReachAttr::parseAfi_IPv4IPv6(bool isIPv4, mp_reach_nlri &nlri, UpdateMsg:
         case bgp::BGP_SAFI_UNICAST: // Unicast IP address prefix
 
             // Next-hop is an IP address - Change/set the next-hop attribute in parsed data to use this next-hop
-            if (nlri.nh_len > 16)
-                memcpy(ip_raw, nlri.next_hop, 16);
-            else
-                memcpy(ip_raw, nlri.next_hop, nlri.nh_len);
-
-            inet_ntop(isIPv4 ? AF_INET : AF_INET6, ip_raw, ip_char, sizeof(ip_char));
-
-            parsed_data.attrs[ATTR_TYPE_NEXT_HOP] = std::string(ip_char);
+            UpdateMsg::setNextHop(parsed_data, nlri.next_hop, nlri.nh_len, isIPv4);
 
             // Data is an IP address - parse the address and save it
-            parseNlriData_IPv4IPv6(isIPv4, nlri.nlri_data, nlri.nlri_len, peer_info, parsed_data.advertised);
+            status = parseNlriData_IPv4IPv6(isIPv4, nlri.nlri_data, nlri.nlri_len, peer_info, parsed_data.advertised);
             break;
 
         case bgp::BGP_SAFI_NLRI_LABEL:
             // Next-hop is an IP address - Change/set the next-hop attribute in parsed data to use this next-hop
-            if (nlri.nh_len > 16)
-                memcpy(ip_raw, nlri.next_hop, 16);
-            else
-                memcpy(ip_raw, nlri.next_hop, nlri.nh_len);
-
-            inet_ntop(isIPv4 ? AF_INET : AF_INET6, ip_raw, ip_char, sizeof(ip_char));
-
-            parsed_data.attrs[ATTR_TYPE_NEXT_HOP] = std::string(ip_char);
+            UpdateMsg::setNextHop(parsed_data, nlri.next_hop, nlri.nh_len, isIPv4);
 
             // Data is an Label, IP address tuple parse and save it
-            parseNlriData_LabelIPv4IPv6(isIPv4, nlri.nlri_data, nlri.nlri_len, peer_info, parsed_data.advertised);
+            status = parseNlriData_LabelIPv4IPv6(isIPv4, nlri.nlri_data, nlri.nlri_len, peer_info, parsed_data.advertised);
             break;
 
         case bgp::BGP_SAFI_MPLS: {
@@ -209,14 +180,7 @@ void MPReachAttr::parseAfi_IPv4IPv6(bool isIPv4, mp_reach_nlri &nlri, UpdateMsg:
             }
 
             // Next-hop is an IP address - Change/set the next-hop attribute in parsed data to use this next-hop
-            if (nlri.nh_len > 16)
-                memcpy(ip_raw, nlri.next_hop, 16);
-            else
-                memcpy(ip_raw, nlri.next_hop, nlri.nh_len);
-
-            inet_ntop(isIPv4 ? AF_INET : AF_INET6, ip_raw, ip_char, sizeof(ip_char));
-
-            parsed_data.attrs[ATTR_TYPE_NEXT_HOP] = std::string(ip_char);
+            UpdateMsg::setNextHop(parsed_data, nlri.next_hop, nlri.nh_len, isIPv4);
 
             parseNlriData_LabelIPv4IPv6(isIPv4, nlri.nlri_data, nlri.nlri_len, peer_info, parsed_data.vpn);
 
@@ -228,6 +192,10 @@ void MPReachAttr::parseAfi_IPv4IPv6(bool isIPv4, mp_reach_nlri &nlri, UpdateMsg:
                      peer_addr.c_str(), isIPv4, nlri.safi);
             return;
     }
+
+    if (status != NlriBatch::NLRI_OK)
+        LOG_NOTICE("%s: MP_REACH AFI=ipv4/ipv6 (%d) SAFI=%d NLRI is invalid, %s; skipping the rest",
+                   peer_addr.c_str(), isIPv4, nlri.safi, NlriBatch::statusStr(status));
 }
 
 /**
@@ -240,63 +208,54 @@ void MPReachAttr::parseAfi_IPv4IPv6(bool isIPv4, mp_reach_nlri &nlri, UpdateMsg:
  * \param [in]   data                   Pointer to the start of the prefixes to be parsed
  * \param [in]   len                    Length of the data in bytes to be read
  * \param [in]   peer_info              Persistent Peer info pointer
- * \param [out]  prefixes               Reference to a list<prefix_tuple> to be updated with entries
+ * \param [out]  prefixes               Reference to a vector<prefix_tuple> to be updated with entries
+ *
+ * \returns NlriBatch::NLRI_OK or the reason decoding stopped
  */
-void MPReachAttr::parseNlriData_IPv4IPv6(bool isIPv4, u_char *data, uint16_t len,
-                                         BMPReader::peer_info * peer_info,
-                                         std::list<bgp::prefix_tuple> &prefixes) {
-    u_char            ip_raw[16];
-    char              ip_char[40];
-    u_char            addr_bytes;
-    bgp::prefix_tuple tuple;
-
-    if (len <= 0 or data == NULL)
-        return;
-
-    // TODO: Can extend this to support multicast, but right now we set it to unicast v4/v6
-    tuple.type = isIPv4 ? bgp::PREFIX_UNICAST_V4 : bgp::PREFIX_UNICAST_V6;
-    tuple.isIPv4 = isIPv4;
+NlriBatch::DECODE_STATUS MPReachAttr::parseNlriData_IPv4IPv6(bool isIPv4, u_char *data, uint16_t len,
+                                                             BMPReader::peer_info * peer_info,
+                                                             std::vector<bgp::prefix_tuple> &prefixes) {
 
     bool add_path_enabled = peer_info->add_path_capability.isAddPathEnabled(isIPv4 ? bgp::BGP_AFI_IPV4 : bgp::BGP_AFI_IPV6,
                                                                             bgp::BGP_SAFI_UNICAST);
 
-    // Loop through all prefixes
-    for (size_t read_size=0; read_size < len; read_size++) {
-        tuple.path_id = 0;
-
-        bzero(ip_raw, sizeof(ip_raw));
+    // TODO: Can extend this to support multicast, but right now we set it to unicast v4/v6
+    NlriBatch::DECODE_STATUS status = peer_info->nlri_batch->decode(isIPv4, add_path_enabled, false, data, len);
 
-        // Parse add-paths if enabled
-        if (add_path_enabled and (len - read_size) >= 4) {
-            memcpy(&tuple.path_id, data, 4);
-            bgp::SWAP_BYTES(&tuple.path_id);
-            data += 4; read_size += 4;
-        } else
-            tuple.path_id = 0;
+    // The raw/binary address is only printed when written to the message bus
+    peer_info->nlri_batch->toTuples(isIPv4 ? bgp::PREFIX_UNICAST_V4 : bgp::PREFIX_UNICAST_V6, prefixes);
 
-        // set the address in bits length
-        tuple.len = *data++;
-
-        // Figure out how many bytes the bits requires
-        addr_bytes = tuple.len / 8;
-        if (tuple.len % 8)
-           ++addr_bytes;
+    return status;
+}
 
-        memcpy(ip_raw, data, addr_bytes);
-        data += addr_bytes;
-        read_size += addr_bytes;
+/**
+ * Parses mp_reach_nlri and mp_unreach_nlri labeled unicast (IPv4/IPv6)
+ *
+ * \details
+ *      Will parse the NLRI encoding as defined in RFC3107 Section 3 (Carrying Label Mapping information).
+ *      VPN prefixes carry a route distinguisher and are parsed by the template below.
+ *
+ * \param [in]   isIPv4                 True false to indicate if IPv4 or IPv6
+ * \param [in]   data                   Pointer to the start of the label + prefixes to be parsed
+ * \param [in]   len                    Length of the data in bytes to be read
+ * \param [in]   peer_info              Persistent Peer info pointer
+ * \param [out]  prefixes               Reference to a vector<prefix_tuple> to be updated with entries
+ *
+ * \returns NlriBatch::NLRI_OK or the reason decoding stopped
+ */
+NlriBatch::DECODE_STATUS MPReachAttr::parseNlriData_LabelIPv4IPv6(bool isIPv4, u_char *data, uint16_t len,
+                                                                  BMPReader::peer_info * peer_info,
+                                                                  std::vector<bgp::prefix_tuple> &prefixes) {
 
-        // Convert the IP to string printed format
-        inet_ntop(isIPv4 ? AF_INET : AF_INET6, ip_raw, ip_char, sizeof(ip_char));
+    bool add_path_enabled = peer_info->add_path_capability.isAddPathEnabled(isIPv4 ? bgp::BGP_AFI_IPV4 : bgp::BGP_AFI_IPV6,
+                                                                            bgp::BGP_SAFI_NLRI_LABEL);
 
-        tuple.prefix.assign(ip_char);
+    NlriBatch::DECODE_STATUS status = peer_info->nlri_batch->decode(isIPv4, add_path_enabled, true, data, len);
 
-        // set the raw/binary address
-        memcpy(tuple.prefix_bin, ip_raw, sizeof(ip_raw));
+    // Default routes have an all zeros prefix
+    peer_info->nlri_batch->toTuples(isIPv4 ? bgp::PREFIX_LABEL_UNICAST_V4 : bgp::PREFIX_LABEL_UNICAST_V6, prefixes);
 
-        // Add tuple to prefix list
-        prefixes.push_back(tuple);
-    }
+    return status;
 }
 
 /**
@@ -309,14 +268,13 @@ void MPReachAttr::parseNlriData_IPv4IPv6(bool isIPv4, u_char *data, uint16_t len
  * \param [in]   data                   Pointer to the start of the label + prefixes to be parsed
  * \param [in]   len                    Length of the data in bytes to be read
  * \param [in]   peer_info              Persistent Peer info pointer
- * \param [out]  prefixes               Reference to a list<label, prefix_tuple> to be updated with entries
+ * \param [out]  prefixes               Reference to a vector<label, prefix_tuple> to be updated with entries
  */
 template <typename PREFIX_TUPLE>
 void MPReachAttr::parseNlriData_LabelIPv4IPv6(bool isIPv4, u_char *data, uint16_t len,
                                               BMPReader::peer_info * peer_info,
-                                              std::list<PREFIX_TUPLE> &prefixes) {
+                                              std::vector<PREFIX_TUPLE> &prefixes) {
     u_char            ip_raw[16];
-    char              ip_char[40];
     int               addr_bytes;
     PREFIX_TUPLE      tuple;
 
@@ -355,7 +313,7 @@ void MPReachAttr::parseNlriData_LabelIPv4IPv6(bool isIPv4, u_char *data, uint16_
         if (tuple.len % 8)
            ++addr_bytes;
 
-        label_bytes = decodeLabel(data, addr_bytes, tuple.labels);
+        label_bytes = decodeLabel(data, addr_bytes, tuple.labels, sizeof(tuple.labels));
 
         tuple.len -= (8 * label_bytes);      // Update prefix len to not include the label(s)
         data += label_bytes;               // move data pointer past labels
@@ -378,19 +336,11 @@ void MPReachAttr::parseNlriData_LabelIPv4IPv6(bool isIPv4, u_char *data, uint16_
             memcpy(ip_raw, data, addr_bytes);
             data += addr_bytes;
             read_size += addr_bytes;
-
-            // Convert the IP to string printed format
-            inet_ntop(isIPv4 ? AF_INET : AF_INET6, ip_raw, ip_char, sizeof(ip_char));
-
-            tuple.prefix.assign(ip_char);
-
-            // set the raw/binary address
-            memcpy(tuple.prefix_bin, ip_raw, sizeof(ip_raw));
-
-        } else {
-            tuple.prefix.assign(isIPv4 ? "0.0.0.0" : "::");
         }
 
+        // set the raw/binary address, all zeros for a default route
+        memcpy(tuple.prefix_bin, ip_raw, sizeof(ip_raw));
+
         prefixes.push_back(tuple);
     }
 }
@@ -403,13 +353,15 @@ void MPReachAttr::parseNlriData_LabelIPv4IPv6(bool isIPv4, u_char *data, uint16_
  *
  * \param [in]   data                   Pointer to the start of the label + prefixes to be parsed
  * \param [in]   len                    Length of the data in bytes to be read
- * \param [out]  labels                 Reference to string that will be updated with labels delimited by comma
+ * \param [out]  labels                 String that will be updated with labels delimited by comma
+ * \param [in]   labels_size            Size of labels, longer label stacks are truncated
  *
  * \returns number of bytes read to decode the label(s) and updates string labels
  *
  */
-inline uint16_t MPReachAttr::decodeLabel(u_char *data, uint16_t len, std::string &labels) {
+inline uint16_t MPReachAttr::decodeLabel(u_char *data, uint16_t len, char *labels, size_t labels_size) {
     int read_size = 0;
+    size_t labels_len = 0;
     typedef union {
         struct {
             uint8_t   ttl     : 8;          // TTL - not present since only 3 octets are used
@@ -422,7 +374,7 @@ inline uint16_t MPReachAttr::decodeLabel(u_char *data, uint16_t len, std::string
 
     mpls_label label;
 
-    labels.clear();
+    labels[0] = 0;
 
     u_char *data_ptr = data;
 
@@ -437,17 +389,16 @@ inline uint16_t MPReachAttr::decodeLabel(u_char *data, uint16_t len, std::string
         data_ptr += 3;
         read_size += 3;
 
-        ostringstream convert;
-        convert << label.decode.value;
-        labels.append(convert.str());
+        if (labels_len < labels_size)
+            labels_len += snprintf(labels + labels_len, labels_size - labels_len, "%u", (unsigned int)label.decode.value);
 
         //printf("label data = %x\n", label.data);
         if (label.decode.bos == 1 or label.data == 0x80000000 /* withdrawn label as 32bits instead of 24 */
                 or label.data == 0 /* l3vpn seems to use zero instead of rfc3107 suggested value */) {
             break;               // Reached EoS
 
-        } else {
-            labels.append(",");
+        } else if (labels_len < labels_size) {
+            labels_len += snprintf(labels + labels_len, labels_size - labels_len, ",");
         }
     }
 
@@ -11,10 +11,11 @@
 
 #include "bgp_common.h"
 #include "Logger.h"
-#include <list>
 #include <string>
+#include <vector>
 
 #include "UpdateMsg.h"
+#include "NlriBatch.h"
 
 namespace bgp_msg {
 
@@ -79,11 +80,32 @@ public:
      * \param [in]   data                       Pointer to the start of the prefixes to be parsed
      * \param [in]   len                        Length of the data in bytes to be read
      * \param [in]   peer_info                  Persistent Peer info pointer
-     * \param [out]  prefixes                   Reference to a list<prefix_tuple> to be updated with entries
+     * \param [out]  prefixes                   Reference to a vector<prefix_tuple> to be updated with entries
+     *
+     * \returns NlriBatch::NLRI_OK or the reason decoding stopped
+     */
+    static NlriBatch::DECODE_STATUS parseNlriData_IPv4IPv6(bool isIPv4, u_char *data, uint16_t len,
+                                                           BMPReader::peer_info *peer_info,
+                                                           std::vector<bgp::prefix_tuple> &prefixes);
+
+    /**
+     * Parses mp_reach_nlri and mp_unreach_nlri labeled unicast (IPv4/IPv6)
+     *
+     * \details
+     *      Will parse the NLRI encoding as defined in RFC3107 Section 3 (Carrying Label Mapping information).
+     *      VPN prefixes carry a route distinguisher and are parsed by the template below.
+     *
+     * \param [in]   isIPv4                 True false to indicate if IPv4 or IPv6
+     * \param [in]   data                   Pointer to the start of the label + prefixes to be parsed
+     * \param [in]   len                    Length of the data in bytes to be read
+     * \param [in]   peer_info              Persistent Peer info pointer
+     * \param [out]  prefixes               Reference to a vector<prefix_tuple> to be updated with entries
+     *
+     * \returns NlriBatch::NLRI_OK or the reason decoding stopped
      */
-    static void parseNlriData_IPv4IPv6(bool isIPv4, u_char *data, uint16_t len,
-                                       BMPReader::peer_info *peer_info,
-                                       std::list<bgp::prefix_tuple> &prefixes);
+    static NlriBatch::DECODE_STATUS parseNlriData_LabelIPv4IPv6(bool isIPv4, u_char *data, uint16_t len,
+                                                                BMPReader::peer_info *peer_info,
+                                                                std::vector<bgp::prefix_tuple> &prefixes);
 
     /**
      * Parses mp_reach_nlri and mp_unreach_nlri (IPv4/IPv6)
@@ -95,12 +117,12 @@ public:
      * \param [in]   data                   Pointer to the start of the label + prefixes to be parsed
      * \param [in]   len                    Length of the data in bytes to be read
      * \param [in]   peer_info              Persistent Peer info pointer
-     * \param [out]  prefixes               Reference to a list<label, prefix_tuple> to be updated with entries
+     * \param [out]  prefixes               Reference to a vector<label, prefix_tuple> to be updated with entries
      */
     template <typename PREFIX_TUPLE>
     static void parseNlriData_LabelIPv4IPv6(bool isIPv4, u_char *data, uint16_t len,
                                             BMPReader::peer_info *peer_info,
-                                            std::list<PREFIX_TUPLE> &prefixes);
+                                            std::vector<PREFIX_TUPLE> &prefixes);
 
     /**
      * Decode label from NLRI data
@@ -110,12 +132,13 @@ public:
      *
      * \param [in]   data                   Pointer to the start of the label + prefixes to be parsed
      * \param [in]   len                    Length of the data in bytes to be read
-     * \param [out]  labels                 Reference to string that will be updated with labels delimited by comma
+     * \param [out]  labels                 String that will be updated with labels delimited by comma
+     * \param [in]   labels_size            Size of labels, longer label stacks are truncated
      *
      * \returns number of bytes read to decode the label(s) and updates string labels
      *
      */
-    static inline uint16_t decodeLabel(u_char *data, uint16_t len, std::string &labels);
+    static inline uint16_t decodeLabel(u_char *data, uint16_t len, char *labels, size_t labels_size);
 
 private:
     bool                    debug;                  ///< debug flag to indicate debugging
@@ -75,6 +75,16 @@ void MPUnReachAttr::parseUnReachNlriAttr(int attr_len, u_char *data, bgp_msg::Up
 	peer_info->endOfRIB = true;		// Indicates End-Of-RIB Marker is received
         LOG_INFO("%s: End-Of-RIB marker (mp_unreach len=0)", peer_addr.c_str());
 
+        // Only the unicast families are tracked by prefix
+        bool ipv4 = nlri.afi == bgp::BGP_AFI_IPV4;
+
+        if (ipv4 or nlri.afi == bgp::BGP_AFI_IPV6) {
+            if (nlri.safi == bgp::BGP_SAFI_UNICAST)
+                parsed_data.end_of_rib = ipv4 ? bgp::PREFIX_UNICAST_V4 : bgp::PREFIX_UNICAST_V6;
+            else if (nlri.safi == bgp::BGP_SAFI_NLRI_LABEL)
+                parsed_data.end_of_rib = ipv4 ? bgp::PREFIX_LABEL_UNICAST_V4 : bgp::PREFIX_LABEL_UNICAST_V6;
+        }
+
     } else {
         /*
          * NLRI data depends on the AFI & SAFI
@@ -147,6 +157,7 @@ void MPUnReachAttr::parseAfi(mp_unreach_nlri &nlri, UpdateMsg::parsed_update_dat
  * \param [out]  parsed_data    Reference to parsed_update_data; will be updated with all parsed data
  */
 void MPUnReachAttr::parseAfi_IPv4IPv6(bool isIPv4, mp_unreach_nlri &nlri, UpdateMsg::parsed_update_data &parsed_data) {
+    NlriBatch::DECODE_STATUS status = NlriBatch::NLRI_OK;
 
     /*
      * Decode based on SAFI
@@ -155,13 +166,13 @@ void MPUnReachAttr::parseAfi_IPv4IPv6(bool isIPv4, mp_unreach_nlri &nlri, Update
         case bgp::BGP_SAFI_UNICAST: // Unicast IP address prefix
 
             // Data is an IP address - parse the address and save it
-            MPReachAttr::parseNlriData_IPv4IPv6(isIPv4, nlri.nlri_data, nlri.nlri_len, peer_info,
-                                                parsed_data.withdrawn);
+            status = MPReachAttr::parseNlriData_IPv4IPv6(isIPv4, nlri.nlri_data, nlri.nlri_len, peer_info,
+                                                         parsed_data.withdrawn);
             break;
 
         case bgp::BGP_SAFI_NLRI_LABEL: // Labeled unicast
-            MPReachAttr::parseNlriData_LabelIPv4IPv6(isIPv4, nlri.nlri_data, nlri.nlri_len, peer_info,
-                                                     parsed_data.withdrawn);
+            status = MPReachAttr::parseNlriData_LabelIPv4IPv6(isIPv4, nlri.nlri_data, nlri.nlri_len, peer_info,
+                                                              parsed_data.withdrawn);
             break;
 
         case bgp::BGP_SAFI_MPLS: // MPLS (vpnv4/vpnv6)
@@ -175,6 +186,10 @@ void MPUnReachAttr::parseAfi_IPv4IPv6(bool isIPv4, mp_unreach_nlri &nlri, Update
                      peer_addr.c_str(), isIPv4, nlri.safi);
             return;
     }
+
+    if (status != NlriBatch::NLRI_OK)
+        LOG_NOTICE("%s: MP_UNREACH AFI=ipv4/ipv6 (%d) SAFI=%d NLRI is invalid, %s; skipping the rest",
+                   peer_addr.c_str(), isIPv4, nlri.safi, NlriBatch::statusStr(status));
 }
 
 } /* namespace bgp_msg */
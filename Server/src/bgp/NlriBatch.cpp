@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2013-2016 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+#include "NlriBatch.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define NLRI_BATCH_MIN_PREFIXES     64      ///< Prefixes the arrays are first sized for
+
+namespace bgp_msg {
+
+/**
+ * Masks of each prefix length, keeping the first len bits of 16 bytes
+ */
+struct PrefixMasks {
+    uint8_t mask[129][16] __attribute__((aligned(16)));
+
+    PrefixMasks() {
+        memset(mask, 0, sizeof(mask));
+
+        for (int len = 1; len <= 128; len++) {
+            memset(mask[len], 0xFF, len / 8);
+
+            if (len % 8)
+                mask[len][len / 8] = 0xFF << (8 - len % 8);
+        }
+    }
+};
+
+static const PrefixMasks prefix_masks;
+
+NlriBatch::NlriBatch() {
+    count = 0;
+    isIPv4 = true;
+}
+
+NlriBatch::~NlriBatch() {
+}
+
+/**
+ * Decode the prefixes of an NLRI field
+ *
+ * \details Prefixes before the first invalid one are kept; the rest of the field
+ *          can't be framed and is dropped.
+ *
+ * \param [in]   isIPv4     True false to indicate if IPv4 or IPv6
+ * \param [in]   add_path   True if add path is enabled for the AFI/SAFI
+ * \param [in]   labeled    True if the prefixes carry labels (RFC3107)
+ * \param [in]   data       Pointer to the start of the prefixes
+ * \param [in]   len        Length of the data in bytes
+ *
+ * \returns NLRI_OK or the reason decoding stopped
+ */
+NlriBatch::DECODE_STATUS NlriBatch::decode(bool isIPv4, bool add_path, bool labeled,
+                                           const u_char *data, uint16_t len) {
+    DECODE_STATUS status = NLRI_OK;
+    size_t read_size = 0;
+
+    this->isIPv4 = isIPv4;
+    count = 0;
+    labels.clear();
+
+    if (len <= 0 or data == NULL)
+        return NLRI_OK;
+
+    // Frame the records, the offset of each depends on the length of the one before
+    while (read_size < len) {
+        uint32_t path_id = 0;
+
+        if (count == lens.size())
+            grow();
+
+        if (add_path and (len - read_size) >= 4) {
+            memcpy(&path_id, data + read_size, 4);
+            bgp::SWAP_BYTES(&path_id);
+            read_size += 4;
+        }
+
+        if (read_size >= len) {
+            status = NLRI_TRUNCATED;
+            break;
+        }
+
+        int bits = data[read_size++];
+        size_t addr_bytes = (bits + 7) / 8;
+
+        if (addr_bytes > len - read_size) {
+            status = NLRI_TRUNCATED;
+            break;
+        }
+
+        // Labels are 3 octets, the last one has the bottom of stack bit set
+        size_t label_bytes = 0;
+        label_first[count] = labels.size();
+
+        while (labeled) {
+            if (label_bytes + 3 > addr_bytes) {
+                status = NLRI_BAD_LABEL;
+                break;
+            }
+
+            const u_char *label = data + read_size + label_bytes;
+            uint32_t raw = label[0] << 16 | label[1] << 8 | label[2];
+
+            labels.push_back(raw >> 4);
+            label_bytes += 3;
+
+            if ((raw & 1) or raw == 0x800000 /* withdrawn label */
+                    or raw == 0 /* l3vpn seems to use zero instead of rfc3107 suggested value */)
+                break;
+        }
+
+        if (status != NLRI_OK or bits < (int)(8 * label_bytes)) {
+            status = NLRI_BAD_LABEL;
+            labels.resize(label_first[count]);
+            break;
+        }
+
+        lens[count] = bits - 8 * label_bytes;
+        path_ids[count] = path_id;
+        label_count[count] = labels.size() - label_first[count];
+        offsets[count] = read_size + label_bytes;
+
+        read_size += addr_bytes;
+        ++count;
+    }
+
+    size_t bad = checkLengths(isIPv4 ? 32 : 128);
+    if (bad < count) {
+        count = bad;
+        labels.resize(label_first[bad]);
+        status = NLRI_BAD_LENGTH;
+    }
+
+    copyPrefixes(data, len);
+
+    return status;
+}
+
+/**
+ * Get the labels of a prefix in the format of label,label,...
+ *
+ * \param [in]   i          Index of the prefix
+ * \param [out]  str        Labels, empty if none; truncated to the buffer
+ * \param [in]   size       Size of str
+ */
+void NlriBatch::getLabels(size_t i, char *str, size_t size) const {
+    size_t len = 0;
+
+    str[0] = 0;
+
+    for (uint32_t l = 0; l < label_count[i] and len < size; l++)
+        len += snprintf(str + len, size - len, l ? ",%u" : "%u", labels[label_first[i] + l]);
+}
+
+/**
+ * Append the decoded prefixes to a prefix vector
+ *
+ * \param [in]   type       Prefix type of the entries
+ * \param [out]  tuples     Reference to a vector<prefix_tuple> to be updated with entries
+ */
+void NlriBatch::toTuples(bgp::PREFIX_TYPE type, std::vector<bgp::prefix_tuple> &tuples) const {
+    size_t first = tuples.size();
+
+    tuples.resize(first + count);
+
+    for (size_t i = 0; i < count; i++) {
+        bgp::prefix_tuple &tuple = tuples[first + i];
+
+        tuple.type = type;
+        tuple.isIPv4 = isIPv4;
+        tuple.len = lens[i];
+        tuple.path_id = path_ids[i];
+        memcpy(tuple.prefix_bin, &prefixes[i * 16], sizeof(tuple.prefix_bin));
+        getLabels(i, tuple.labels, sizeof(tuple.labels));
+    }
+}
+
+/**
+ * Get the printed form of a decode status for logging
+ *
+ * \param [in]   status     Decode status
+ */
+const char *NlriBatch::statusStr(DECODE_STATUS status) {
+    switch (status) {
+        case NLRI_OK:           return "ok";
+        case NLRI_TRUNCATED:    return "prefix is truncated";
+        case NLRI_BAD_LABEL:    return "labels are longer than the prefix";
+        case NLRI_BAD_LENGTH:   return "prefix length is too large";
+    }
+
+    return "unknown";
+}
+
+/**
+ * Grow the arrays to hold at least one more prefix
+ */
+void NlriBatch::grow() {
+    size_t size = lens.size() ? lens.size() * 2 : NLRI_BATCH_MIN_PREFIXES;
+
+    lens.resize(size);
+    path_ids.resize(size);
+    prefixes.resize(size * 16);
+    label_first.resize(size);
+    label_count.resize(size);
+    offsets.resize(size);
+}
+
+/**
+ * Find the first prefix length larger than the max
+ *
+ * \param [in]   max_bits   Max prefix length in bits
+ *
+ * \returns index of the prefix, count if all are valid
+ */
+size_t NlriBatch::checkLengths(uint8_t max_bits) const {
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i max = _mm_set1_epi8((char)max_bits);
+
+    // A length is valid if max(len, max_bits) is still max_bits
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)&lens[i]);
+        int valid = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, max), max));
+
+        if (valid != 0xFFFF)
+            return i + __builtin_ctz(~valid);
+    }
+#endif
+
+    for (; i < count; i++) {
+        if (lens[i] > max_bits)
+            return i;
+    }
+
+    return count;
+}
+
+/**
+ * Copy the prefixes out of the NLRI field, zeroing the bits past the prefix length
+ *
+ * \param [in]   data       Pointer to the start of the NLRI field
+ * \param [in]   len        Length of the data in bytes
+ */
+void NlriBatch::copyPrefixes(const u_char *data, uint16_t len) {
+    for (size_t i = 0; i < count; i++) {
+        const u_char *src = data + offsets[i];
+        size_t addr_bytes = (lens[i] + 7) / 8;
+        uint8_t *dst = &prefixes[i * 16];
+
+#ifdef __SSE2__
+        __m128i v;
+
+        // Loading 16 bytes would read past the field near its end
+        if (offsets[i] + 16 <= len) {
+            v = _mm_loadu_si128((const __m128i *)src);
+
+        } else {
+            uint8_t tail[16] = { 0 };
+            memcpy(tail, src, addr_bytes);
+            v = _mm_loadu_si128((const __m128i *)tail);
+        }
+
+        v = _mm_and_si128(v, _mm_load_si128((const __m128i *)prefix_masks.mask[lens[i]]));
+        _mm_storeu_si128((__m128i *)dst, v);
+#else
+        memset(dst, 0, 16);
+        memcpy(dst, src, addr_bytes);
+
+        if (addr_bytes)
+            dst[addr_bytes - 1] &= prefix_masks.mask[lens[i]][addr_bytes - 1];
+#endif
+    }
+}
+
+} /* namespace bgp_msg */
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2013-2016 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+#ifndef NLRIBATCH_H_
+#define NLRIBATCH_H_
+
+#include "bgp_common.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bgp_msg {
+
+/**
+ * \class   NlriBatch
+ *
+ * \brief   Batch decoder of IPv4/IPv6 unicast and labeled unicast NLRI
+ * \details The prefixes of an NLRI field are decoded into arrays, one entry per prefix
+ *          at the same index.  Decoding is done in three passes:
+ *              1) The records are framed, reading the add path ID, length and labels.
+ *              2) The prefix lengths are checked against the address family, 16 at a time with SSE2.
+ *              3) The prefixes are copied, with the bits past the prefix length masked off (SSE2).
+ *
+ *          Without SSE2 the same passes run one prefix at a time.  The arrays only grow, a
+ *          batch is kept per peer and reused for every NLRI field.
+ *
+ *          Only used by one thread at a time, the parser of the peer.
+ */
+class NlriBatch {
+public:
+    /**
+     * Decode result
+     */
+    enum DECODE_STATUS {
+        NLRI_OK=0,                          ///< All prefixes decoded
+        NLRI_TRUNCATED,                     ///< A prefix runs past the end of the NLRI field
+        NLRI_BAD_LABEL,                     ///< The labels of a prefix run past its length
+        NLRI_BAD_LENGTH,                    ///< A prefix length is larger than the address family allows
+    };
+
+    size_t                  count;          ///< Number of decoded prefixes
+    bool                    isIPv4;         ///< True if IPv4, false if IPv6
+
+    std::vector<uint8_t>    lens;           ///< Length of prefix in bits, labels not included
+    std::vector<uint32_t>   path_ids;       ///< Add path ID - zero if not used
+    std::vector<uint8_t>    prefixes;       ///< Prefixes in binary form, 16 bytes each
+    std::vector<uint32_t>   label_first;    ///< Index in labels of the first label of the prefix
+    std::vector<uint8_t>    label_count;    ///< Number of labels of the prefix
+    std::vector<uint32_t>   labels;         ///< Label values of all prefixes
+
+    NlriBatch();
+    virtual ~NlriBatch();
+
+    /**
+     * Decode the prefixes of an NLRI field
+     *
+     * \details Prefixes before the first invalid one are kept; the rest of the field
+     *          can't be framed and is dropped.
+     *
+     * \param [in]   isIPv4     True false to indicate if IPv4 or IPv6
+     * \param [in]   add_path   True if add path is enabled for the AFI/SAFI
+     * \param [in]   labeled    True if the prefixes carry labels (RFC3107)
+     * \param [in]   data       Pointer to the start of the prefixes
+     * \param [in]   len        Length of the data in bytes
+     *
+     * \returns NLRI_OK or the reason decoding stopped
+     */
+    DECODE_STATUS decode(bool isIPv4, bool add_path, bool labeled, const u_char *data, uint16_t len);
+
+    /**
+     * Get the labels of a prefix in the format of label,label,...
+     *
+     * \param [in]   i          Index of the prefix
+     * \param [out]  str        Labels, empty if none; truncated to the buffer
+     * \param [in]   size       Size of str
+     */
+    void getLabels(size_t i, char *str, size_t size) const;
+
+    /**
+     * Append the decoded prefixes to a prefix vector
+     *
+     * \param [in]   type       Prefix type of the entries
+     * \param [out]  tuples     Reference to a vector<prefix_tuple> to be updated with entries
+     */
+    void toTuples(bgp::PREFIX_TYPE type, std::vector<bgp::prefix_tuple> &tuples) const;
+
+    /**
+     * Get the printed form of a decode status for logging
+     *
+     * \param [in]   status     Decode status
+     */
+    static const char *statusStr(DECODE_STATUS status);
+
+private:
+    std::vector<uint16_t>   offsets;        ///< Offset in the NLRI field of each prefix, after its labels
+
+    /**
+     * Grow the arrays to hold at least one more prefix
+     */
+    void grow();
+
+    /**
+     * Find the first prefix length larger than the max
+     *
+     * \param [in]   max_bits   Max prefix length in bits
+     *
+     * \returns index of the prefix, count if all are valid
+     */
+    size_t checkLengths(uint8_t max_bits) const;
+
+    /**
+     * Copy the prefixes out of the NLRI field, zeroing the bits past the prefix length
+     *
+     * \param [in]   data       Pointer to the start of the NLRI field
+     * \param [in]   len        Length of the data in bytes
+     */
+    void copyPrefixes(const u_char *data, uint16_t len);
+};
+
+} /* namespace bgp_msg */
+
+#endif /* NLRIBATCH_H_ */
@@ -10,7 +10,7 @@
 
 #include <string>
 #include <cstring>
-#include <sstream>
+#include <cstdio>
 
 #include <arpa/inet.h>
 
@@ -18,6 +18,7 @@
 #include "MPReachAttr.h"
 #include "MPUnReachAttr.h"
 #include "MPLinkStateAttr.h"
+#include "AttrCache.h"
 
 namespace bgp_msg {
 
@@ -69,11 +70,26 @@ size_t UpdateMsg::parseUpdateMsg(u_char *data, size_t size, parsed_update_data &
     size_t      read_size       = 0;
     u_char      *bufPtr         = data;
 
-    // Clear the parsed_data
+    // Clear the parsed_data, it's reused for every update of the peer
     parsed_data.advertised.clear();
     parsed_data.attrs.clear();
+    memset(&parsed_data.path_attrs, 0, sizeof(parsed_data.path_attrs));
+    parsed_data.attrs_key.clear();
+    parsed_data.attrs_hash = 0;
+    parsed_data.cached_attrs = NULL;
     parsed_data.withdrawn.clear();
-
+    parsed_data.ls_attrs.clear();
+    parsed_data.ls.nodes.clear();
+    parsed_data.ls.links.clear();
+    parsed_data.ls.prefixes.clear();
+    parsed_data.ls_withdrawn.nodes.clear();
+    parsed_data.ls_withdrawn.links.clear();
+    parsed_data.ls_withdrawn.prefixes.clear();
+    parsed_data.vpn.clear();
+    parsed_data.vpn_withdrawn.clear();
+    parsed_data.evpn.clear();
+    parsed_data.evpn_withdrawn.clear();
+    parsed_data.end_of_rib = 0;
 
     /* ---------------------------------------------------------
      * Parse and setup the update header struct
@@ -126,6 +142,7 @@ size_t UpdateMsg::parseUpdateMsg(u_char *data, size_t size, parsed_update_data &
     if (not uHdr.withdrawn_len and (size - read_size) <= 0 and not uHdr.attr_len) {
 
 	peer_info->endOfRIB = true;		// Indicates End-of-RIB Marker received
+        parsed_data.end_of_rib = bgp::PREFIX_UNICAST_V4;
         LOG_INFO("%s: rtr=%s: End-Of-RIB marker", peer_addr.c_str(), router_addr.c_str());
 
     } else {
@@ -168,71 +185,34 @@ size_t UpdateMsg::parseUpdateMsg(u_char *data, size_t size, parsed_update_data &
  *
  * \param [in]   data       Pointer to the start of the prefixes to be parsed
  * \param [in]   len        Length of the data in bytes to be read
- * \param [out]  prefixes   Reference to a list<prefix_tuple> to be updated with entries
+ * \param [out]  prefixes   Reference to a vector<prefix_tuple> to be updated with entries
  */
-void UpdateMsg::parseNlriData_v4(u_char *data, uint16_t len, std::list<bgp::prefix_tuple> &prefixes) {
-    u_char       ipv4_raw[4];
-    char         ipv4_char[16];
-    u_char       addr_bytes;
-
-    bgp::prefix_tuple tuple;
+void UpdateMsg::parseNlriData_v4(u_char *data, uint16_t len, std::vector<bgp::prefix_tuple> &prefixes) {
+    NlriBatch *batch = peer_info->nlri_batch;
 
     if (len <= 0 or data == NULL)
         return;
 
-    // TODO: Can extend this to support multicast, but right now we set it to unicast v4
-    // Set the type for all to be unicast V4
-    tuple.type = bgp::PREFIX_UNICAST_V4;
-    tuple.isIPv4 = true;
-
-    // Loop through all prefixes
-    for (size_t read_size=0; read_size < len; read_size++) {
-
-        bzero(ipv4_raw, sizeof(ipv4_raw));
-        bzero(tuple.prefix_bin, sizeof(tuple.prefix_bin));
-
-        // Parse add-paths if enabled
-        if (peer_info->add_path_capability.isAddPathEnabled(bgp::BGP_AFI_IPV4, bgp::BGP_SAFI_UNICAST)
-                and (len - read_size) >= 4) {
-            memcpy(&tuple.path_id, data, 4);
-            bgp::SWAP_BYTES(&tuple.path_id);
-            data += 4; read_size += 4;
-        } else
-            tuple.path_id = 0;
-
-        // set the address in bits length
-        tuple.len = *data++;
-
-        // Figure out how many bytes the bits requires
-        addr_bytes = tuple.len / 8;
-        if (tuple.len % 8)
-            ++addr_bytes;
-
-        SELF_DEBUG("%s: rtr=%s: Reading NLRI data prefix bits=%d bytes=%d", peer_addr.c_str(),
-                    router_addr.c_str(), tuple.len, addr_bytes);
-
-        if (addr_bytes <= 4) {
-            memcpy(ipv4_raw, data, addr_bytes);
-            read_size += addr_bytes;
-            data += addr_bytes;
-
-            // Convert the IP to string printed format
-            inet_ntop(AF_INET, ipv4_raw, ipv4_char, sizeof(ipv4_char));
-            tuple.prefix.assign(ipv4_char);
-            SELF_DEBUG("%s: rtr=%s: Adding prefix %s len %d", peer_addr.c_str(),
-                        router_addr.c_str(), ipv4_char, tuple.len);
-
-            // set the raw/binary address
-            memcpy(tuple.prefix_bin, ipv4_raw, sizeof(ipv4_raw));
-
-            // Add tuple to prefix list
-            prefixes.push_back(tuple);
-
-        } else if (addr_bytes > 4) {
-            LOG_NOTICE("%s: rtr=%s: NRLI v4 address is larger than 4 bytes bytes=%d len=%d",
-                       peer_addr.c_str(), router_addr.c_str(), addr_bytes, tuple.len);
+    NlriBatch::DECODE_STATUS status = batch->decode(true,
+            peer_info->add_path_capability.isAddPathEnabled(bgp::BGP_AFI_IPV4, bgp::BGP_SAFI_UNICAST),
+            false, data, len);
+
+    if (status != NlriBatch::NLRI_OK)
+        LOG_NOTICE("%s: rtr=%s: NLRI v4 is invalid after %d prefixes, %s; skipping the rest",
+                   peer_addr.c_str(), router_addr.c_str(), (int)batch->count, NlriBatch::statusStr(status));
+
+    // The prefix is only printed when written to the message bus
+    if (debug) {
+        for (size_t i = 0; i < batch->count; i++) {
+            const uint8_t *ipv4_raw = &batch->prefixes[i * 16];
+
+            SELF_DEBUG("%s: rtr=%s: Adding prefix %d.%d.%d.%d len %d", peer_addr.c_str(), router_addr.c_str(),
+                       ipv4_raw[0], ipv4_raw[1], ipv4_raw[2], ipv4_raw[3], batch->lens[i]);
         }
     }
+
+    // TODO: Can extend this to support multicast, but right now we set it to unicast v4
+    batch->toTuples(bgp::PREFIX_UNICAST_V4, prefixes);
 }
 
 /**
@@ -262,6 +242,16 @@ void UpdateMsg::parseAttributes(u_char *data, uint16_t len, parsed_update_data &
         return;
     }
 
+    /*
+     * Attributes already sent for the peer are not decoded again, only the NLRI and BGP-LS
+     */
+    if (peer_info->attr_cache != NULL or peer_info->rib != NULL) {
+        keyAttributes(data, len, parsed_data);
+
+        if (peer_info->attr_cache != NULL)
+            parsed_data.cached_attrs = peer_info->attr_cache->find(parsed_data.attrs_key, parsed_data.attrs_hash);
+    }
+
     /*
      * Iterate through all attributes and parse them
      */
@@ -291,7 +281,9 @@ void UpdateMsg::parseAttributes(u_char *data, uint16_t len, parsed_update_data &
             /*
              * Parse data based on attribute type
              */
-            parseAttrData(attr_type, attr_len, data, parsed_data);
+            if (parsed_data.cached_attrs == NULL or attr_type == ATTR_TYPE_MP_REACH_NLRI
+                    or attr_type == ATTR_TYPE_MP_UNREACH_NLRI or attr_type == ATTR_TYPE_BGP_LS)
+                parseAttrData(attr_type, attr_len, data, parsed_data);
             data        += attr_len;
             read_size   += attr_len;
 
@@ -307,6 +299,71 @@ void UpdateMsg::parseAttributes(u_char *data, uint16_t len, parsed_update_data &
 
 }
 
+/**
+ * Get the attribute set key of the update
+ *
+ * \details
+ *     Sets attrs_key and attrs_hash in 'parsed_data'.  The NLRI of MP_REACH and MP_UNREACH are
+ *     left out, updates differing only by their prefixes have the same key.
+ *
+ * \param [in]   data           Pointer to the start of the attributes
+ * \param [in]   len            Length of the attributes in bytes
+ * \param [out]  parsed_data    Reference to parsed_update_data; will be updated with the key
+ */
+void UpdateMsg::keyAttributes(u_char *data, uint16_t len, parsed_update_data &parsed_data) {
+    std::string &key = parsed_data.attrs_key;
+    u_char      *end = data + len;
+
+    key.reserve(len + 1);
+
+    // The AS_PATH is decoded based on the ASN size
+    key.push_back(peer_info->using_2_octet_asn ? 2 : 4);
+
+    while (end - data >= 3) {
+        u_char   *attr = data;
+        u_char   attr_type = data[1];
+        uint16_t attr_len;
+
+        if (ATTR_FLAG_EXTENDED(data[0])) {
+            if (end - data < 4)
+                break;
+
+            attr_len = (data[2] << 8) | data[3];
+            data += 4;
+
+        } else {
+            attr_len = data[2];
+            data += 3;
+        }
+
+        if (attr_len > end - data)
+            attr_len = end - data;
+
+        switch (attr_type) {
+            case ATTR_TYPE_MP_UNREACH_NLRI :
+                break;
+
+            case ATTR_TYPE_MP_REACH_NLRI :
+            {
+                // Flags and type, then AFI, SAFI, next hop and reserved byte; the length varies with the NLRI
+                uint16_t hdr_len = attr_len >= 4 ? 5 + data[3] : attr_len;
+
+                key.append((char *)attr, 2);
+                key.append((char *)data, hdr_len < attr_len ? hdr_len : attr_len);
+                break;
+            }
+
+            default :
+                key.append((char *)attr, data - attr + attr_len);
+                break;
+        }
+
+        data += attr_len;
+    }
+
+    parsed_data.attrs_hash = AttrCache::hash(key);
+}
+
 /**
  * Parse attribute data based on attribute type
  *
@@ -320,11 +377,7 @@ void UpdateMsg::parseAttributes(u_char *data, uint16_t len, parsed_update_data &
  * \param [out]  parsed_data    Reference to parsed_update_data; will be updated with all parsed data
  */
 void UpdateMsg::parseAttrData(u_char attr_type, uint16_t attr_len, u_char *data, parsed_update_data &parsed_data) {
-    std::string decodeStr       = "";
-    u_char      ipv4_raw[4];
-    char        ipv4_char[16];
-    uint32_t    value32bit;
-    uint16_t    value16bit;
+    parsed_path_attrs &attrs    = parsed_data.path_attrs;
 
     /*
      * Parse based on attribute type
@@ -332,97 +385,58 @@ void UpdateMsg::parseAttrData(u_char attr_type, uint16_t attr_len, u_char *data,
     switch (attr_type) {
 
         case ATTR_TYPE_ORIGIN : // Origin
-            switch (data[0]) {
-               case 0 : decodeStr.assign("igp"); break;
-               case 1 : decodeStr.assign("egp"); break;
-               case 2 : decodeStr.assign("incomplete"); break;
+            if (data[0] <= 2) {             // igp, egp or incomplete
+                attrs.origin = data[0];
+                attrs.present |= ATTR_PRESENT(ATTR_TYPE_ORIGIN);
             }
-
-            parsed_data.attrs[ATTR_TYPE_ORIGIN] = decodeStr;
             break;
 
         case ATTR_TYPE_AS_PATH : // AS_PATH
-            parseAttr_AsPath(attr_len, data, parsed_data.attrs);
+            parseAttr_AsPath(attr_len, data, attrs);
             break;
 
         case ATTR_TYPE_NEXT_HOP : // Next hop v4
-            memcpy(ipv4_raw, data, 4);
-            inet_ntop(AF_INET, ipv4_raw, ipv4_char, sizeof(ipv4_char));
-            parsed_data.attrs[ATTR_TYPE_NEXT_HOP] = std::string(ipv4_char);
+            setNextHop(parsed_data, data, 4, true);
             break;
 
         case ATTR_TYPE_MED : // MED value
-        {
-            memcpy(&value32bit, data, 4);
-            bgp::SWAP_BYTES(&value32bit);
-            std::ostringstream numString;
-            numString << value32bit;
-            parsed_data.attrs[ATTR_TYPE_MED] = numString.str();
+            memcpy(&attrs.med, data, 4);
+            bgp::SWAP_BYTES(&attrs.med);
+            attrs.present |= ATTR_PRESENT(ATTR_TYPE_MED);
             break;
-        }
+
         case ATTR_TYPE_LOCAL_PREF : // local pref value
-        {
-            memcpy(&value32bit, data, 4);
-            bgp::SWAP_BYTES(&value32bit);
-            std::ostringstream numString;
-            numString << value32bit;
-            parsed_data.attrs[ATTR_TYPE_LOCAL_PREF] = numString.str();
+            memcpy(&attrs.local_pref, data, 4);
+            bgp::SWAP_BYTES(&attrs.local_pref);
+            attrs.present |= ATTR_PRESENT(ATTR_TYPE_LOCAL_PREF);
             break;
-        }
+
         case ATTR_TYPE_ATOMIC_AGGREGATE : // Atomic aggregate
-            parsed_data.attrs[ATTR_TYPE_ATOMIC_AGGREGATE] = std::string("1");
+            attrs.present |= ATTR_PRESENT(ATTR_TYPE_ATOMIC_AGGREGATE);
             break;
 
         case ATTR_TYPE_AGGEGATOR : // Aggregator
-            parseAttr_Aggegator(attr_len, data, parsed_data.attrs);
+            parseAttr_Aggegator(attr_len, data, attrs);
             break;
 
         case ATTR_TYPE_ORIGINATOR_ID : // Originator ID
-            memcpy(ipv4_raw, data, 4);
-            inet_ntop(AF_INET, ipv4_raw, ipv4_char, sizeof(ipv4_char));
-            parsed_data.attrs[ATTR_TYPE_ORIGINATOR_ID] = std::string(ipv4_char);
+            memcpy(attrs.originator_id, data, 4);
+            attrs.present |= ATTR_PRESENT(ATTR_TYPE_ORIGINATOR_ID);
             break;
 
         case ATTR_TYPE_CLUSTER_LIST : // Cluster List (RFC 4456)
             // According to RFC 4456, the value is a sequence of cluster id's
-            for (int i=0; i < attr_len; i += 4) {
-                memcpy(ipv4_raw, data, 4);
-                data += 4;
-                inet_ntop(AF_INET, ipv4_raw, ipv4_char, sizeof(ipv4_char));
-                decodeStr.append(ipv4_char);
-                decodeStr.append(" ");
-            }
-
-            parsed_data.attrs[ATTR_TYPE_CLUSTER_LIST] = decodeStr;
+            attrs.cluster_list.data = data;
+            attrs.cluster_list.len = attr_len;
+            attrs.present |= ATTR_PRESENT(ATTR_TYPE_CLUSTER_LIST);
             break;
 
         case ATTR_TYPE_COMMUNITIES : // Community list
-        {
-            for (int i = 0; i < attr_len; i += 4) {
-                std::ostringstream numString;
-
-                // Add space between entries
-                if (i)
-                    decodeStr.append(" ");
-
-                // Add entry
-                memcpy(&value16bit, data, 2);
-                data += 2;
-                bgp::SWAP_BYTES(&value16bit);
-                numString << value16bit;
-                numString << ":";
-
-                memcpy(&value16bit, data, 2);
-                data += 2;
-                bgp::SWAP_BYTES(&value16bit);
-                numString << value16bit;
-                decodeStr.append(numString.str());
-            }
-
-            parsed_data.attrs[ATTR_TYPE_COMMUNITIES] = decodeStr;
-
+            attrs.communities.data = data;
+            attrs.communities.len = attr_len;
+            attrs.present |= ATTR_PRESENT(ATTR_TYPE_COMMUNITIES);
             break;
-        }
+
         case ATTR_TYPE_EXT_COMMUNITY : // extended community list (RFC 4360)
         {
             ExtCommunity ec(logger, peer_addr, debug);
@@ -480,37 +494,9 @@ void UpdateMsg::parseAttrData(u_char attr_type, uint16_t attr_len, u_char *data,
         case ATTR_TYPE_LARGE_COMMUNITY: {
             // RFC8092
             if (attr_len >= 12) {
-                for (int i = 0; i < attr_len; i += 12) {
-                    std::ostringstream numString;
-
-                    // Add space between entries
-                    if (i)
-                        decodeStr.append(" ");
-
-                    // Global Administrator
-                    memcpy(&value32bit, data, 4);
-                    data += 4;
-                    bgp::SWAP_BYTES(&value32bit);
-                    numString << value32bit;
-                    numString << ":";
-
-                    // Local Data Part 1
-                    memcpy(&value32bit, data, 4);
-                    data += 4;
-                    bgp::SWAP_BYTES(&value32bit);
-                    numString << value32bit;
-                    numString << ":";
-
-                    // Local Data Part 2
-                    memcpy(&value32bit, data, 4);
-                    data += 4;
-                    bgp::SWAP_BYTES(&value32bit);
-                    numString << value32bit;
-
-                    decodeStr.append(numString.str());
-                }
-
-                parsed_data.attrs[ATTR_TYPE_LARGE_COMMUNITY] = decodeStr;
+                attrs.large_communities.data = data;
+                attrs.large_communities.len = attr_len;
+                attrs.present |= ATTR_PRESENT(ATTR_TYPE_LARGE_COMMUNITY);
             }
 
             break;
@@ -529,41 +515,28 @@ void UpdateMsg::parseAttrData(u_char attr_type, uint16_t attr_len, u_char *data,
  *
  * \param [in]   attr_len       Length of the attribute data
  * \param [in]   data           Pointer to the attribute data
- * \param [out]  attrs          Reference to the parsed attr map - will be updated
+ * \param [out]  attrs          Reference to the parsed path attributes - will be updated
  */
-void UpdateMsg::parseAttr_Aggegator(uint16_t attr_len, u_char *data, parsed_attrs_map &attrs) {
-    std::string decodeStr;
-    uint32_t    value32bit = 0;
+void UpdateMsg::parseAttr_Aggegator(uint16_t attr_len, u_char *data, parsed_path_attrs &attrs) {
     uint16_t    value16bit = 0;
-    u_char      ipv4_raw[4];
-    char        ipv4_char[16];
 
     // If using RFC6793, the len will be 8 instead of 6
      if (attr_len == 8) { // RFC6793 ASN of 4 octets
-         memcpy(&value32bit, data, 4); data += 4;
-         bgp::SWAP_BYTES(&value32bit);
-         std::ostringstream numString;
-         numString << value32bit;
-         decodeStr.assign(numString.str());
+         memcpy(&attrs.aggregator_as, data, 4); data += 4;
+         bgp::SWAP_BYTES(&attrs.aggregator_as);
 
      } else if (attr_len == 6) {
          memcpy(&value16bit, data, 2); data += 2;
          bgp::SWAP_BYTES(&value16bit);
-         std::ostringstream numString;
-         numString << value16bit;
-         decodeStr.assign(numString.str());
+         attrs.aggregator_as = value16bit;
 
      } else {
          LOG_ERR("%s: rtr=%s: path attribute is not the correct size of 6 or 8 octets.", peer_addr.c_str(), router_addr.c_str());
          return;
      }
 
-     decodeStr.append(" ");
-     memcpy(ipv4_raw, data, 4);
-     inet_ntop(AF_INET, ipv4_raw, ipv4_char, sizeof(ipv4_char));
-     decodeStr.append(ipv4_char);
-
-     attrs[ATTR_TYPE_AGGEGATOR] = decodeStr;
+     memcpy(attrs.aggregator_addr, data, 4);
+     attrs.present |= ATTR_PRESENT(ATTR_TYPE_AGGEGATOR);
 }
 
 /**
@@ -571,10 +544,9 @@ void UpdateMsg::parseAttr_Aggegator(uint16_t attr_len, u_char *data, parsed_attr
  *
  * \param [in]   attr_len       Length of the attribute data
  * \param [in]   data           Pointer to the attribute data
- * \param [out]  attrs          Reference to the parsed attr map - will be updated
+ * \param [out]  attrs          Reference to the parsed path attributes - will be updated
  */
-void UpdateMsg::parseAttr_AsPath(uint16_t attr_len, u_char *data, parsed_attrs_map &attrs) {
-    std::string decoded_path;
+void UpdateMsg::parseAttr_AsPath(uint16_t attr_len, u_char *data, parsed_path_attrs &attrs) {
     int         path_len    = attr_len;
     uint16_t    as_path_cnt = 0;
 
@@ -595,7 +567,7 @@ void UpdateMsg::parseAttr_AsPath(uint16_t attr_len, u_char *data, parsed_attrs_m
         return;
 
     /*
-     * Loop through each path segment
+     * Loop through each path segment, the path is only printed when sent to the message bus
      */
     while (path_len > 0) {
 
@@ -603,10 +575,6 @@ void UpdateMsg::parseAttr_AsPath(uint16_t attr_len, u_char *data, parsed_attrs_m
         seg_len  = *data++;                  // Count of AS's, not bytes
         path_len -= 2;
 
-        if (seg_type == 1) {                 // If AS-SET open with a brace
-            decoded_path.append(" {");
-        }
-
         SELF_DEBUG("%s: rtr=%s: as_path seg_len = %d seg_type = %d, path_len = %d total_len = %d as_octet_size = %d",
                    peer_addr.c_str(), router_addr.c_str(),
                    seg_len, seg_type, path_len, attr_len, asn_octet_size);
@@ -628,48 +596,191 @@ void UpdateMsg::parseAttr_AsPath(uint16_t attr_len, u_char *data, parsed_attrs_m
         }
 
         // The rest of the data is the as path sequence, in blocks of 2 or 4 bytes
-        for (; seg_len > 0; seg_len--) {
+        if (seg_len > 0) {
+            data += (seg_len - 1) * asn_octet_size;
+
             seg_asn = 0;
             memcpy(&seg_asn, data, asn_octet_size);  data += asn_octet_size;
-            path_len -= asn_octet_size;                               // Adjust the path length for what was read
-
             bgp::SWAP_BYTES(&seg_asn, asn_octet_size);
-            decoded_path.append(" ");
-            std::ostringstream numString;
-            numString << seg_asn;
-            decoded_path.append(numString.str());
-
-            // Increase the as path count
-            ++as_path_cnt;
-        }
 
-        if (seg_type == 1) {            // If AS-SET close with a brace
-            decoded_path.append(" }");
+            path_len -= seg_len * asn_octet_size;    // Adjust the path length for what was read
+            as_path_cnt += seg_len;                  // Increase the as path count
         }
     }
 
-    SELF_DEBUG("%s: rtr=%s: Parsed AS_PATH count %hu : %s", peer_addr.c_str(), router_addr.c_str(), as_path_cnt, decoded_path.c_str());
+    SELF_DEBUG("%s: rtr=%s: Parsed AS_PATH count %hu", peer_addr.c_str(), router_addr.c_str(), as_path_cnt);
 
     /*
-     * Update the attributes map
+     * Update the path attributes
      */
-    attrs[ATTR_TYPE_AS_PATH] = decoded_path;
+    attrs.as_path.data = data_ptr;
+    attrs.as_path.len = attr_len;
+    attrs.asn_octet_size = asn_octet_size;
+    attrs.as_path_count = as_path_cnt;
+    attrs.origin_as = seg_asn;                       // Last ASN of the path
+    attrs.present |= ATTR_PRESENT(ATTR_TYPE_AS_PATH);
+}
+
+/**
+ * Set the next hop of the parsed path attributes
+ *
+ * \param [out]  parsed_data    Parsed data to update
+ * \param [in]   next_hop       Next hop address
+ * \param [in]   len            Length of the address, only the first 16 bytes are used
+ * \param [in]   isIPv4         True if the next hop is IPv4, false if IPv6
+ */
+void UpdateMsg::setNextHop(parsed_update_data &parsed_data, const u_char *next_hop, int len, bool isIPv4) {
+    parsed_path_attrs &attrs = parsed_data.path_attrs;
+
+    bzero(attrs.next_hop, sizeof(attrs.next_hop));
+    memcpy(attrs.next_hop, next_hop, len > 16 ? 16 : len);
+
+    attrs.next_hop_isIPv4 = isIPv4;
+    attrs.present |= ATTR_PRESENT(ATTR_TYPE_NEXT_HOP);
+}
+
+/**
+ * Append an unsigned number to a string
+ *
+ * \param [in,out] str      String to append to
+ * \param [in]     value    Number to append
+ */
+static inline void appendNumber(std::string &str, uint32_t value) {
+    char buf[16];
+    char *p = buf + sizeof(buf);
+
+    do {
+        *--p = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    str.append(p, buf + sizeof(buf) - p);
+}
+
+/**
+ * Read a 16 or 32 bit number in network byte order
+ *
+ * \param [in] data         Pointer to the number
+ * \param [in] size         Size of the number in bytes, 2 or 4
+ */
+static inline uint32_t readNumber(const u_char *data, int size) {
+    uint32_t value = 0;
+
+    memcpy(&value, data, size);
+    bgp::SWAP_BYTES(&value, size);
 
-    {
-        std::ostringstream numString;
-        numString << as_path_cnt;
-        attrs[ATTR_TYPE_INTERNAL_AS_COUNT] = numString.str();
+    return value;
+}
+
+/**
+ * Format the parsed path attributes for the message bus
+ *
+ * \details All fields of the attribute object are set, except the hash_id.
+ *
+ * \param [in]   parsed_data    Parsed update data, the message buffer must still be valid
+ * \param [out]  attr           Path attribute object
+ */
+void UpdateMsg::formatAttrs(const parsed_update_data &parsed_data, MsgBusInterface::obj_path_attr &attr) {
+    const parsed_path_attrs &attrs = parsed_data.path_attrs;
+    char    ip_char[40];
+
+    attr.as_path.clear();
+    attr.cluster_list.clear();
+    attr.community_list.clear();
+    attr.large_community_list.clear();
+
+    bzero(attr.origin, sizeof(attr.origin));
+    bzero(attr.next_hop, sizeof(attr.next_hop));
+    bzero(attr.aggregator, sizeof(attr.aggregator));
+    bzero(attr.originator_id, sizeof(attr.originator_id));
+
+    attr.med            = attrs.med;
+    attr.local_pref     = attrs.local_pref;
+    attr.as_path_count  = attrs.as_path_count;
+    attr.origin_as      = attrs.origin_as;
+    attr.atomic_agg     = attrs.present & ATTR_PRESENT(ATTR_TYPE_ATOMIC_AGGREGATE);
+    attr.nexthop_isIPv4 = attrs.next_hop_isIPv4 or not (attrs.present & ATTR_PRESENT(ATTR_TYPE_NEXT_HOP));
+
+    if (attrs.present & ATTR_PRESENT(ATTR_TYPE_ORIGIN)) {
+        static const char *origins[] = { "igp", "egp", "incomplete" };
+        strncpy(attr.origin, origins[attrs.origin], sizeof(attr.origin));
+    }
+
+    if (attrs.present & ATTR_PRESENT(ATTR_TYPE_NEXT_HOP))
+        inet_ntop(attrs.next_hop_isIPv4 ? AF_INET : AF_INET6, attrs.next_hop, attr.next_hop, sizeof(attr.next_hop));
+
+    if (attrs.present & ATTR_PRESENT(ATTR_TYPE_ORIGINATOR_ID))
+        inet_ntop(AF_INET, attrs.originator_id, attr.originator_id, sizeof(attr.originator_id));
+
+    if (attrs.present & ATTR_PRESENT(ATTR_TYPE_AGGEGATOR)) {
+        inet_ntop(AF_INET, attrs.aggregator_addr, ip_char, sizeof(ip_char));
+        snprintf(attr.aggregator, sizeof(attr.aggregator), "%u %s", attrs.aggregator_as, ip_char);
     }
 
     /*
-     * Get the last ASN and update the attributes map
+     * AS_PATH - validated by the parser with asn_octet_size, AS-SETs are enclosed in braces
      */
-    {
-        std::ostringstream numString;
-        numString << seg_asn;
-        attrs[ATTR_TYPE_INTERNAL_AS_ORIGIN] = numString.str();
+    if (attrs.present & ATTR_PRESENT(ATTR_TYPE_AS_PATH)) {
+        const u_char *data = attrs.as_path.data;
+        const u_char *end = data + attrs.as_path.len;
+
+        while (data + 2 <= end) {
+            u_char seg_type = *data++;
+            u_char seg_len  = *data++;
+
+            if (seg_type == 1)
+                attr.as_path.append(" {");
+
+            for (; seg_len > 0; seg_len--, data += attrs.asn_octet_size) {
+                attr.as_path.append(" ");
+                appendNumber(attr.as_path, readNumber(data, attrs.asn_octet_size));
+            }
+
+            if (seg_type == 1)
+                attr.as_path.append(" }");
+        }
+    }
+
+    if (attrs.present & ATTR_PRESENT(ATTR_TYPE_CLUSTER_LIST)) {
+        for (int i = 0; i + 4 <= attrs.cluster_list.len; i += 4) {
+            inet_ntop(AF_INET, attrs.cluster_list.data + i, ip_char, sizeof(ip_char));
+            attr.cluster_list.append(ip_char);
+            attr.cluster_list.append(" ");
+        }
+    }
+
+    if (attrs.present & ATTR_PRESENT(ATTR_TYPE_COMMUNITIES)) {
+        for (int i = 0; i + 4 <= attrs.communities.len; i += 4) {
+            // Add space between entries
+            if (i)
+                attr.community_list.append(" ");
+
+            appendNumber(attr.community_list, readNumber(attrs.communities.data + i, 2));
+            attr.community_list.append(":");
+            appendNumber(attr.community_list, readNumber(attrs.communities.data + i + 2, 2));
+        }
+    }
+
+    if (attrs.present & ATTR_PRESENT(ATTR_TYPE_LARGE_COMMUNITY)) {
+        for (int i = 0; i + 12 <= attrs.large_communities.len; i += 12) {
+            // Add space between entries
+            if (i)
+                attr.large_community_list.append(" ");
+
+            // Global Administrator, Local Data Part 1 and Part 2
+            appendNumber(attr.large_community_list, readNumber(attrs.large_communities.data + i, 4));
+            attr.large_community_list.append(":");
+            appendNumber(attr.large_community_list, readNumber(attrs.large_communities.data + i + 4, 4));
+            attr.large_community_list.append(":");
+            appendNumber(attr.large_community_list, readNumber(attrs.large_communities.data + i + 8, 4));
+        }
     }
 
+    parsed_attrs_map::const_iterator it = parsed_data.attrs.find(ATTR_TYPE_EXT_COMMUNITY);
+    if (it != parsed_data.attrs.end())
+        attr.ext_community_list = it->second;
+    else
+        attr.ext_community_list.clear();
 }
 
 } /* namespace bgp_msg */
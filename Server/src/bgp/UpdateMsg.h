@@ -17,11 +17,15 @@
 
 #include <string>
 #include <list>
+#include <vector>
 #include <array>
 #include <map>
 #include <bmp/BMPReader.h>
 
 namespace bgp_msg {
+
+#define ATTR_PRESENT(type)      (1ULL << (type))        ///< Bit of an attribute type (below 64) in parsed_path_attrs::present
+
 /**
  * Defines the attribute types
  *
@@ -126,25 +130,72 @@ public:
      * Parsed data structure for BGP-LS
      */
     struct parsed_data_ls {
-        std::list<MsgBusInterface::obj_ls_node>   nodes;        ///< List of Link state nodes
-        std::list<MsgBusInterface::obj_ls_link>   links;        ///< List of link state links
-        std::list<MsgBusInterface::obj_ls_prefix> prefixes;     ///< List of link state prefixes
+        std::vector<MsgBusInterface::obj_ls_node>   nodes;      ///< List of Link state nodes
+        std::vector<MsgBusInterface::obj_ls_link>   links;      ///< List of link state links
+        std::vector<MsgBusInterface::obj_ls_prefix> prefixes;   ///< List of link state prefixes
+    };
+
+    /**
+     * Path attribute data in the update message, not copied
+     */
+    struct attr_view {
+        u_char      *data;                  ///< Attribute data in the message buffer
+        uint16_t    len;                    ///< Length of the attribute data
+    };
+
+    /**
+     * Path attributes in binary form
+     *
+     * \details Numeric attributes are kept as numbers and the variable length attributes refer to
+     *          the update message, so the record is only valid while the message buffer is.
+     *          Text is only made for the message bus, see formatAttrs().
+     */
+    struct parsed_path_attrs {
+        uint64_t    present;                ///< ATTR_PRESENT() bit of each attribute parsed
+        uint8_t     origin;                 ///< ORIGIN code: 0=igp, 1=egp, 2=incomplete
+        uint32_t    med;                    ///< MED
+        uint32_t    local_pref;             ///< Local preference
+        uint16_t    as_path_count;          ///< Count of ASNs in the AS_PATH (includes all in AS-SET)
+        uint32_t    origin_as;              ///< Last ASN of the AS_PATH
+        uint8_t     asn_octet_size;         ///< ASN size the AS_PATH was decoded with, 2 or 4
+        bool        next_hop_isIPv4;        ///< Next hop address family
+        u_char      next_hop[16];           ///< Next hop, from NEXT_HOP or MP_REACH
+        u_char      originator_id[4];       ///< Originator ID
+        uint32_t    aggregator_as;          ///< Aggregator ASN
+        u_char      aggregator_addr[4];     ///< Aggregator address
+
+        attr_view   as_path;                ///< AS_PATH segments
+        attr_view   communities;            ///< Standard communities
+        attr_view   cluster_list;           ///< Cluster IDs
+        attr_view   large_communities;      ///< Large communities
     };
 
     /**
      * Parsed update data - decoded data from complete update parse
+     *
+     * \details The parser of a peer keeps one and reuses it for every update, the containers
+     *          are cleared by parseUpdateMsg() and keep their capacity.
      */
     struct parsed_update_data {
-        parsed_attrs_map              attrs;              ///< Parsed attrbutes
-        std::list<bgp::prefix_tuple>  withdrawn;          ///< List of withdrawn prefixes
-        std::list<bgp::prefix_tuple>  advertised;         ///< List of advertised prefixes
+        parsed_path_attrs             path_attrs;         ///< Parsed path attributes
+        parsed_attrs_map              attrs;              ///< Attributes decoded to text by their parser (extended communities)
+        std::vector<bgp::prefix_tuple> withdrawn;         ///< List of withdrawn prefixes
+        std::vector<bgp::prefix_tuple> advertised;        ///< List of advertised prefixes
         parsed_ls_attrs_map           ls_attrs;           ///< BGP-LS specific attributes
         parsed_data_ls                ls;                 ///< REACH: Link state parsed data
         parsed_data_ls                ls_withdrawn;       ///< UNREACH: Parsed Withdrawn data
-        std::list<bgp::vpn_tuple>     vpn;                ///< List of vpn prefixes advertised
-        std::list<bgp::vpn_tuple>     vpn_withdrawn;      ///< List of vpn prefixes withdrawn
-        std::list<bgp::evpn_tuple>    evpn;               ///< List of evpn nlris advertised
-        std::list<bgp::evpn_tuple>    evpn_withdrawn;     ///< List of evpn nlris withdrawn
+        std::vector<bgp::vpn_tuple>   vpn;                ///< List of vpn prefixes advertised
+        std::vector<bgp::vpn_tuple>   vpn_withdrawn;      ///< List of vpn prefixes withdrawn
+        std::vector<bgp::evpn_tuple>  evpn;               ///< List of evpn nlris advertised
+        std::vector<bgp::evpn_tuple>  evpn_withdrawn;     ///< List of evpn nlris withdrawn
+        uint8_t                       end_of_rib;         ///< bgp::PREFIX_TYPE of an End-Of-RIB marker, zero if none
+
+        /*
+         * Attribute set of the update, only set when the peer has an AttrCache or AdjRib
+         */
+        std::string                   attrs_key;          ///< Raw path attributes, without the MP_REACH/MP_UNREACH NLRI
+        uint64_t                      attrs_hash;         ///< AttrCache::hash() of attrs_key, zero if not set
+        const MsgBusInterface::obj_path_attr *cached_attrs;   ///< Attributes already sent, not decoded again; NULL if not cached
     };
 
 
@@ -178,6 +229,26 @@ public:
       */
      size_t parseUpdateMsg(u_char *data, size_t size, parsed_update_data &parsed_data);
 
+     /**
+      * Set the next hop of the parsed path attributes
+      *
+      * \param [out]  parsed_data    Parsed data to update
+      * \param [in]   next_hop       Next hop address
+      * \param [in]   len            Length of the address, only the first 16 bytes are used
+      * \param [in]   isIPv4         True if the next hop is IPv4, false if IPv6
+      */
+     static void setNextHop(parsed_update_data &parsed_data, const u_char *next_hop, int len, bool isIPv4);
+
+     /**
+      * Format the parsed path attributes for the message bus
+      *
+      * \details All fields of the attribute object are set, except the hash_id.
+      *
+      * \param [in]   parsed_data    Parsed update data, the message buffer must still be valid
+      * \param [out]  attr           Path attribute object
+      */
+     static void formatAttrs(const parsed_update_data &parsed_data, MsgBusInterface::obj_path_attr &attr);
+
 
 private:
     bool                    debug;                           ///< debug flag to indicate debugging
@@ -197,9 +268,9 @@ private:
      *
      * \param [in]   data       Pointer to the start of the prefixes to be parsed
      * \param [in]   len        Length of the data in bytes to be read
-     * \param [out]  prefixes   Reference to a list<prefix_tuple> to be updated with entries
+     * \param [out]  prefixes   Reference to a vector<prefix_tuple> to be updated with entries
      */
-    void parseNlriData_v4(u_char *data, uint16_t len, std::list<bgp::prefix_tuple> &prefixes);
+    void parseNlriData_v4(u_char *data, uint16_t len, std::vector<bgp::prefix_tuple> &prefixes);
 
     /**
      * Parses the BGP attributes in the update
@@ -213,6 +284,19 @@ private:
      */
     void parseAttributes(u_char *data, uint16_t len, parsed_update_data &parsed_data);
 
+    /**
+     * Get the attribute set key of the update
+     *
+     * \details
+     *     Sets attrs_key and attrs_hash in 'parsed_data'.  The NLRI of MP_REACH and MP_UNREACH are
+     *     left out, updates differing only by their prefixes have the same key.
+     *
+     * \param [in]   data           Pointer to the start of the attributes
+     * \param [in]   len            Length of the attributes in bytes
+     * \param [out]  parsed_data    Reference to parsed_update_data; will be updated with the key
+     */
+    void keyAttributes(u_char *data, uint16_t len, parsed_update_data &parsed_data);
+
     /**
      * Parse attribute data based on attribute type
      *
@@ -232,18 +316,18 @@ private:
      *
      * \param [in]   attr_len       Length of the attribute data
      * \param [in]   data           Pointer to the attribute data
-     * \param [out]  attrs          Reference to the parsed attr map - will be updated
+     * \param [out]  attrs          Reference to the parsed path attributes - will be updated
      */
-    void parseAttr_AsPath(uint16_t attr_len, u_char *data, parsed_attrs_map &attrs);
+    void parseAttr_AsPath(uint16_t attr_len, u_char *data, parsed_path_attrs &attrs);
 
     /**
      * Parse attribute AGGEGATOR data
      *
      * \param [in]   attr_len       Length of the attribute data
      * \param [in]   data           Pointer to the attribute data
-     * \param [out]  attrs          Reference to the parsed attr map - will be updated
+     * \param [out]  attrs          Reference to the parsed path attributes - will be updated
      */
-    void parseAttr_Aggegator(uint16_t attr_len, u_char *data, parsed_attrs_map &attrs);
+    void parseAttr_Aggegator(uint16_t attr_len, u_char *data, parsed_path_attrs &attrs);
 
 };
 
@@ -24,6 +24,7 @@ namespace bgp {
     #define BGP_VERSION             4
     #define BGP_CAP_PARAM_TYPE      2
     #define BGP_AS_TRANS            23456                   // BGP ASN when AS exceeds 16bits
+    #define PREFIX_LABELS_STR_LEN   64                      // Printed labels of a prefix, room for 8 labels
 
 
     /**
@@ -119,12 +120,11 @@ namespace bgp {
         */
         PREFIX_TYPE   type;                 ///< Prefix type - RIB type
         unsigned char len;                  ///< Length of prefix in bits
-        std::string   prefix;               ///< Printed form of the IP address
         uint8_t       prefix_bin[16];       ///< Prefix in binary form
         uint32_t      path_id;              ///< Path ID (add path draft-ietf-idr-add-paths-15)
         bool          isIPv4;               ///< True if IPv4, false if IPv6
 
-        std::string   labels;               ///< Labels in the format of label, label, ...
+        char          labels[PREFIX_LABELS_STR_LEN];    ///< Labels in the format of label,label,...  Empty if none
     };
 
     /**
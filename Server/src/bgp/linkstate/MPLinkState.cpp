@@ -45,18 +45,8 @@ namespace bgp_msg {
 
         // Process the next hop
         // Next-hop is an IPv6 address - Change/set the next-hop attribute in parsed data to use this next-hop
-        u_char ip_raw[16];
-        char ip_char[40];
-
-        if (nlri.nh_len == 4) {
-            memcpy(ip_raw, nlri.next_hop, nlri.nh_len);
-            inet_ntop(AF_INET, ip_raw, ip_char, sizeof(ip_char));
-        } else if (nlri.nh_len > 4) {
-            memcpy(ip_raw, nlri.next_hop, nlri.nh_len);
-            inet_ntop(AF_INET6, ip_raw, ip_char, sizeof(ip_char));
-        }
-
-        parsed_data->attrs[ATTR_TYPE_NEXT_HOP] = std::string(ip_char);
+        if (nlri.nh_len >= 4)
+            UpdateMsg::setNextHop(*parsed_data, nlri.next_hop, nlri.nh_len, nlri.nh_len == 4);
 
         /*
          * Decode based on SAFI
@@ -29,9 +29,46 @@
 #include "OpenMsg.h"
 #include "UpdateMsg.h"
 #include "bgp_common.h"
+#include "AdjRib.h"
+#include "AttrCache.h"
 
 using namespace std;
 
+/**
+ * Continue a fingerprint (FNV-1a) with a block of bytes
+ *
+ * \param [in] hash     Fingerprint so far
+ * \param [in] data     Bytes to add
+ * \param [in] len      Length of the bytes
+ */
+static uint64_t fingerprint(uint64_t hash, const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+/**
+ * Get the RIB key of a prefix
+ *
+ * \param [in]  peer    Peer entry of the prefix
+ * \param [in]  tuple   Parsed prefix
+ * \param [out] key     RIB key
+ */
+static void ribKey(const MsgBusInterface::obj_bgp_peer &peer, const bgp::prefix_tuple &tuple, AdjRib::Key &key) {
+    memset(&key, 0, sizeof(key));
+
+    key.table = AdjRib::getTable(peer);
+    key.type = tuple.type;
+    key.len = tuple.len;
+    key.path_id = tuple.path_id;
+    memcpy(key.prefix, tuple.prefix_bin, sizeof(key.prefix));
+}
+
 /**
  * Constructor for class -
  *
@@ -74,6 +111,20 @@ parseBGP::parseBGP(Logger *logPtr, MsgBusInterface *mbus_ptr, MsgBusInterface::o
 parseBGP::~parseBGP() {
 }
 
+/**
+ * Reset the parser for the next message
+ *
+ * \param [in,out] peer_info   Persistent peer information
+ */
+void parseBGP::reset(BMPReader::peer_info *peer_info) {
+    data_bytes_remaining = 0;
+    data = NULL;
+
+    bzero(&common_hdr, sizeof(common_hdr));
+
+    p_info = peer_info;
+}
+
 /**
  * handle BGP update message and store in DB
  *
@@ -85,7 +136,6 @@ parseBGP::~parseBGP() {
  * \returns True if error, false if no error.
  */
 bool parseBGP::handleUpdate(u_char *data, size_t size) {
-    bgp_msg::UpdateMsg::parsed_update_data parsed_data;
     int read_size = 0;
 
     if (parseBgpHeader(data, size) == BGP_MSG_UPDATE) {
@@ -96,7 +146,7 @@ bool parseBGP::handleUpdate(u_char *data, size_t size) {
          */
         bgp_msg::UpdateMsg uMsg(logger, p_entry->peer_addr, router_addr, p_info, debug);
 
-        if ((read_size=uMsg.parseUpdateMsg(data, data_bytes_remaining, parsed_data)) != (size - BGP_MSG_HDR_LEN)) {
+        if ((read_size=uMsg.parseUpdateMsg(data, data_bytes_remaining, update_data)) != (size - BGP_MSG_HDR_LEN)) {
             LOG_NOTICE("%s: rtr=%s: Failed to parse the update message, read %d expected %d", p_entry->peer_addr,
                         router_addr.c_str(), read_size, (size - read_size));
             return true;
@@ -107,7 +157,7 @@ bool parseBGP::handleUpdate(u_char *data, size_t size) {
         /*
          * Update the DB with the update data
          */
-        UpdateDB(parsed_data);
+        UpdateDB(update_data);
     }
 
     return false;
@@ -339,6 +389,34 @@ u_char parseBGP::parseBgpHeader(u_char *data, size_t size) {
     return common_hdr.type;
 }
 
+/**
+ * Withdraw all prefixes of the peer, called on PEER DOWN
+ *
+ * \details With the RIB of the peer, its paths are withdrawn in batches and the RIB is
+ *          cleared.  Without, the message bus removes the prefixes it has of the peer.
+ */
+void parseBGP::flushPrefixes() {
+    if (p_info->rib == NULL) {
+        // One batch per call, other peers sharing the message bus get their turn between them
+        while (mbus_ptr->flush_PeerPrefixes(*p_entry))
+            ;
+        return;
+    }
+
+    std::vector<AdjRib::Key> keys;
+    p_info->rib->getPaths(keys);
+
+    if (keys.size() > 0) {
+        LOG_INFO("%s: rtr=%s: Peer down, withdrawing %zu prefixes", p_entry->peer_addr, router_addr.c_str(),
+                 keys.size());
+
+        UpdateDBRemovePaths(keys);
+    }
+
+    // The peer RIB is gone downstream, nothing can be suppressed on the next PEER UP
+    p_info->rib->clear();
+}
+
 /**
  * Update the Database with the parsed updated data
  *
@@ -350,9 +428,7 @@ void parseBGP::UpdateDB(bgp_msg::UpdateMsg::parsed_update_data &parsed_data) {
     /*
      * Update the path attributes
      */
-    #ifndef REDIS_ENABLED
-    UpdateDBAttrs(parsed_data.attrs);
-    #endif
+    UpdateDBAttrs(parsed_data);
 
     /*
      * Update the bgp-ls data
@@ -365,7 +441,7 @@ void parseBGP::UpdateDB(bgp_msg::UpdateMsg::parsed_update_data &parsed_data) {
     /*
      * Update the advertised prefixes (both ipv4 and ipv6)
      */
-    UpdateDBAdvPrefixes(parsed_data.advertised, parsed_data.attrs);
+    UpdateDBAdvPrefixes(parsed_data.advertised, parsed_data);
 
     #ifndef REDIS_ENABLED
     UpdateDBL3Vpn(false,parsed_data.vpn, parsed_data.attrs);
@@ -380,6 +456,11 @@ void parseBGP::UpdateDB(bgp_msg::UpdateMsg::parsed_update_data &parsed_data) {
      */
     UpdateDBWdrawnPrefixes(parsed_data.withdrawn);
 
+    /*
+     * Withdraw the prefixes of the last session the peer didn't send again
+     */
+    if (parsed_data.end_of_rib and p_info->rib != NULL)
+        UpdateDBStalePrefixes(parsed_data.end_of_rib);
 }
 
 /**
@@ -387,68 +468,27 @@ void parseBGP::UpdateDB(bgp_msg::UpdateMsg::parsed_update_data &parsed_data) {
  *
  * \details This method will update the database for the supplied path attributes
  *
- * \param  attrs            Reference to the parsed attributes map
+ * \param  parsed_data      Reference to the parsed update data
  */
-void parseBGP::UpdateDBAttrs(bgp_msg::UpdateMsg::parsed_attrs_map &attrs) {
+void parseBGP::UpdateDBAttrs(bgp_msg::UpdateMsg::parsed_update_data &parsed_data) {
+
+    // Attributes already sent for the peer
+    if (parsed_data.cached_attrs != NULL) {
+        SELF_DEBUG("%s: attributes already sent to message bus", p_entry->peer_addr);
+
+        base_attr = *parsed_data.cached_attrs;
+        memcpy(path_hash_id, base_attr.hash_id, sizeof(path_hash_id));
+        return;
+    }
 
     /*
-     * Setup the record
+     * Setup the record, the only place the attributes are printed
      */
-    base_attr.as_path                  = (string)attrs[bgp_msg::ATTR_TYPE_AS_PATH];
-    base_attr.cluster_list             = (string)attrs[bgp_msg::ATTR_TYPE_CLUSTER_LIST];
-    base_attr.community_list           = (string)attrs[bgp_msg::ATTR_TYPE_COMMUNITIES];
-    base_attr.ext_community_list       = (string)attrs[bgp_msg::ATTR_TYPE_EXT_COMMUNITY];
-    base_attr.large_community_list     = (string)attrs[bgp_msg::ATTR_TYPE_LARGE_COMMUNITY];
-
-    base_attr.atomic_agg               = ((string)attrs[bgp_msg::ATTR_TYPE_ATOMIC_AGGREGATE]).compare("1") == 0 ? true : false;
-
-    if (((string)attrs[bgp_msg::ATTR_TYPE_LOCAL_PREF]).length() > 0)
-        base_attr.local_pref = std::stoul(((string)attrs[bgp_msg::ATTR_TYPE_LOCAL_PREF]));
-    else
-        base_attr.local_pref = 0;
-
-    if (((string)attrs[bgp_msg::ATTR_TYPE_MED]).length() > 0)
-        base_attr.med = std::stoul(((string)attrs[bgp_msg::ATTR_TYPE_MED]));
-    else
-        base_attr.med = 0;
-
-    if (((string)attrs[bgp_msg::ATTR_TYPE_INTERNAL_AS_COUNT]).length() > 0)
-        base_attr.as_path_count = std::stoi(((string)attrs[bgp_msg::ATTR_TYPE_INTERNAL_AS_COUNT]));
-    else
-        base_attr.as_path_count = 0;
-
-    if (((string)attrs[bgp_msg::ATTR_TYPE_INTERNAL_AS_ORIGIN]).length() > 0)
-        base_attr.origin_as = std::stoul(((string)attrs[bgp_msg::ATTR_TYPE_INTERNAL_AS_ORIGIN]));
-    else
-        base_attr.origin_as = 0;
-
-    if (((string)attrs[bgp_msg::ATTR_TYPE_ORIGINATOR_ID]).length() > 0)
-        strncpy(base_attr.originator_id, ((string)attrs[bgp_msg::ATTR_TYPE_ORIGINATOR_ID]).c_str(), sizeof(base_attr.originator_id));
-    else
-        bzero(base_attr.originator_id, sizeof(base_attr.originator_id));
-
-    if ( ((string)attrs[bgp_msg::ATTR_TYPE_NEXT_HOP]).find_first_of(':') ==  string::npos)
-        base_attr.nexthop_isIPv4 = true;
-    else // is IPv6
-        base_attr.nexthop_isIPv4 = false;
-
-    if ( ((string)attrs[bgp_msg::ATTR_TYPE_AGGEGATOR]).length() > 0)
-        strncpy(base_attr.aggregator, ((string)attrs[bgp_msg::ATTR_TYPE_AGGEGATOR]).c_str(), sizeof(base_attr.aggregator));
-    else
-        bzero(base_attr.aggregator, sizeof(base_attr.aggregator));
-
-    if ( ((string)attrs[bgp_msg::ATTR_TYPE_ORIGIN]).length() > 0)
-            strncpy(base_attr.origin, ((string)attrs[bgp_msg::ATTR_TYPE_ORIGIN]).c_str(), sizeof(base_attr.origin));
-    else
-        bzero(base_attr.origin, sizeof(base_attr.origin));
-
-    if ( ((string)attrs[bgp_msg::ATTR_TYPE_NEXT_HOP]).length() > 0)
-        strncpy(base_attr.next_hop, ((string)attrs[bgp_msg::ATTR_TYPE_NEXT_HOP]).c_str(), sizeof(base_attr.next_hop));
+    bgp_msg::UpdateMsg::formatAttrs(parsed_data, base_attr);
 
-    else {
+    if (not (parsed_data.path_attrs.present & ATTR_PRESENT(bgp_msg::ATTR_TYPE_NEXT_HOP))) {
         // Skip adding path attributes if next hop is missing
         SELF_DEBUG("%s: no next-hop, must be unreach; not sending attributes to message bus", p_entry->peer_addr);
-        bzero(base_attr.next_hop, sizeof(base_attr.next_hop));
         bzero(path_hash_id, sizeof(path_hash_id));
         return;
     }
@@ -460,6 +500,9 @@ void parseBGP::UpdateDBAttrs(bgp_msg::UpdateMsg::parsed_attrs_map &attrs) {
 
     // Update the class instance variable path_hash_id
     memcpy(path_hash_id, base_attr.hash_id, sizeof(path_hash_id));
+
+    if (p_info->attr_cache != NULL)
+        p_info->attr_cache->add(parsed_data.attrs_key, parsed_data.attrs_hash, base_attr);
 }
 
 /**
@@ -468,10 +511,10 @@ void parseBGP::UpdateDBAttrs(bgp_msg::UpdateMsg::parsed_attrs_map &attrs) {
  * \details This method will update the database for the supplied advertised prefixes
  *
  * \param [in] remove          True if the records should be deleted, false if they are to be added/updated
- * \param [in] prefixes        Reference to the list<vpn_tuple> of advertised vpns
+ * \param [in] prefixes        Reference to the vector<vpn_tuple> of advertised vpns
  * \param [in] attrs           Reference to the parsed attributes map
  */
-void parseBGP::UpdateDBL3Vpn(bool remove, std::list<bgp::vpn_tuple> &prefixes,
+void parseBGP::UpdateDBL3Vpn(bool remove, std::vector<bgp::vpn_tuple> &prefixes,
                              bgp_msg::UpdateMsg::parsed_attrs_map &attrs) {
     vector<MsgBusInterface::obj_vpn> rib_list;
     MsgBusInterface::obj_vpn         rib_entry;
@@ -481,7 +524,7 @@ void parseBGP::UpdateDBL3Vpn(bool remove, std::list<bgp::vpn_tuple> &prefixes,
     /*
      * Loop through all vpn and add/update them in the DB
      */
-    for (std::list<bgp::vpn_tuple>::iterator it = prefixes.begin();
+    for (std::vector<bgp::vpn_tuple>::iterator it = prefixes.begin();
                                                 it != prefixes.end();
                                                 it++) {
         bgp::vpn_tuple &tuple = (*it);
@@ -493,11 +536,9 @@ void parseBGP::UpdateDBL3Vpn(bool remove, std::list<bgp::vpn_tuple> &prefixes,
         rib_entry.rd_assigned_number = tuple.rd_assigned_number;
         rib_entry.rd_administrator_subfield = tuple.rd_administrator_subfield;
 
-        strncpy(rib_entry.prefix, tuple.prefix.c_str(), sizeof(rib_entry.prefix));
-        
         rib_entry.prefix_len = tuple.len;
 
-        snprintf(rib_entry.labels, sizeof(rib_entry.labels), "%s", tuple.labels.c_str());
+        snprintf(rib_entry.labels, sizeof(rib_entry.labels), "%s", tuple.labels);
         
         rib_entry.isIPv4 = tuple.isIPv4 ? 1 : 0;
 
@@ -548,10 +589,14 @@ void parseBGP::UpdateDBL3Vpn(bool remove, std::list<bgp::vpn_tuple> &prefixes,
         }
 
         rib_entry.path_id = tuple.path_id;
-        snprintf(rib_entry.labels, sizeof(rib_entry.labels), "%s", tuple.labels.c_str());
+        snprintf(rib_entry.labels, sizeof(rib_entry.labels), "%s", tuple.labels);
 
-        SELF_DEBUG("%s: %s vpn=%s len=%d", p_entry->peer_addr, remove ? "removing" : "adding",
-                   rib_entry.prefix, rib_entry.prefix_len);
+        if (debug) {
+            char prefix[PREFIX_STR_LEN];
+            MsgBusInterface::prefix_toStr(rib_entry.prefix_bin, rib_entry.isIPv4, prefix);
+            SELF_DEBUG("%s: %s vpn=%s len=%d", p_entry->peer_addr, remove ? "removing" : "adding",
+                       prefix, rib_entry.prefix_len);
+        }
 
         // Add entry to the list
         rib_list.insert(rib_list.end(), rib_entry);
@@ -570,10 +615,10 @@ void parseBGP::UpdateDBL3Vpn(bool remove, std::list<bgp::vpn_tuple> &prefixes,
  * Updates for either advertised or withdrawn Evpn NLRI's
  *
  * \param [in] remove          True if the records should be deleted, false if they are to be added/updated
- * \param [in] nlris           Reference to the list<evpn_tuple>
+ * \param [in] nlris           Reference to the vector<evpn_tuple>
  * \param [in] attrs           Reference to the parsed attributes map
  */
-void parseBGP::UpdateDBeVPN(bool remove, std::list<bgp::evpn_tuple> &nlris,
+void parseBGP::UpdateDBeVPN(bool remove, std::vector<bgp::evpn_tuple> &nlris,
                            bgp_msg::UpdateMsg::parsed_attrs_map &attrs) {
 
     vector<MsgBusInterface::obj_evpn> rib_list;
@@ -582,7 +627,7 @@ void parseBGP::UpdateDBeVPN(bool remove, std::list<bgp::evpn_tuple> &nlris,
     /*
      * Loop through all vpn and add/update them in the DB
      */
-    for (std::list<bgp::evpn_tuple>::iterator it = nlris.begin();
+    for (std::vector<bgp::evpn_tuple>::iterator it = nlris.begin();
          it != nlris.end();
          it++) {
         bgp::evpn_tuple &tuple = (*it);
@@ -630,29 +675,36 @@ void parseBGP::UpdateDBeVPN(bool remove, std::list<bgp::evpn_tuple> &nlris,
  *
  * \details This method will update the database for the supplied advertised prefixes
  *
- * \param  adv_prefixes         Reference to the list<prefix_tuple> of advertised prefixes
- * \param  attrs            Reference to the parsed attributes map
+ * \param  adv_prefixes         Reference to the vector<prefix_tuple> of advertised prefixes
+ * \param  parsed_data      Reference to the parsed update data
  */
-void parseBGP::UpdateDBAdvPrefixes(std::list<bgp::prefix_tuple> &adv_prefixes,
-                                   bgp_msg::UpdateMsg::parsed_attrs_map &attrs) {
-    vector<MsgBusInterface::obj_rib> rib_list;
+void parseBGP::UpdateDBAdvPrefixes(std::vector<bgp::prefix_tuple> &adv_prefixes,
+                                   bgp_msg::UpdateMsg::parsed_update_data &parsed_data) {
     MsgBusInterface::obj_rib         rib_entry;
     uint32_t                         value_32bit;
     uint64_t                         value_64bit;
+    AdjRib::Key                      key;
+    uint64_t                         attr_id = parsed_data.attrs_hash;
 
     /*
      * Loop through all prefixes and add/update them in the DB
      */
-    for (std::list<bgp::prefix_tuple>::iterator it = adv_prefixes.begin();
+    for (std::vector<bgp::prefix_tuple>::iterator it = adv_prefixes.begin();
                                                 it != adv_prefixes.end();
                                                 it++) {
         bgp::prefix_tuple &tuple = (*it);
 
+        // Already sent with the same attributes, in this or a previous session
+        if (p_info->rib != NULL) {
+            ribKey(*p_entry, tuple, key);
+
+            if (not p_info->rib->update(key, fingerprint(attr_id, tuple.labels, strlen(tuple.labels))))
+                continue;
+        }
+
         memcpy(rib_entry.path_attr_hash_id, path_hash_id, sizeof(rib_entry.path_attr_hash_id));
         memcpy(rib_entry.peer_hash_id, p_entry->hash_id, sizeof(rib_entry.peer_hash_id));
 
-        strncpy(rib_entry.prefix, tuple.prefix.c_str(), sizeof(rib_entry.prefix));
-
         rib_entry.prefix_len     = tuple.len;
 
         rib_entry.isIPv4 = tuple.isIPv4 ? 1 : 0;
@@ -704,19 +756,23 @@ void parseBGP::UpdateDBAdvPrefixes(std::list<bgp::prefix_tuple> &adv_prefixes,
         }
 
         rib_entry.path_id = tuple.path_id;
-        snprintf(rib_entry.labels, sizeof(rib_entry.labels), "%s", tuple.labels.c_str());
+        snprintf(rib_entry.labels, sizeof(rib_entry.labels), "%s", tuple.labels);
 
-        SELF_DEBUG("%s: Adding prefix=%s len=%d", p_entry->peer_addr, rib_entry.prefix, rib_entry.prefix_len);
+        if (debug) {
+            char prefix[PREFIX_STR_LEN];
+            MsgBusInterface::prefix_toStr(rib_entry.prefix_bin, rib_entry.isIPv4, prefix);
+            SELF_DEBUG("%s: Adding prefix=%s len=%d", p_entry->peer_addr, prefix, rib_entry.prefix_len);
+        }
 
         // Add entry to the list
-        rib_list.insert(rib_list.end(), rib_entry);
+        unicast_list.insert(unicast_list.end(), rib_entry);
     }
 
     // Update the DB
-    if (rib_list.size() > 0)
-        mbus_ptr->update_unicastPrefix(*p_entry, rib_list, &base_attr, mbus_ptr->UNICAST_PREFIX_ACTION_ADD);
+    if (unicast_list.size() > 0)
+        mbus_ptr->update_unicastPrefix(*p_entry, unicast_list, &base_attr, mbus_ptr->UNICAST_PREFIX_ACTION_ADD);
 
-    rib_list.clear();
+    unicast_list.clear();
     adv_prefixes.clear();
 }
 
@@ -725,23 +781,30 @@ void parseBGP::UpdateDBAdvPrefixes(std::list<bgp::prefix_tuple> &adv_prefixes,
  *
  * \details This method will update the database for the supplied advertised prefixes
  *
- * \param  wdrawn_prefixes         Reference to the list<prefix_tuple> of withdrawn prefixes
+ * \param  wdrawn_prefixes         Reference to the vector<prefix_tuple> of withdrawn prefixes
  */
-void parseBGP::UpdateDBWdrawnPrefixes(std::list<bgp::prefix_tuple> &wdrawn_prefixes) {
-    vector<MsgBusInterface::obj_rib> rib_list;
+void parseBGP::UpdateDBWdrawnPrefixes(std::vector<bgp::prefix_tuple> &wdrawn_prefixes) {
     MsgBusInterface::obj_rib         rib_entry;
+    AdjRib::Key                      key;
 
     /*
      * Loop through all prefixes and add/update them in the DB
      */
-    for (std::list<bgp::prefix_tuple>::iterator it = wdrawn_prefixes.begin();
+    for (std::vector<bgp::prefix_tuple>::iterator it = wdrawn_prefixes.begin();
                                                 it != wdrawn_prefixes.end();
                                                 it++) {
 
         bgp::prefix_tuple &tuple = (*it);
+
+        // Never sent, nothing to withdraw
+        if (p_info->rib != NULL) {
+            ribKey(*p_entry, tuple, key);
+
+            if (not p_info->rib->remove(key))
+                continue;
+        }
         memcpy(rib_entry.path_attr_hash_id, path_hash_id, sizeof(rib_entry.path_attr_hash_id));
         memcpy(rib_entry.peer_hash_id, p_entry->hash_id, sizeof(rib_entry.peer_hash_id));
-        strncpy(rib_entry.prefix, tuple.prefix.c_str(), sizeof(rib_entry.prefix));
 
         rib_entry.prefix_len     = tuple.len;
 
@@ -750,22 +813,98 @@ void parseBGP::UpdateDBWdrawnPrefixes(std::list<bgp::prefix_tuple> &wdrawn_prefi
         memcpy(rib_entry.prefix_bin, tuple.prefix_bin, sizeof(rib_entry.prefix_bin));
 
         rib_entry.path_id = tuple.path_id;
-        snprintf(rib_entry.labels, sizeof(rib_entry.labels), "%s", tuple.labels.c_str());
+        snprintf(rib_entry.labels, sizeof(rib_entry.labels), "%s", tuple.labels);
 
-        SELF_DEBUG("%s: Removing prefix=%s len=%d", p_entry->peer_addr, rib_entry.prefix, rib_entry.prefix_len);
+        if (debug) {
+            char prefix[PREFIX_STR_LEN];
+            MsgBusInterface::prefix_toStr(rib_entry.prefix_bin, rib_entry.isIPv4, prefix);
+            SELF_DEBUG("%s: Removing prefix=%s len=%d", p_entry->peer_addr, prefix, rib_entry.prefix_len);
+        }
 
         // Add entry to the list
-        rib_list.insert(rib_list.end(), rib_entry);
+        unicast_list.insert(unicast_list.end(), rib_entry);
     }
 
     // Update the DB
-    if (rib_list.size() > 0)
-        mbus_ptr->update_unicastPrefix(*p_entry, rib_list, NULL, mbus_ptr->UNICAST_PREFIX_ACTION_DEL);
+    if (unicast_list.size() > 0)
+        mbus_ptr->update_unicastPrefix(*p_entry, unicast_list, NULL, mbus_ptr->UNICAST_PREFIX_ACTION_DEL);
 
-    rib_list.clear();
+    unicast_list.clear();
     wdrawn_prefixes.clear();
 }
 
+/**
+ * Withdraw the prefixes of the RIB that were not advertised again
+ *
+ * \details Called on the End-Of-RIB of the type.  The prefixes sent in a previous session
+ *          and not confirmed in this one are gone from the peer.
+ *
+ * \param  type                   bgp::PREFIX_TYPE of the End-Of-RIB
+ */
+void parseBGP::UpdateDBStalePrefixes(uint8_t type) {
+    std::vector<AdjRib::Key> stale;
+
+    p_info->rib->sweep(AdjRib::getTable(*p_entry), type, stale);
+
+    if (stale.empty())
+        return;
+
+    LOG_INFO("%s: rtr=%s: Withdrawing %zu prefixes not advertised again since the last session",
+             p_entry->peer_addr, router_addr.c_str(), stale.size());
+
+    UpdateDBRemovePaths(stale);
+}
+
+/**
+ * Withdraw paths of the RIB of the peer
+ *
+ * \details The paths are sent in batches of BGP_WITHDRAW_BATCH, each with the peer
+ *          flags of its table.
+ *
+ * \param  keys                   Keys of the paths, grouped by table
+ */
+void parseBGP::UpdateDBRemovePaths(std::vector<AdjRib::Key> &keys) {
+    vector<MsgBusInterface::obj_rib> rib_list;
+    MsgBusInterface::obj_rib         rib_entry;
+    MsgBusInterface::obj_bgp_peer    peer = *p_entry;
+
+    rib_list.reserve(keys.size() < BGP_WITHDRAW_BATCH ? keys.size() : BGP_WITHDRAW_BATCH);
+    memset(&rib_entry, 0, sizeof(rib_entry));
+    memcpy(rib_entry.peer_hash_id, p_entry->hash_id, sizeof(rib_entry.peer_hash_id));
+
+    for (size_t i = 0; i < keys.size(); i++) {
+        AdjRib::Key &key = keys[i];
+
+        // Each call is for one table of the peer
+        if (i == 0 or key.table != keys[i - 1].table) {
+            if (rib_list.size() > 0)
+                mbus_ptr->update_unicastPrefix(peer, rib_list, NULL, mbus_ptr->UNICAST_PREFIX_ACTION_DEL);
+            rib_list.clear();
+
+            peer.isAdjIn = not (key.table & 1);
+            peer.isPrePolicy = not (key.table & 2);
+            peer.isLocRib = key.table & 4;
+        }
+
+        rib_entry.isIPv4 = (key.type == bgp::PREFIX_UNICAST_V4 or key.type == bgp::PREFIX_LABEL_UNICAST_V4) ? 1 : 0;
+
+        rib_entry.prefix_len = key.len;
+        memcpy(rib_entry.prefix_bin, key.prefix, sizeof(rib_entry.prefix_bin));
+        rib_entry.path_id = key.path_id;
+
+        rib_list.push_back(rib_entry);
+
+        // Other peers sharing the message bus get their turn between batches
+        if (rib_list.size() >= BGP_WITHDRAW_BATCH) {
+            mbus_ptr->update_unicastPrefix(peer, rib_list, NULL, mbus_ptr->UNICAST_PREFIX_ACTION_DEL);
+            rib_list.clear();
+        }
+    }
+
+    if (rib_list.size() > 0)
+        mbus_ptr->update_unicastPrefix(peer, rib_list, NULL, mbus_ptr->UNICAST_PREFIX_ACTION_DEL);
+}
+
 /**
  * Update the Database for bgp-ls
  *
@@ -777,7 +916,7 @@ void parseBGP::UpdateDBWdrawnPrefixes(std::list<bgp::prefix_tuple> &wdrawn_prefi
  * \param [in] ls_data     Reference to the parsed link state nlri information
  * \param [in] ls_attrs    Reference to the parsed link state attribute information
  */
-void parseBGP::UpdateDbBgpLs(bool remove, bgp_msg::UpdateMsg::parsed_data_ls ls_data,
+void parseBGP::UpdateDbBgpLs(bool remove, bgp_msg::UpdateMsg::parsed_data_ls &ls_data,
                              bgp_msg::UpdateMsg::parsed_ls_attrs_map &ls_attrs) {
     /*
      * Update table entry with attributes based on NLRI
@@ -786,7 +925,7 @@ void parseBGP::UpdateDbBgpLs(bool remove, bgp_msg::UpdateMsg::parsed_data_ls ls_
         SELF_DEBUG("%s: Updating BGP-LS: Nodes %d", p_entry->peer_addr, ls_data.nodes.size());
 
         // Merge attributes to each table entry
-        for (list<MsgBusInterface::obj_ls_node>::iterator it = ls_data.nodes.begin();
+        for (vector<MsgBusInterface::obj_ls_node>::iterator it = ls_data.nodes.begin();
                 it != ls_data.nodes.end(); it++) {
 
             if (ls_attrs.find(bgp_msg::MPLinkStateAttr::ATTR_NODE_NAME) != ls_attrs.end())
@@ -826,7 +965,7 @@ void parseBGP::UpdateDbBgpLs(bool remove, bgp_msg::UpdateMsg::parsed_data_ls ls_
         SELF_DEBUG("%s: Updating BGP-LS: Links %d ", p_entry->peer_addr, ls_data.links.size());
 
         // Merge attributes to each table entry
-        for (list<MsgBusInterface::obj_ls_link>::iterator it = ls_data.links.begin();
+        for (vector<MsgBusInterface::obj_ls_link>::iterator it = ls_data.links.begin();
              it != ls_data.links.end(); it++) {
 
             if (not (*it).isIPv4 and ls_attrs.find(bgp_msg::MPLinkStateAttr::ATTR_NODE_IPV6_ROUTER_ID_LOCAL) != ls_attrs.end())
@@ -897,7 +1036,7 @@ void parseBGP::UpdateDbBgpLs(bool remove, bgp_msg::UpdateMsg::parsed_data_ls ls_
         SELF_DEBUG("%s: Updating BGP-LS: Prefixes %d ", p_entry->peer_addr, ls_data.prefixes.size());
 
         // Merge attributes to each table entry
-        for (list<MsgBusInterface::obj_ls_prefix>::iterator it = ls_data.prefixes.begin();
+        for (vector<MsgBusInterface::obj_ls_prefix>::iterator it = ls_data.prefixes.begin();
              it != ls_data.prefixes.end(); it++) {
 
             if (not (*it).isIPv4 and ls_attrs.find(bgp_msg::MPLinkStateAttr::ATTR_NODE_IPV6_ROUTER_ID_LOCAL) != ls_attrs.end())
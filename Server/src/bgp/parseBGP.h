@@ -13,11 +13,13 @@
 #include <vector>
 #include <list>
 #include <BMPReader.h>
+#include "AdjRib.h"
 #include "MsgBusInterface.hpp"
 #include "Logger.h"
 #include "bgp_common.h"
 #include "UpdateMsg.h"
 
+#define BGP_WITHDRAW_BATCH      1000        ///< Max prefixes per message bus call when withdrawing from the RIB
 
 using namespace std;
 
@@ -84,6 +86,16 @@ public:
 
     virtual ~parseBGP();
 
+    /**
+     * Reset the parser for the next message
+     *
+     * \details The parser is reused for all messages of a connection, the peer entry
+     *          pointer stays the same but the persistent peer info changes per peer.
+     *
+     * \param [in,out] peer_info   Persistent peer information
+     */
+    void reset(BMPReader::peer_info *peer_info);
+
     /**
      * handle BGP update message and store in DB
      *
@@ -125,6 +137,14 @@ public:
      */
     int handleUpEvent(u_char *data, size_t size, MsgBusInterface::obj_peer_up_event *up_event);
 
+    /**
+     * Withdraw all prefixes of the peer, called on PEER DOWN
+     *
+     * \details With the RIB of the peer, its paths are withdrawn in batches and the RIB is
+     *          cleared.  Without, the message bus removes the prefixes it has of the peer.
+     */
+    void flushPrefixes();
+
     /*
      * Debug methods
      */
@@ -157,6 +177,12 @@ private:
 
     unsigned char path_hash_id[16];                  ///< current path hash ID
 
+    /*
+     * Reused for every update of the peer, the containers keep their capacity
+     */
+    bgp_msg::UpdateMsg::parsed_update_data update_data;    ///< Parsed data of the update
+    std::vector<MsgBusInterface::obj_rib> unicast_list;    ///< Unicast prefixes sent to the message bus
+
     bool            debug;                           ///< debug flag to indicate debugging
     Logger          *logger;                         ///< Logging class pointer
 
@@ -189,28 +215,48 @@ private:
      *
      * \details This method will update the database for the supplied path attributes
      *
-     * \param  attrs            Reference to the parsed attributes map
+     * \param  parsed_data      Reference to the parsed update data
      */
-    void UpdateDBAttrs(bgp_msg::UpdateMsg::parsed_attrs_map &attrs);
+    void UpdateDBAttrs(bgp_msg::UpdateMsg::parsed_update_data &parsed_data);
 
     /**
      * Update the Database advertised prefixes
      *
      * \details This method will update the database for the supplied advertised prefixes
      *
-     * \param  adv_prefixes         Reference to the list<prefix_tuple> of advertised prefixes
-     * \param  attrs            Reference to the parsed attributes map
+     * \param  adv_prefixes         Reference to the vector<prefix_tuple> of advertised prefixes
+     * \param  parsed_data      Reference to the parsed update data
      */
-    void UpdateDBAdvPrefixes(std::list<bgp::prefix_tuple> &adv_prefixes, bgp_msg::UpdateMsg::parsed_attrs_map &attrs);
+    void UpdateDBAdvPrefixes(std::vector<bgp::prefix_tuple> &adv_prefixes, bgp_msg::UpdateMsg::parsed_update_data &parsed_data);
 
     /**
      * Update the Database withdrawn prefixes
      *
      * \details This method will update the database for the supplied advertised prefixes
      *
-     * \param  wdrawn_prefixes         Reference to the list<prefix_tuple> of withdrawn prefixes
+     * \param  wdrawn_prefixes         Reference to the vector<prefix_tuple> of withdrawn prefixes
+     */
+    void UpdateDBWdrawnPrefixes(std::vector<bgp::prefix_tuple> &wdrawn_prefixes);
+
+    /**
+     * Withdraw the prefixes of the RIB that were not advertised again
+     *
+     * \details Called on the End-Of-RIB of the type.  The prefixes sent in a previous session
+     *          and not confirmed in this one are gone from the peer.
+     *
+     * \param  type                   bgp::PREFIX_TYPE of the End-Of-RIB
+     */
+    void UpdateDBStalePrefixes(uint8_t type);
+
+    /**
+     * Withdraw paths of the RIB of the peer
+     *
+     * \details The paths are sent in batches of BGP_WITHDRAW_BATCH, each with the peer
+     *          flags of its table.
+     *
+     * \param  keys                   Keys of the paths, grouped by table
      */
-    void UpdateDBWdrawnPrefixes(std::list<bgp::prefix_tuple> &wdrawn_prefixes);
+    void UpdateDBRemovePaths(std::vector<AdjRib::Key> &keys);
 
     /**
      * Update the Database advertised l3vpn 
@@ -218,19 +264,19 @@ private:
      * \details This method will update the database for the supplied advertised prefixes
      *
      * \param [in] remove       True if the records should be deleted, false if they are to be added/updated
-     * \param [in] adv_vpn      Reference to the list<vpn_tuple> of advertised vpns
+     * \param [in] adv_vpn      Reference to the vector<vpn_tuple> of advertised vpns
      * \param [in] attrs        Reference to the parsed attributes map
      */ 
-    void UpdateDBL3Vpn(bool remove, std::list<bgp::vpn_tuple> &adv_vpn, bgp_msg::UpdateMsg::parsed_attrs_map &attrs);
+    void UpdateDBL3Vpn(bool remove, std::vector<bgp::vpn_tuple> &adv_vpn, bgp_msg::UpdateMsg::parsed_attrs_map &attrs);
 
     /**
      * Updates for either advertised or withdrawn Evpn NLRI's
      *
      * \param [in] remove          True if the records should be deleted, false if they are to be added/updated
-     * \param [in] nlris           Reference to the list<evpn_tuple>
+     * \param [in] nlris           Reference to the vector<evpn_tuple>
      * \param [in] attrs           Reference to the parsed attributes map
      */
-    void UpdateDBeVPN(bool remove, std::list<bgp::evpn_tuple> &nlris, bgp_msg::UpdateMsg::parsed_attrs_map &attrs);
+    void UpdateDBeVPN(bool remove, std::vector<bgp::evpn_tuple> &nlris, bgp_msg::UpdateMsg::parsed_attrs_map &attrs);
 
     /**
      * Update the Database for bgp-ls
@@ -241,7 +287,7 @@ private:
      * \param [in] ls_data     Reference to the parsed link state nlri information
      * \param [in] ls_attrs    Reference to the parsed link state attribute information
      */
-    void UpdateDbBgpLs(bool remove, bgp_msg::UpdateMsg::parsed_data_ls ls_data,
+    void UpdateDbBgpLs(bool remove, bgp_msg::UpdateMsg::parsed_data_ls &ls_data,
                                  bgp_msg::UpdateMsg::parsed_ls_attrs_map &ls_attrs);
 
 
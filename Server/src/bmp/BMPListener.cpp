@@ -20,6 +20,10 @@
 #include <string>
 
 #include <poll.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <MsgBusInterface.hpp>
 
 #include "BMPListener.h"
@@ -35,9 +39,8 @@ using namespace std;
  *
  */
 BMPListener::BMPListener(Logger *logPtr, Config *config) {
-    sock = 0;
-    sockv6 = 0;
     debug = false;
+    running = true;
 
     // Update pointer to the config
     cfg = config;
@@ -74,24 +77,109 @@ BMPListener::BMPListener(Logger *logPtr, Config *config) {
  * Destructor
  */
 BMPListener::~BMPListener() {
-    if (sock > 0)
-        close(sock);
-    if (sockv6 > 0)
-        close(sockv6);
+    running = false;
+
+    for (size_t i = 0; i < shards.size(); i++) {
+        if (shards[i]->thr != NULL) {
+            if (shards[i]->thr->joinable())
+                shards[i]->thr->join();
+
+            delete shards[i]->thr;
+        }
+
+        // Remove the socket file, so a stale one isn't left behind
+        if (shards[i]->family == AF_UNIX) {
+            sockaddr_un addr;
+            socklen_t addr_len = sizeof(addr);
+
+            if (getsockname(shards[i]->sock, (struct sockaddr *) &addr, &addr_len) == 0 and addr.sun_path[0])
+                unlink(addr.sun_path);
+        }
 
-    delete cfg;
+        close(shards[i]->sock);
+        delete shards[i];
+    }
+    shards.clear();
+
+    // Close connections that were accepted but never picked up
+    for (size_t i = 0; i < accepted.size(); i++)
+        close(accepted[i].c_sock);
+    accepted.clear();
 }
 
 /**
- * Opens server (v4 or 6) listening socket(s)
+ * Opens server (v4 or 6 and unix) listening socket(s)
  *
  * \param [in] ipv4     True to open v4 socket
  * \param [in] ipv6     True to open v6 socket
  */
 void BMPListener::open_socket(bool ipv4, bool ipv6) {
+    const int families[] = { AF_INET, AF_INET6, AF_UNIX };
+
+    for (int f = 0; f < 3; f++) {
+        int family = families[f];
+        int count = cfg->listen_shards;
+
+        if ((family == AF_INET and not ipv4) or (family == AF_INET6 and not ipv6))
+            continue;
+
+        // SO_REUSEPORT doesn't apply to unix sockets, one socket per path
+        if (family == AF_UNIX)
+            count = cfg->listen_unix.size();
+
+        for (int i = 0; i < count; i++) {
+            ListenShard *shard = new ListenShard;
+            shard->family = family;
+            shard->thr = NULL;
+
+            try {
+                if (family == AF_UNIX)
+                    shard->sock = open_unix_socket(cfg->listen_unix[i]);
+                else
+                    shard->sock = open_listen_socket(family == AF_INET);
+
+            } catch (char const *str) {
+                delete shard;
+
+                for (size_t n = 0; n < shards.size(); n++) {
+                    close(shards[n]->sock);
+                    delete shards[n];
+                }
+                shards.clear();
+
+                throw;
+            }
+
+            shards.push_back(shard);
+        }
+    }
+
+    if (shards.empty())
+        throw "ERROR: No listening sockets, set listen_mode or listen_unix";
+
+    // Start accepting only after all sockets are bound, so a bind failure doesn't leave threads running
+    for (size_t i = 0; i < shards.size(); i++)
+        shards[i]->thr = new std::thread(&BMPListener::accept_loop, this, shards[i]);
+
+    LOG_INFO("Listening on %d IPv4, %d IPv6 and %d unix sockets, backlog %d",
+             ipv4 ? cfg->listen_shards : 0, ipv6 ? cfg->listen_shards : 0,
+             (int)cfg->listen_unix.size(), cfg->listen_backlog);
+}
+
+/**
+ * Opens one non-blocking listening socket
+ *
+ * \param [in] isIPv4   True to open v4 socket, false for v6
+ *
+ * \return listening socket
+ *
+ * \throws (const char *) on error.
+ */
+int BMPListener::open_listen_socket(bool isIPv4) {
     int on = 1;
+    int sock;
 
-    if (ipv4) {
+    if (isIPv4) {
         if ((sock = socket(PF_INET, SOCK_STREAM, 0)) < 0) {
             throw "ERROR: Cannot open IPv4 socket.";
         }
@@ -102,114 +190,192 @@ void BMPListener::open_socket(bool ipv4, bool ipv6) {
             throw "ERROR: Failed to set IPv4 socket option SO_REUSEADDR";
         }
 
+        if (cfg->listen_shards > 1 and setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+            close(sock);
+            throw "ERROR: Failed to set IPv4 socket option SO_REUSEPORT";
+        }
+
         // Bind to the address/port
         if (::bind(sock, (struct sockaddr *) &svr_addr, sizeof(svr_addr)) < 0) {
             close(sock);
             throw "ERROR: Cannot bind to IPv4 address and port";
         }
 
-        // listen for incoming connections
-        listen(sock, 10);
-    }
-
-    if (ipv6) {
-        if ((sockv6 = socket(AF_INET6, SOCK_STREAM, 0)) < 0) {
+    } else {
+        if ((sock = socket(AF_INET6, SOCK_STREAM, 0)) < 0) {
             throw "ERROR: Cannot open IPv6 socket.";
         }
 
         // Set socket options
-        if (setsockopt(sockv6, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0) {
-            close(sockv6);
+        if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0) {
+            close(sock);
             throw "ERROR: Failed to set IPv6 socket option SO_REUSEADDR";
         }
 
-        if (setsockopt(sockv6, IPPROTO_IPV6, IPV6_V6ONLY, &on, sizeof(on)) < 0) {
-            close(sockv6);
+        if (cfg->listen_shards > 1 and setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+            close(sock);
+            throw "ERROR: Failed to set IPv6 socket option SO_REUSEPORT";
+        }
+
+        if (setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, &on, sizeof(on)) < 0) {
+            close(sock);
             throw "ERROR: Failed to set IPv6 socket option IPV6_V6ONLY";
         }
 
         // Bind to the address/port
-        if (::bind(sockv6, (struct sockaddr *) &svr_addrv6, sizeof(svr_addrv6)) < 0) {
-            close(sockv6);
+        if (::bind(sock, (struct sockaddr *) &svr_addrv6, sizeof(svr_addrv6)) < 0) {
+            close(sock);
             throw "ERROR: Cannot bind to IPv6 address and port";
         }
-
-        // listen for incoming connections
-        listen(sockv6, 10);
     }
+
+    start_listen(sock);
+
+    return sock;
 }
 
 /**
- * Wait and Accept new/pending connections
+ * Opens one non-blocking unix domain listening socket
  *
- * Will accept both IPv4 and IPv6 (if configured), but only one will be accepted
- * per poll/wait period.  Must run this method in a loop fashion to accept all
- * pending connections.
+ * \details A stale socket file left at the path is removed.
  *
- * \param [out] c           Ref to client info - this will be updated based on accepted connection
- * \param [in]  timeout     Timeout in ms to wait for
+ * \param [in] path     Path to bind to
  *
- * \return  True if accepted a connection, false if not (timed out waiting)
+ * \return listening socket
+ *
+ * \throws (const char *) on error.
  */
-bool BMPListener::wait_and_accept_connection(ClientInfo &c, int timeout) {
-    pollfd pfd[4];
-    int fds_cnt = 0;
-    int cur_sock = 0;
-    bool close_sock = false;
-
-    if (sock > 0) {
-        pfd[fds_cnt].fd = sock;
-        pfd[fds_cnt].events = POLLIN | POLLHUP | POLLERR;
-        pfd[fds_cnt].revents = 0;
-        fds_cnt++;
+int BMPListener::open_unix_socket(const std::string &path) {
+    sockaddr_un addr;
+    struct stat st;
+    int sock;
+
+    bzero(&addr, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path.c_str());
+
+    if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        throw "ERROR: Cannot open unix socket.";
     }
 
-    if (sockv6 > 0) {
-        pfd[fds_cnt].fd = sockv6;
-        pfd[fds_cnt].events = POLLIN | POLLHUP | POLLERR;
-        pfd[fds_cnt].revents = 0;
-        fds_cnt++;
+    // Left over from a previous run, only ever remove a socket
+    if (lstat(addr.sun_path, &st) == 0 and S_ISSOCK(st.st_mode))
+        unlink(addr.sun_path);
+
+    if (::bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        LOG_ERR("Cannot bind to unix socket %s: %s", addr.sun_path, strerror(errno));
+        close(sock);
+        throw "ERROR: Cannot bind to unix socket path";
     }
 
-    // Check if the listening socket has a new connection
-    if (poll(pfd, fds_cnt + 1, timeout)) {
+    start_listen(sock);
 
-        for (int i = 0; i < fds_cnt; i++) {
-            if (pfd[i].revents & POLLHUP or pfd[i].revents & POLLERR) {
-                LOG_WARN("sock=%d: received POLLHUP/POLLHERR while accepting", pfd[i].fd);
-                cur_sock = pfd[i].fd;
-                close_sock = true;
-                break;
+    return sock;
+}
 
-            } else if (pfd[i].revents & POLLIN) {
-                cur_sock = pfd[i].fd;
-                break;
-            }
-        }
+/**
+ * Make a listening socket non-blocking and listen on it
+ *
+ * \param [in] sock     Bound socket, closed on error
+ *
+ * \throws (const char *) on error.
+ */
+void BMPListener::start_listen(int sock) {
+    // Accept is driven by poll, a connection reset before accept must not block the shard
+    if (fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK) < 0) {
+        close(sock);
+        throw "ERROR: Failed to set listening socket non-blocking";
+    }
+
+    // listen for incoming connections
+    if (listen(sock, cfg->listen_backlog) < 0) {
+        close(sock);
+        throw "ERROR: Cannot listen on socket";
     }
+}
+
+/**
+ * Listener shard thread loop
+ *
+ * \param [in] shard    Shard that the thread runs
+ */
+void BMPListener::accept_loop(ListenShard *shard) {
+    pollfd pfd;
+    pfd.fd = shard->sock;
+    pfd.events = POLLIN;
+
+    while (running) {
+        pfd.revents = 0;
 
-    if (cur_sock > 0) {
-        if (close_sock) {
-            if (cur_sock == sock)
-                close(sock);
-            else if (cur_sock == sockv6)
-                close(sockv6);
+        if (poll(&pfd, 1, 500) <= 0)
+            continue;
+
+        if (pfd.revents & POLLHUP or pfd.revents & POLLERR) {
+            LOG_WARN("sock=%d: received POLLHUP/POLLHERR while accepting", shard->sock);
+            break;
         }
 
-        else {
-            if (cur_sock == sock)  // IPv4
-                accept_connection(c, true);
+        // Accept everything that is pending on this shard
+        while (running) {
+            {
+                std::lock_guard<std::mutex> guard(accept_lock);
+                if (accepted.size() >= (size_t) cfg->listen_backlog)
+                    break;
+            }
+
+            ClientInfo c;
+
+            try {
+                if (not accept_connection(c, shard->sock, shard->family))
+                    break;
+
+            } catch (char const *str) {
+                LOG_ERR("sock=%d: %s", shard->sock, str);
+                usleep(100000);
+                break;
+            }
+
+            gettimeofday(&c.startTime, NULL);  // Stores the start time for client
 
-            else // IPv6
-                accept_connection(c, false);
-		
-	    gettimeofday(&c.startTime, NULL);	// Stores the start time for client	
+            {
+                std::lock_guard<std::mutex> guard(accept_lock);
+                accepted.push_back(c);
+            }
+            accept_cond.notify_one();
+        }
 
-            return true;
+        // Give the main loop time to pick up connections when the queue is full
+        std::unique_lock<std::mutex> lock(accept_lock);
+        if (accepted.size() >= (size_t) cfg->listen_backlog) {
+            lock.unlock();
+            usleep(10000);
         }
     }
+}
+
+/**
+ * Wait and Accept new/pending connections
+ *
+ * Connections are accepted by the listener shard threads, IPv4, IPv6 and unix
+ * domain sockets (if configured).  Only one accepted connection is returned per call.  Must
+ * run this method in a loop fashion to get all pending connections.
+ *
+ * \param [out] c           Ref to client info - this will be updated based on accepted connection
+ * \param [in]  timeout     Timeout in ms to wait for
+ *
+ * \return  True if accepted a connection, false if not (timed out waiting)
+ */
+bool BMPListener::wait_and_accept_connection(ClientInfo &c, int timeout) {
+    std::unique_lock<std::mutex> lock(accept_lock);
+
+    if (not accept_cond.wait_for(lock, std::chrono::milliseconds(timeout),
+                                 [this] { return not accepted.empty(); }))
+        return false;
 
-    return false;
+    c = accepted.front();
+    accepted.pop_front();
+
+    return true;
 }
 
 
@@ -217,33 +383,59 @@ bool BMPListener::wait_and_accept_connection(ClientInfo &c, int timeout) {
 /**
  * Accept new/pending connections
  *
- * Will accept new connections and wait if one is not currently ready.
- * Supports IPv4 and IPv6 sockets
+ * Supports IPv4, IPv6 and unix domain sockets
+ *
+ * \param [out]  c         Client information reference to where the client info will be stored
+ * \param [in]   sock      Listening socket to accept on
+ * \param [in]   family    Address family of the listening socket
  *
- * \param [out]  c       Client information reference to where the client info will be stored
- * \param [in]   isIPv4  True to indicate if IPv4, false if IPv6
+ * \return true if a connection was accepted, false if none is pending
+ *
+ * \throws (const char *) on error.
  */
-void BMPListener::accept_connection(ClientInfo &c, bool isIPv4) {
+bool BMPListener::accept_connection(ClientInfo &c, int sock, int family) {
     socklen_t c_addr_len = sizeof(c.c_addr);         // the client info length
     socklen_t s_addr_len = sizeof(c.s_addr);         // the client info length
+    bool isIPv4 = family == AF_INET;
     c.initRec=false;				     // To indicate INIT message not received
-    int sock = isIPv4 ? this->sock : this->sockv6;
+    c.isUnix = family == AF_UNIX;
+    c.numa_node = -1;                                // Placed when the session is started
 
     sockaddr_in *v4_addr = (sockaddr_in *) &c.c_addr;
     sockaddr_in6 *v6_addr = (sockaddr_in6 *) &c.c_addr;
 
-    bzero(c.c_ip, sizeof(c.s_ip));
+    bzero(c.s_ip, sizeof(c.s_ip));
     bzero(c.c_ip, sizeof(c.c_ip));
 
-    // Accept the pending client request, or block till one exists
+    // Accept the pending client request
     if ((c.c_sock = accept(sock, (struct sockaddr *) &c.c_addr, &c_addr_len)) < 0) {
-        string error = "Server accept connection: ";
-        if (errno != EINTR)
-            error += strerror(errno);
-        else
-            error += "Exiting normally per user request to stop server";
+        if (errno == EAGAIN or errno == EWOULDBLOCK or errno == EINTR or errno == ECONNABORTED)
+            return false;
+
+        LOG_ERR("sock=%d: Server accept connection: %s", sock, strerror(errno));
+        throw "ERROR: Server accept connection failed";
+    }
 
-        throw error.c_str();
+    /*
+     * A local router has no address, it's shown as loopback and identified by the
+     *   socket path (see hashRouter) until the INIT message is received
+     */
+    if (c.isUnix) {
+        snprintf(c.c_ip, sizeof(c.c_ip), "127.0.0.1");
+        snprintf(c.c_port, sizeof(c.c_port), "0");
+        snprintf(c.s_ip, sizeof(c.s_ip), "127.0.0.1");
+        snprintf(c.s_port, sizeof(c.s_port), "0");
+
+        bzero(&c.s_addr, sizeof(c.s_addr));
+        if (getsockname(c.c_sock, (struct sockaddr *) &c.s_addr, &s_addr_len))
+            LOG_ERR("sock=%d: Unable to get the unix socket path", c.c_sock);
+
+        LOG_INFO("sock=%d: Accepted connection on unix socket %s", c.c_sock,
+                 ((sockaddr_un *) &c.s_addr)->sun_path);
+
+        hashRouter(c);
+
+        return true;
     }
 
     // Update returned class to have address and port of client in text form.
@@ -281,11 +473,15 @@ void BMPListener::accept_connection(ClientInfo &c, bool isIPv4) {
     }
     
     hashRouter(c);
+
+    return true;
 }
 
 /**
  * Generate BMP router HASH
  *
+ * \details Routers connected over a unix domain socket are hashed by the socket path.
+ *
  * \param [in,out] client   Reference to client info used to generate the hash.
  *
  * \return client.hash_id will be updated with the generated hash
@@ -294,8 +490,12 @@ void BMPListener::hashRouter(ClientInfo &client) {
     string c_hash_str;
     MsgBusInterface::hash_toStr(cfg->c_hash_id, c_hash_str);
 
+    const char *hash_val = client.c_ip;
+    if (client.isUnix)
+        hash_val = ((sockaddr_un *) &client.s_addr)->sun_path;
+
     MD5 hash;
-    hash.update((unsigned char *)client.c_ip, strlen(client.c_ip));
+    hash.update((unsigned char *)hash_val, strlen(hash_val));
     hash.update((unsigned char *)c_hash_str.c_str(), c_hash_str.length());
     hash.finalize();
 
@@ -13,10 +13,19 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <sys/un.h>
 #include <ctime>
+#include <memory>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "Logger.h"
 #include "Config.h"
+#include "RingBuffer.h"
 
 using namespace std;
 
@@ -27,8 +36,6 @@ using namespace std;
  * \details Maintains received connections and data from those connections.
  */
 class BMPListener {
-    int          sock;                           ///< Listening socket (ipv4)
-    int          sockv6;                         ///< IPv6 listening socket
     sockaddr_in  svr_addr;                       ///< Server v4 address
     sockaddr_in6 svr_addrv6;                     ///< Server v6 address
 
@@ -43,7 +50,9 @@ public:
         sockaddr_storage c_addr;            ///< client address info
         sockaddr_storage s_addr;            ///< Server/collector address info
         int         c_sock;                 ///< Active client socket connection
-        int         pipe_sock;              ///< Piped socket for client stream (buffered) - zero if not buffered
+        bool        isUnix;                 ///< True if connected over a unix domain socket, s_addr has the path
+        std::shared_ptr<RingBuffer> ring;   ///< Buffered client stream shared with the parser - NULL if not buffered
+        int         numa_node;              ///< NUMA node of the router's buffer and threads, -1 for any
         char        c_port[6];              ///< Client source port
         char        c_ip[46];               ///< Client IP source address
         char        s_port[6];              ///< Server/collector port
@@ -65,9 +74,9 @@ public:
     /**
      * Wait and Accept new/pending connections
      *
-     * Will accept both IPv4 and IPv6 (if configured), but only one will be accepted
-     * per poll/wait period.  Must run this method in a loop fashion to accept all
-     * pending connections.
+     * Connections are accepted by the listener shard threads, IPv4, IPv6 and unix
+     * domain sockets (if configured).  Only one accepted connection is returned per call.  Must
+     * run this method in a loop fashion to get all pending connections.
      *
      * \param [out] c           Ref to client info - this will be updated based on accepted connection
      * \param [in]  timeout     Timeout in ms to wait for
@@ -79,6 +88,8 @@ public:
 /**
      * Generate BMP router HASH
      *
+     * \details Routers connected over a unix domain socket are hashed by the socket path.
+     *
      * \param [in,out] client   Refernce to client info used to generate the hash.
      *
      * \return client.hash_id will be updated with the generated hash
@@ -98,23 +109,88 @@ private:
     bool        debug;                      ///< debug flag to indicate debugging
 
     /**
-     * Opens server (v4 or 6) listening socket(s)
+     * Listening socket and the thread that accepts on it
+     */
+    struct ListenShard {
+        int         sock;                   ///< Listening socket
+        int         family;                 ///< AF_INET, AF_INET6 or AF_UNIX
+        std::thread *thr;                   ///< Thread running accept_loop()
+    };
+
+    std::vector<ListenShard *> shards;      ///< Listening sockets, cfg->listen_shards per IP address family and one per unix path
+    std::atomic<bool> running;              ///< False once the listener is being destroyed
+
+    std::mutex  accept_lock;                ///< Protects accepted
+    std::condition_variable accept_cond;    ///< Signaled when a connection is added to accepted
+    std::deque<ClientInfo> accepted;        ///< Accepted connections not yet returned by wait_and_accept_connection()
+
+    /**
+     * Opens server (v4 or 6 and unix) listening socket(s)
      *
      * \param [in] ipv4     True to open v4 socket
      * \param [in] ipv6     True to open v6 socket
      */
     void open_socket(bool ipv4, bool ipv6);
 
+    /**
+     * Opens one non-blocking unix domain listening socket
+     *
+     * \details A stale socket file left at the path is removed.
+     *
+     * \param [in] path     Path to bind to
+     *
+     * \return listening socket
+     *
+     * \throws (const char *) on error.
+     */
+    int open_unix_socket(const std::string &path);
+
+    /**
+     * Make a listening socket non-blocking and listen on it
+     *
+     * \param [in] sock     Bound socket, closed on error
+     *
+     * \throws (const char *) on error.
+     */
+    void start_listen(int sock);
+
+    /**
+     * Opens one non-blocking listening socket
+     *
+     * \param [in] isIPv4   True to open v4 socket, false for v6
+     *
+     * \return listening socket
+     *
+     * \throws (const char *) on error.
+     */
+    int open_listen_socket(bool isIPv4);
+
+    /**
+     * Listener shard thread loop
+     *
+     * \details Waits for the listening socket to be readable and accepts all pending
+     *          connections, which are queued for wait_and_accept_connection().  Stops
+     *          accepting while the queue has listen_backlog connections, leaving the
+     *          rest in the kernel backlog.
+     *
+     * \param [in] shard    Shard that the thread runs
+     */
+    void accept_loop(ListenShard *shard);
+
     /**
      * Accept new/pending connections
      *
-     * Will accept new connections and wait if one is not currently ready.
-     * Supports IPv4 and IPv6 sockets
+     * Supports IPv4, IPv6 and unix domain sockets
+     *
+     * \param [out]  c         Client information reference to where the client info will be stored
+     * \param [in]   sock      Listening socket to accept on
+     * \param [in]   family    Address family of the listening socket
+     *
+     * \return true if a connection was accepted, false if none is pending
      *
-     * \param [out]  c  Client information reference to where the client info will be stored
-     * \param [in]   isIPv4  True to indicate if IPv4, false if IPv6
+     * \throws (const char *) on error.
      */
-    void accept_connection(ClientInfo &c, bool isIPv4);
+    bool accept_connection(ClientInfo &c, int sock, int family);
 
 };
 
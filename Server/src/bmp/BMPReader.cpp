@@ -24,6 +24,12 @@
 #include "parseBMP.h"
 #include "parseBGP.h"
 #include "MsgBusInterface.hpp"
+#include "MsgBusLocked.hpp"
+#include "AdmissionControl.h"
+#include "AdjRib.h"
+#include "AttrCache.h"
+#include "NlriBatch.h"
+#include "RibCheckpoint.h"
 #include "Logger.h"
 #include "md5.h"
 
@@ -48,19 +54,74 @@ BMPReader::BMPReader(Logger *logPtr, Config *config) {
     
     hasPrevRIBdumpTime = false;
     maxRIBdumpRate = 0;
+
+    bmp_parser = NULL;
+
+    parse_pool = NULL;
+    locked_mbus = NULL;
+    raw_enabled = true;
+    numa_node = -1;
+    bzero(router_addr, sizeof(router_addr));
+
+    pending = 0;
+    task_error = NULL;
 }
 
 /**
  * Destructor
  */
 BMPReader::~BMPReader() {
+    // Queued messages reference the peer states
+    waitPending(0);
+
+    // The last task of a lane ends before the parse thread is done with the lane
+    if (parse_pool != NULL) {
+        for (peer_map_iter it = peer_map.begin(); it != peer_map.end(); ++it)
+            it->second->lane.waitIdle();
+    }
+
+    for (peer_map_iter it = peer_map.begin(); it != peer_map.end(); ++it) {
+        if (it->second->bgp_parser != NULL)
+            delete it->second->bgp_parser;
+
+        if (it->second->locked_mbus != NULL)
+            delete it->second->locked_mbus;
+
+        if (it->second->info.rib != NULL)
+            delete it->second->info.rib;
+
+        if (it->second->info.attr_cache != NULL)
+            delete it->second->info.attr_cache;
+
+        delete it->second->info.nlri_batch;
+
+        delete it->second;
+    }
+
+    peer_map.clear();
+
+    if (bmp_parser != NULL)
+        delete bmp_parser;
 
+    if (locked_mbus != NULL)
+        delete locked_mbus;
+}
+
+/**
+ * Parse the peer messages in the shared parse pool
+ *
+ * \param [in]  pool        Parse pool, NULL to parse in the reader thread
+ */
+void BMPReader::setParsePool(ParsePool *pool) {
+    parse_pool = pool;
 }
 
 
 /**
  * Read messages from BMP stream in a loop
  *
+ * \details The message bus backlog is sampled by the admission control while the loop runs.
+ *
  * \param [in]  run         Reference to bool to indicate if loop should continue or not
  * \param [in]  client      Client information pointer
  * \param [in]  mbus_ptr     The database pointer referencer - DB should be already initialized
@@ -70,6 +131,8 @@ BMPReader::~BMPReader() {
  * \throw (char const *str) message indicate error
  */
 void BMPReader::readerThreadLoop(bool &run, BMPListener::ClientInfo *client, MsgBusInterface *mbus_ptr) {
+    AdmissionControl::Sink sink(mbus_ptr);
+
     while (run) {
 
         try {
@@ -81,6 +144,13 @@ void BMPReader::readerThreadLoop(bool &run, BMPListener::ClientInfo *client, Msg
             break;
         }
     }
+
+    // Queued messages still use the message bus, which is freed once the loop returns
+    waitPending(0);
+
+    // Let the buffering side know that nothing more will be read
+    if (client->ring)
+        client->ring->closeRead();
 }
 
 /**
@@ -88,6 +158,10 @@ void BMPReader::readerThreadLoop(bool &run, BMPListener::ClientInfo *client, Msg
  *
  * BMP routers send BMP/BGP messages, this method reads and parses those.
  *
+ * \details The BMP message is framed and the router level messages are handled here.
+ *          Peer messages are parsed by processPeerMsg(), either inline or queued in
+ *          order to the lane of the peer in the parse pool.
+ *
  * \param [in]  client      Client information pointer
  * \param [in]  mbus_ptr     The database pointer referencer - DB should be already initialized
  *
@@ -97,23 +171,35 @@ void BMPReader::readerThreadLoop(bool &run, BMPListener::ClientInfo *client, Msg
  */
 bool BMPReader::ReadIncomingMsg(BMPListener::ClientInfo *client, MsgBusInterface *mbus_ptr) {
     bool rval = true;
+    bool peer_msg = false;                          // True if the message is parsed by processPeerMsg()
     string peer_info_key;
+    PeerState *peer = NULL;                         // State of the peer the message is for
 
     parseBGP *pBGP;                                 // Pointer to BGP parser
 
-    int read_fd = client->pipe_sock > 0 ? client->pipe_sock : client->c_sock;
+    int read_fd = client->c_sock;
 
-    // Data storage structures
-    MsgBusInterface::obj_bgp_peer p_entry;
+    // Peers parsed in the pool call the message bus from different threads
+    mbus_ptr = getMsgBus(mbus_ptr);
 
-    // Initialize the parser for BMP messages
-    parseBMP *pBMP = new parseBMP(logger, &p_entry);    // handler for BMP messages
+    // Initialize the parser for BMP messages, the parser is reused for every message of the connection
+    if (bmp_parser == NULL) {
+        bmp_parser = new parseBMP(logger, &p_entry);
+        bmp_parser->setRingBuffer(client->ring.get());
 
-    if (cfg->debug_bmp) {
-        enableDebug();
-        pBMP->enableDebug();
+        if (cfg->debug_bmp) {
+            enableDebug();
+            bmp_parser->enableDebug();
+        }
+
+        snprintf(router_addr, sizeof(router_addr), "%s", client->c_ip);
+        numa_node = client->numa_node;
+        raw_enabled = mbus_ptr->isRawEnabled();
     }
 
+    parseBMP *pBMP = bmp_parser;                    // handler for BMP messages
+    pBMP->reset();
+
     char bmp_type = 0;
 
     MsgBusInterface::obj_router r_object;
@@ -124,9 +210,23 @@ bool BMPReader::ReadIncomingMsg(BMPListener::ClientInfo *client, MsgBusInterface
     // Setup the router record table object
     memcpy(r_object.ip_addr, client->c_ip, sizeof(client->c_ip));
 
+    MsgBusInterface::obj_peer_down_event down_event = {};
+    MsgBusInterface::obj_stats_report stats = {};
+    bool stats_valid = false;
+
     try {
+        // A queued message failed to parse, handle it as an error of the connection
+        {
+            std::lock_guard<std::mutex> guard(pending_lock);
+            if (task_error != NULL)
+                throw task_error;
+        }
+
         bmp_type = pBMP->handleMessage(read_fd);
 
+        if (client->ring)
+            client->ring->countMessage();
+
         /*
          * Now that we have parsed the BMP message...
          *  add record to the database
@@ -142,12 +242,7 @@ bool BMPReader::ReadIncomingMsg(BMPListener::ClientInfo *client, MsgBusInterface
             peer_info_key =  p_entry.peer_addr;
             peer_info_key += p_entry.peer_rd;
 
-            if (bmp_type != parseBMP::TYPE_PEER_UP)
-                mbus_ptr->update_Peer(p_entry, NULL, NULL, mbus_ptr->PEER_ACTION_FIRST);     // add the peer entry
-
-            if (not peer_info_map[peer_info_key].using_2_octet_asn and p_entry.isTwoOctet) {
-                peer_info_map[peer_info_key].using_2_octet_asn = true;
-            }
+            peer = getPeer(peer_info_key, mbus_ptr);
         }
 
         /*
@@ -156,55 +251,9 @@ bool BMPReader::ReadIncomingMsg(BMPListener::ClientInfo *client, MsgBusInterface
          */
         switch (bmp_type) {
             case parseBMP::TYPE_PEER_DOWN : { // Peer down type
-
-                MsgBusInterface::obj_peer_down_event down_event = {};
-
                 if (pBMP->parsePeerDownEventHdr(read_fd,down_event)) {
                     pBMP->bufferBMPMessage(read_fd);
-
-
-                    // Prepare the BGP parser
-                    pBGP = new parseBGP(logger, mbus_ptr, &p_entry, (char *)r_object.ip_addr,
-                                        &peer_info_map[peer_info_key]);
-
-                    if (cfg->debug_bgp)
-                       pBGP->enableDebug();
-
-                    // Check if the reason indicates we have a BGP message that follows
-                    switch (down_event.bmp_reason) {
-                        case 1 : { // Local system close with BGP notify
-                            snprintf(down_event.error_text, sizeof(down_event.error_text),
-                                    "Local close by (%s) for peer (%s) : ", r_object.ip_addr,
-                                    p_entry.peer_addr);
-                            pBGP->handleDownEvent(pBMP->bmp_data, pBMP->bmp_data_len, down_event);
-                            break;
-                        }
-                        case 2 : // Local system close, no bgp notify
-                        {
-                            // Read two byte code corresponding to the FSM event
-                            uint16_t fsm_event = 0 ;
-                            memcpy(&fsm_event, pBMP->bmp_data, 2);
-                            bgp::SWAP_BYTES(&fsm_event);
-
-                            snprintf(down_event.error_text, sizeof(down_event.error_text),
-                                    "Local (%s) closed peer (%s) session: fsm_event=%d, No BGP notify message.",
-                                    r_object.ip_addr,p_entry.peer_addr, fsm_event);
-                            break;
-                        }
-                        case 3 : { // remote system close with bgp notify
-                            snprintf(down_event.error_text, sizeof(down_event.error_text),
-                                    "Remote peer (%s) closed local (%s) session: ", r_object.ip_addr,
-                                    p_entry.peer_addr);
-
-                            pBGP->handleDownEvent(pBMP->bmp_data, pBMP->bmp_data_len, down_event);
-                            break;
-                        }
-                    }
-
-                    delete pBGP;            // Free the bgp parser after each use.
-
-                    // Add event to the database
-                    mbus_ptr->update_Peer(p_entry, NULL, &down_event, mbus_ptr->PEER_ACTION_DOWN);
+                    peer_msg = true;
 
                 } else {
                     LOG_ERR("Error with client socket %d", read_fd);
@@ -224,27 +273,39 @@ bool BMPReader::ReadIncomingMsg(BMPListener::ClientInfo *client, MsgBusInterface
 
                     pBMP->bufferBMPMessage(read_fd);
 
-                    // Prepare the BGP parser
-                    pBGP = new parseBGP(logger, mbus_ptr, &p_entry, (char *)r_object.ip_addr,
-                                        &peer_info_map[peer_info_key]);
+                    // The OPEN messages set the persistent peer info, parse them once the peer's queued messages are done
+                    peer->lane.waitIdle();
+
+                    peer->p_entry = p_entry;
+
+                    if (not peer->info.using_2_octet_asn and p_entry.isTwoOctet)
+                        peer->info.using_2_octet_asn = true;
 
-                    if (cfg->debug_bgp)
-                       pBGP->enableDebug();
+                    // New session, the peer sends its RIB again
+                    peer->info.endOfRIB = false;
+                    if (peer->info.rib != NULL)
+                        peer->info.rib->newSession();
+
+                    // Send the base attributes again for the new session
+                    if (peer->info.attr_cache != NULL)
+                        peer->info.attr_cache->clear();
+                    setPeerSynced(peer, false);
+
+                    // Prepare the BGP parser
+                    pBGP = getBGPParser(peer);
 
                     // Parse the BGP sent/received open messages
                     int read = pBGP->handleUpEvent(pBMP->bmp_data, pBMP->bmp_data_len, &up_event);
 
-                                        // Free the bgp parser
-                    delete pBGP;
-
                     // Read info TLV data
                     if (((int)pBMP->bmp_data_len - read) > 0) {
                         SELF_DEBUG("%s: PEER UP has info data, parsing %d bytes", p_entry.peer_addr, pBMP->bmp_data_len - read);
                         pBMP->parsePeerUpInfo(pBMP->bmp_data + read, (int)pBMP->bmp_data_len - read);
+                        peer->p_entry = p_entry;
                     }
 
                     // Add the up event to the DB
-                    mbus_ptr->update_Peer(p_entry, &up_event, NULL, mbus_ptr->PEER_ACTION_UP);
+                    peer->mbus->update_Peer(p_entry, &up_event, NULL, mbus_ptr->PEER_ACTION_UP);
 
                 } else {
                     LOG_NOTICE("%s: PEER UP Received but failed to parse the BMP header.", client->c_ip);
@@ -254,53 +315,26 @@ bool BMPReader::ReadIncomingMsg(BMPListener::ClientInfo *client, MsgBusInterface
 
             case parseBMP::TYPE_ROUTE_MON : { // Route monitoring type
                 pBMP->bufferBMPMessage(read_fd);
-
-                /*
-                 * Read and parse the the BGP message from the client.
-                 *     parseBGP will update mysql directly
-                 */
-                pBGP = new parseBGP(logger, mbus_ptr, &p_entry, (char *)r_object.ip_addr,
-                                    &peer_info_map[peer_info_key]);
-
-                if (cfg->debug_bgp)
-                    pBGP->enableDebug();
-
-                pBGP->handleUpdate(pBMP->bmp_data, pBMP->bmp_data_len);
-   		
-		string str(reinterpret_cast<char*>(client->hash_id), 16);  //storing the client hash in a string 
-		if(client->initRec && cfg->router_baseline_time.find(str) == cfg->router_baseline_time.end())	
-                //check if client has received init message and Baseline time is not already calculated
-		{
-		    peer_info_map_iter it = peer_info_map.begin();
-		    while (it != peer_info_map.end() && it->second.endOfRIB)
-		        ++it;
-
-		    if (it == peer_info_map.end() || checkRIBdumpRate(p_entry.timestamp_secs,mbus_ptr->ribSeq)) {  //End-Of-RIBs are received for all peers.
-		        timeval now;
-		        gettimeofday(&now, NULL);
-		        cfg->router_baseline_time[str] = 1.2 * (now.tv_sec - client->startTime.tv_sec);  //20% buffer for baseline time 
-		    }		
-		}
-                delete pBGP;
-
+                peer_msg = true;
                 break;
             }
 
             case parseBMP::TYPE_STATS_REPORT : { // Stats Report
-                MsgBusInterface::obj_stats_report stats = {};
-                if (! pBMP->handleStatsReport(read_fd, stats))
-                    // Add to mysql
-                    mbus_ptr->add_StatReport(p_entry, stats);
-
+                stats_valid = not pBMP->handleStatsReport(read_fd, stats);
+                peer_msg = true;
                 break;
             }
 
             case parseBMP::TYPE_INIT_MSG : { // Initiation Message
+                // The router hash can change, finish the messages of the previous one
+                waitPending(0);
+
                 client->initRec = true; 		//indicating that init message is received for the router/client.
 		LOG_INFO("%s: Init message received with length of %u", client->c_ip, pBMP->getBMPLength());
                 pBMP->handleInitMsg(read_fd, r_object);
 		
-                if(cfg->pat_enabled && r_object.hash_type)
+                // Local routers share the socket path, the INIT message tells them apart
+                if((cfg->pat_enabled || client->isUnix) && r_object.hash_type)
 			hashRouter(client, r_object);
                 LOG_INFO("Router ID hashed with hash_type: %d", r_object.hash_type);
 		// Update the router entry with the details
@@ -312,34 +346,371 @@ bool BMPReader::ReadIncomingMsg(BMPListener::ClientInfo *client, MsgBusInterface
             case parseBMP::TYPE_TERM_MSG : { // Termination Message
                 LOG_INFO("%s: Term message received with length of %u", client->c_ip, pBMP->getBMPLength());
 
+                waitPending(0);
 
                 pBMP->handleTermMsg(read_fd, r_object);
 
                 LOG_INFO("Proceeding to disconnect router");
                 mbus_ptr->update_Router(r_object, mbus_ptr->ROUTER_ACTION_TERM);
-                close(client->c_sock);
+                closeClientSocket(client);
 
                 rval = false;                           // Indicate connection is closed
                 break;
             }
 
         }
+
+        if (peer_msg) {
+            PeerMsg inline_msg;
+            PeerMsg *msg = (parse_pool != NULL) ? new PeerMsg : &inline_msg;
+
+            msg->bmp_type = bmp_type;
+            msg->p_entry = p_entry;
+            memcpy(msg->router_hash_id, router_hash_id, sizeof(msg->router_hash_id));
+            msg->down_event = down_event;
+            msg->stats = stats;
+            msg->stats_valid = stats_valid;
+
+            if (parse_pool != NULL) {
+                // The BMP parser reuses its data buffer for the next message
+                msg->data_copy.assign(pBMP->bmp_data, pBMP->bmp_data + pBMP->bmp_data_len);
+                msg->data = msg->data_copy.data();
+                msg->data_len = msg->data_copy.size();
+
+                /*
+                 * A reference to the raw packet keeps the parser's packet buffer until the
+                 * message is parsed, so it has to allocate a new one.  Only the frame is
+                 * copied when the raw packet isn't sent.
+                 */
+                const std::shared_ptr<MsgBusInterface::obj_bmp_raw> &raw = pBMP->getRawPacket();
+                if (raw_enabled) {
+                    msg->raw = raw;
+                } else {
+                    msg->raw = std::make_shared<MsgBusInterface::obj_bmp_raw>(raw->data_len);
+                    memcpy(msg->raw->data(), raw->data(), raw->data_len);
+                    msg->raw->data_len = raw->data_len;
+                }
+
+                queuePeerMsg(peer, msg);
+
+            } else {
+                msg->raw = pBMP->getRawPacket();
+                msg->data = pBMP->bmp_data;
+                msg->data_len = pBMP->bmp_data_len;
+
+                processPeerMsg(peer, msg);
+            }
+        }
+
+        if (bmp_type == parseBMP::TYPE_ROUTE_MON) {
+		string str(reinterpret_cast<char*>(client->hash_id), 16);  //storing the client hash in a string 
+		std::unique_lock<std::mutex> baseline_guard(cfg->router_baseline_lock);
+		if(client->initRec && cfg->router_baseline_time.find(str) == cfg->router_baseline_time.end())	
+                //check if client has received init message and Baseline time is not already calculated
+		{
+		    baseline_guard.unlock();
+
+		    peer_map_iter it = peer_map.begin();
+		    while (it != peer_map.end() && it->second->info.endOfRIB)
+		        ++it;
+
+		    uint64_t rib_seq = (locked_mbus != NULL) ? locked_mbus->getRibSeq() : mbus_ptr->ribSeq;
+
+		    if (it == peer_map.end() || checkRIBdumpRate(p_entry.timestamp_secs, rib_seq)) {  //End-Of-RIBs are received for all peers.
+		        timeval now;
+		        gettimeofday(&now, NULL);
+		        baseline_guard.lock();
+		        cfg->router_baseline_time[str] = 1.2 * (now.tv_sec - client->startTime.tv_sec);  //20% buffer for baseline time 
+		        cfg->baseline_updates++;
+		    }		
+		}
+        }
+
     } catch (char const *str) {
         // Mark the router as disconnected and update the error to be a local disconnect (no term message received)
         LOG_INFO("%s: Caught: %s", client->c_ip, str);
+        waitPending(0);
         disconnect(client, mbus_ptr, parseBMP::TERM_REASON_OPENBMP_CONN_ERR, str);
 
-        delete pBMP;                    // Make sure to free the resource
         throw str;
     }
     
+    // Send BMP RAW packet data, peer messages send it once parsed
+    if (not peer_msg)
+        mbus_ptr->send_bmp_raw(router_hash_id, p_entry, pBMP->getRawPacket());
+
+    return rval;
+}
+
+/**
+ * Parse a peer message and send it to the message bus of the peer
+ *
+ * \param [in]  peer         State of the peer of the message
+ * \param [in]  msg          Framed message
+ *
+ * \throw (char const *str) message indicate error
+ */
+void BMPReader::processPeerMsg(PeerState *peer, PeerMsg *msg) {
+    parseBGP *pBGP;                                 // Pointer to BGP parser
+    MsgBusInterface *mbus_ptr = peer->mbus;
+    MsgBusInterface::obj_bgp_peer &p_entry = peer->p_entry;
+
+    p_entry = msg->p_entry;
+
+    mbus_ptr->update_Peer(p_entry, NULL, NULL, mbus_ptr->PEER_ACTION_FIRST);     // add the peer entry
+
+    if (not peer->info.using_2_octet_asn and p_entry.isTwoOctet) {
+        peer->info.using_2_octet_asn = true;
+    }
+
+    switch (msg->bmp_type) {
+        case parseBMP::TYPE_PEER_DOWN : { // Peer down type
+            MsgBusInterface::obj_peer_down_event &down_event = msg->down_event;
+
+            // Prepare the BGP parser
+            pBGP = getBGPParser(peer);
+
+            // Check if the reason indicates we have a BGP message that follows
+            switch (down_event.bmp_reason) {
+                case 1 : { // Local system close with BGP notify
+                    snprintf(down_event.error_text, sizeof(down_event.error_text),
+                            "Local close by (%s) for peer (%s) : ", router_addr,
+                            p_entry.peer_addr);
+                    pBGP->handleDownEvent(msg->data, msg->data_len, down_event);
+                    break;
+                }
+                case 2 : // Local system close, no bgp notify
+                {
+                    // Read two byte code corresponding to the FSM event
+                    uint16_t fsm_event = 0 ;
+                    memcpy(&fsm_event, msg->data, 2);
+                    bgp::SWAP_BYTES(&fsm_event);
+
+                    snprintf(down_event.error_text, sizeof(down_event.error_text),
+                            "Local (%s) closed peer (%s) session: fsm_event=%d, No BGP notify message.",
+                            router_addr,p_entry.peer_addr, fsm_event);
+                    break;
+                }
+                case 3 : { // remote system close with bgp notify
+                    snprintf(down_event.error_text, sizeof(down_event.error_text),
+                            "Remote peer (%s) closed local (%s) session: ", router_addr,
+                            p_entry.peer_addr);
+
+                    pBGP->handleDownEvent(msg->data, msg->data_len, down_event);
+                    break;
+                }
+            }
+
+            // The prefixes of the peer are gone with it
+            pBGP->flushPrefixes();
+
+            // Add event to the database
+            mbus_ptr->update_Peer(p_entry, NULL, &down_event, mbus_ptr->PEER_ACTION_DOWN);
+            break;
+        }
+
+        case parseBMP::TYPE_ROUTE_MON : { // Route monitoring type
+            /*
+             * Parse the the BGP message from the client.
+             *     parseBGP will update mysql directly
+             */
+            pBGP = getBGPParser(peer);
+
+            pBGP->handleUpdate(msg->data, msg->data_len);
+
+            if (not peer->synced and peer->info.endOfRIB)
+                setPeerSynced(peer, true);
+            break;
+        }
+
+        case parseBMP::TYPE_STATS_REPORT : { // Stats Report
+            if (msg->stats_valid)
+                // Add to mysql
+                mbus_ptr->add_StatReport(p_entry, msg->stats);
+
+            break;
+        }
+    }
+
     // Send BMP RAW packet data
-    mbus_ptr->send_bmp_raw(router_hash_id, p_entry, pBMP->bmp_packet, pBMP->bmp_packet_len);
+    mbus_ptr->send_bmp_raw(msg->router_hash_id, p_entry, msg->raw);
+}
 
-    // Free the bmp parser
-    delete pBMP;
+/**
+ * Queue a peer message to the parse pool
+ *
+ * \details Blocks while the router has PARSE_ROUTER_MAX_PENDING messages queued.
+ *          The message is freed once parsed.
+ *
+ * \param [in]  peer         State of the peer of the message
+ * \param [in]  msg          Framed message, allocated with new
+ */
+void BMPReader::queuePeerMsg(PeerState *peer, PeerMsg *msg) {
+    // Push back on the router instead of queueing without bound
+    waitPending(PARSE_ROUTER_MAX_PENDING - 1);
 
-    return rval;
+    {
+        std::lock_guard<std::mutex> guard(pending_lock);
+        ++pending;
+    }
+
+    parse_pool->submit(&peer->lane, [this, peer, msg] {
+        char const *error = NULL;
+
+        {
+            std::lock_guard<std::mutex> guard(pending_lock);
+            error = task_error;
+        }
+
+        // Once a message failed the connection is dropped, skip the remaining ones
+        if (error == NULL) {
+            try {
+                processPeerMsg(peer, msg);
+
+            } catch (char const *str) {
+                error = str;
+
+            } catch (...) {
+                error = "BMPReader: Unexpected error parsing a peer message";
+            }
+        }
+
+        delete msg;
+
+        std::lock_guard<std::mutex> guard(pending_lock);
+        if (task_error == NULL)
+            task_error = error;
+
+        --pending;
+        pending_cond.notify_all();
+    });
+}
+
+/**
+ * Wait until at most limit messages of the router are queued in the parse pool
+ *
+ * \param [in]  limit        Number of queued messages to wait for, zero waits for all
+ */
+void BMPReader::waitPending(int limit) {
+    std::unique_lock<std::mutex> guard(pending_lock);
+    pending_cond.wait(guard, [this, limit] { return pending <= limit; });
+}
+
+/**
+ * Get the message bus to use for the connection
+ *
+ * \param [in]  mbus_ptr     Message bus of the connection
+ *
+ * \return mbus_ptr, or the serialized message bus when the parse pool is used
+ */
+MsgBusInterface *BMPReader::getMsgBus(MsgBusInterface *mbus_ptr) {
+    if (parse_pool == NULL or mbus_ptr == locked_mbus)
+        return mbus_ptr;
+
+    if (locked_mbus == NULL)
+        locked_mbus = new MsgBusLocked(mbus_ptr);
+
+    return locked_mbus;
+}
+
+/**
+ * Get the persistent state of a peer, created on first use
+ *
+ * \param [in]  key          Peer address and RD
+ * \param [in]  mbus_ptr     Message bus of the connection, from getMsgBus()
+ *
+ * \return pointer to the peer state
+ */
+BMPReader::PeerState *BMPReader::getPeer(const std::string &key, MsgBusInterface *mbus_ptr) {
+    peer_map_iter it = peer_map.find(key);
+
+    if (it != peer_map.end())
+        return it->second;
+
+    PeerState *peer = new PeerState();
+    peer->bgp_parser = NULL;
+    peer->synced = false;
+    peer->lane.setNode(numa_node);
+
+    // Each peer has its own user of the serialized message bus, so it can be given priority
+    if (locked_mbus != NULL) {
+        peer->locked_mbus = locked_mbus->share();
+        peer->mbus = peer->locked_mbus;
+
+    } else {
+        peer->locked_mbus = NULL;
+        peer->mbus = mbus_ptr;
+    }
+
+    peer->info.rib = NULL;
+    if (cfg->rib_enabled or not cfg->rib_checkpoint_dir.empty()) {
+        RibCheckpoint *checkpoint = NULL;
+
+        if (not cfg->rib_checkpoint_dir.empty()) {
+            try {
+                checkpoint = new RibCheckpoint(logger,
+                        RibCheckpoint::getPath(cfg->rib_checkpoint_dir, router_hash_id, key));
+
+            } catch (char const *str) {
+                LOG_WARN("%s: rtr=%s: RIB checkpoint disabled for the peer: %s", key.c_str(), router_addr, str);
+            }
+        }
+
+        peer->info.rib = new AdjRib(logger, checkpoint);
+    }
+
+    peer->info.attr_cache = NULL;
+    if (cfg->attr_cache_size > 0)
+        peer->info.attr_cache = new AttrCache(cfg->attr_cache_size);
+
+    peer->info.nlri_batch = new bgp_msg::NlriBatch();
+
+    peer_map[key] = peer;
+
+    return peer;
+}
+
+/**
+ * Mark the peer as syncing (initial RIB dump) or synced (live updates)
+ *
+ * \param [in]  peer         Peer state
+ * \param [in]  synced       True once the End-Of-RIB has been received
+ */
+void BMPReader::setPeerSynced(PeerState *peer, bool synced) {
+    if (peer->synced == synced)
+        return;
+
+    peer->synced = synced;
+    peer->lane.setPriority(synced);
+
+    if (peer->locked_mbus != NULL)
+        peer->locked_mbus->setPriority(synced);
+
+    SELF_DEBUG("%s: rtr=%s: Peer is %s", peer->p_entry.peer_addr, router_addr,
+               synced ? "synced, live updates get priority" : "syncing");
+}
+
+/**
+ * Get the BGP parser of a peer
+ *
+ * \details The parser is created on first use and reset for each message after that.
+ *
+ * \param [in]  peer         Peer state
+ *
+ * \return pointer to the BGP parser, ready to parse a message
+ */
+parseBGP *BMPReader::getBGPParser(PeerState *peer) {
+    if (peer->bgp_parser == NULL) {
+        peer->bgp_parser = new parseBGP(logger, peer->mbus, &peer->p_entry, router_addr, &peer->info);
+
+        if (cfg->debug_bgp)
+            peer->bgp_parser->enableDebug();
+
+    } else {
+        peer->bgp_parser->reset(&peer->info);
+    }
+
+    return peer->bgp_parser;
 }
 
 bool BMPReader::checkRIBdumpRate(uint32_t timeStamp, int ribSeq) {
@@ -392,10 +763,28 @@ void BMPReader::disconnect(BMPListener::ClientInfo *client, MsgBusInterface *mbu
     if (reason_text != NULL)
         snprintf(r_object.term_reason_text, sizeof(r_object.term_reason_text), "%s", reason_text);
 
-    mbus_ptr->update_Router(r_object, mbus_ptr->ROUTER_ACTION_TERM);
+    getMsgBus(mbus_ptr)->update_Router(r_object, mbus_ptr->ROUTER_ACTION_TERM);
 
-    close(client->c_sock);
-    client->c_sock = 0;
+    closeClientSocket(client);
+}
+
+/**
+ * Close the router socket
+ *
+ * \details When the stream is buffered, the socket is owned by the buffering side
+ *          (client thread or I/O thread) which closes it once the ring is closed.
+ *          Closing it here would let the descriptor be reused while it's still in use.
+ *
+ * \param [in]  client      Client information pointer
+ */
+void BMPReader::closeClientSocket(BMPListener::ClientInfo *client) {
+    if (client->ring) {
+        shutdown(client->c_sock, SHUT_RDWR);
+
+    } else {
+        close(client->c_sock);
+        client->c_sock = 0;
+    }
 }
 
 
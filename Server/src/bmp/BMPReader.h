@@ -16,9 +16,26 @@
 #include "MsgBusInterface.hpp"
 #include "Logger.h"
 #include "Config.h"
+#include "ParsePool.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
+
+#define PARSE_ROUTER_MAX_PENDING   1024     ///< Max messages of a router queued in the parse pool
+
+class parseBMP;
+class parseBGP;
+class MsgBusLocked;
+class AdjRib;
+class AttrCache;
+
+namespace bgp_msg {
+    class NlriBatch;
+}
 
 /**
  * \class   BMPReader
@@ -40,7 +57,10 @@ public:
         bool using_2_octet_asn;                                 ///< Indicates if peer is using two octet ASN format or not (true=2 octet, false=4 octet)
         AddPathDataContainer add_path_capability;               ///< Stores data about Add Path capability
         string peer_group;                                      ///< Peer group name of defined
-	bool endOfRIB;						///< Indicates if End-Of-RIB marker is received
+	std::atomic<bool> endOfRIB;				///< Indicates if End-Of-RIB marker is received
+        AdjRib *rib;                                            ///< Paths sent for the peer, NULL if disabled
+        AttrCache *attr_cache;                                  ///< Attribute sets sent for the peer, NULL if disabled
+        bgp_msg::NlriBatch *nlri_batch;                         ///< Decoded prefixes of the NLRI field being parsed
     };
 
 
@@ -101,6 +121,16 @@ public:
      */
     void disconnect(BMPListener::ClientInfo *client, MsgBusInterface *mbus_ptr, int reason_code, char const *reason_text);
 
+    /**
+     * Close the router socket
+     *
+     * \details When the stream is buffered, the socket is only shutdown since the
+     *          buffering side owns and closes it.
+     *
+     * \param [in]  client      Client information pointer
+     */
+    void closeClientSocket(BMPListener::ClientInfo *client);
+
 /**
      * Calling BMP router HASH
      *
@@ -111,6 +141,16 @@ public:
 
     void hashRouter(BMPListener::ClientInfo *client, MsgBusInterface::obj_router &r_entry);
 
+    /**
+     * Parse the peer messages in the shared parse pool
+     *
+     * \details Must be set before the first message is read.  The reader then only frames
+     *          the messages, the peers of the router are parsed in parallel.
+     *
+     * \param [in]  pool        Parse pool, NULL to parse in the reader thread
+     */
+    void setParsePool(ParsePool *pool);
+
     // Debug methods
     void enableDebug();
     void disableDebug();
@@ -129,11 +169,128 @@ private:
     int32_t 	prevRIBdumpTime;            ///< Stores the time the previous message was received
     int32_t 	maxRIBdumpRate;             ///< Stores the maximum RIB dump rate
     int32_t     belowThresholdInitTime;     ///< Stores the time when the RIB dump rate has dropped below threshold
+
+    MsgBusInterface::obj_bgp_peer p_entry;  ///< Peer entry of the current message, updated by the BMP parser
+    parseBMP    *bmp_parser;                ///< BMP parser of the connection, reset for each message
+
     /**
-     * Persistent peer info map, Key is the peer_hash_id.
+     * Per peer state, only used by one thread at a time
+     *
+     *   The reader creates it and hands the peer messages to it, either parsed inline or
+     *   in order on the lane of the peer in the parse pool.
+     *
+     *   A peer is syncing until its End-Of-RIB is parsed, then synced.  Synced peers only
+     *   send live updates, which get the priority lane in the parse pool and the message
+     *   bus so they are not queued behind the RIB dumps of the other peers.
+     */
+    struct PeerState {
+        peer_info   info;                               ///< Persistent peer information
+        MsgBusInterface::obj_bgp_peer p_entry;          ///< Peer entry of the message being parsed
+        parseBGP    *bgp_parser;                        ///< BGP parser of the peer, created on first use
+        ParsePool::Lane lane;                           ///< Parse pool lane of the peer
+        MsgBusInterface *mbus;                          ///< Message bus used for the peer
+        MsgBusLocked *locked_mbus;                      ///< Serialized message bus of the peer, NULL when parsed inline
+        bool        synced;                             ///< True once the initial RIB dump of the peer is done
+    };
+
+    /**
+     * Framed peer message, parsed by processPeerMsg()
+     */
+    struct PeerMsg {
+        char        bmp_type;                           ///< BMP message type
+        MsgBusInterface::obj_bgp_peer p_entry;          ///< Peer entry from the BMP per peer header
+        u_char      router_hash_id[16];                 ///< Router hash ID at the time of the message
+        u_char      *data;                              ///< BGP data of the message
+        size_t      data_len;                           ///< Length of the BGP data
+        std::vector<u_char> data_copy;                  ///< Copy of the BGP data when queued to the pool
+        std::shared_ptr<MsgBusInterface::obj_bmp_raw> raw;  ///< Raw BMP packet
+        MsgBusInterface::obj_peer_down_event down_event;    ///< Peer down event (TYPE_PEER_DOWN)
+        MsgBusInterface::obj_stats_report stats;            ///< Stats report (TYPE_STATS_REPORT)
+        bool        stats_valid;                        ///< True if the stats report was parsed
+    };
+
+    /**
+     * Persistent peer state map, Key is the peer address and RD.
+     */
+    std::map<std::string, PeerState *> peer_map;
+    typedef std::map<std::string, PeerState *>::iterator peer_map_iter;
+
+    ParsePool   *parse_pool;                ///< Parse pool, NULL to parse in the reader thread
+    MsgBusLocked *locked_mbus;              ///< Serialized message bus used with the parse pool
+    bool        raw_enabled;                ///< Message bus sends raw packets, queued messages reference the packet buffer
+    int         numa_node;                  ///< NUMA node of the router, the peer lanes prefer its parse threads
+    char        router_addr[46];            ///< Router IP address - used for logging by the parsers
+
+    std::mutex  pending_lock;               ///< Protects pending and task_error
+    std::condition_variable pending_cond;   ///< Signaled when a queued message has been parsed
+    int         pending;                    ///< Number of messages queued in the parse pool
+    char const  *task_error;                ///< Error thrown by a queued message, rethrown by the reader
+
+    /**
+     * Get the message bus to use for the connection
+     *
+     * \param [in]  mbus_ptr     Message bus of the connection
+     *
+     * \return mbus_ptr, or the serialized message bus when the parse pool is used
+     */
+    MsgBusInterface *getMsgBus(MsgBusInterface *mbus_ptr);
+
+    /**
+     * Get the persistent state of a peer, created on first use
+     *
+     * \param [in]  key          Peer address and RD
+     * \param [in]  mbus_ptr     Message bus of the connection, from getMsgBus()
+     *
+     * \return pointer to the peer state
+     */
+    PeerState *getPeer(const std::string &key, MsgBusInterface *mbus_ptr);
+
+    /**
+     * Mark the peer as syncing (initial RIB dump) or synced (live updates)
+     *
+     * \param [in]  peer         Peer state
+     * \param [in]  synced       True once the End-Of-RIB has been received
+     */
+    void setPeerSynced(PeerState *peer, bool synced);
+
+    /**
+     * Get the BGP parser of a peer
+     *
+     * \details The parser is created on first use and reset for each message after that.
+     *
+     * \param [in]  peer         Peer state
+     *
+     * \return pointer to the BGP parser, ready to parse a message
+     */
+    parseBGP *getBGPParser(PeerState *peer);
+
+    /**
+     * Parse a peer message and send it to the message bus of the peer
+     *
+     * \param [in]  peer         State of the peer of the message
+     * \param [in]  msg          Framed message
+     *
+     * \throw (char const *str) message indicate error
+     */
+    void processPeerMsg(PeerState *peer, PeerMsg *msg);
+
+    /**
+     * Queue a peer message to the parse pool
+     *
+     * \details Blocks while the router has PARSE_ROUTER_MAX_PENDING messages queued.
+     *          The message is freed once parsed.
+     *
+     * \param [in]  peer         State of the peer of the message
+     * \param [in]  msg          Framed message, allocated with new
+     */
+    void queuePeerMsg(PeerState *peer, PeerMsg *msg);
+
+    /**
+     * Wait until at most limit messages of the router are queued in the parse pool
+     *
+     * \param [in]  limit        Number of queued messages to wait for, zero waits for all
      */
-    std::map<std::string, peer_info> peer_info_map;
-    typedef std::map<std::string, peer_info>::iterator peer_info_map_iter;
+    void waitPending(int limit);
 
 };
 
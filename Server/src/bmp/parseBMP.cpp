@@ -37,12 +37,16 @@ parseBMP::parseBMP(Logger *logPtr, MsgBusInterface::obj_bgp_peer *peer_entry) {
     bmp_type = -1; // Initially set to error
     bmp_len = 0;
     logger = logPtr;
+    ring = NULL;
 
     bmp_data_len = 0;
     bzero(bmp_data, sizeof(bmp_data));
 
+    bmp_raw = std::make_shared<MsgBusInterface::obj_bmp_raw>(BMP_PACKET_BUF_SIZE + 1);
+    bmp_packet = bmp_raw->data();
     bmp_packet_len = 0;
-    bzero(bmp_packet, sizeof(bmp_packet));
+    packet_pos = 0;
+    framed = false;
 
     // Set the passed storage for the router entry items.
     p_entry = peer_entry;
@@ -53,19 +57,123 @@ parseBMP::~parseBMP() {
     // clean up
 }
 
+/**
+ * Reset the parser for the next message
+ *
+ * \details Only the per message header state and the peer entry are cleared, the
+ *          data and packet buffers are overwritten by the next message.
+ */
+void parseBMP::reset() {
+    bmp_type = -1;
+    bmp_len = 0;
+    bmp_data_len = 0;
+    bmp_packet_len = 0;
+    packet_pos = 0;
+    framed = false;
+
+    bzero(p_entry, sizeof(MsgBusInterface::obj_bgp_peer));
+}
+
+/**
+ * Set the ring buffer to read the BMP stream from
+ *
+ * \param [in] ringPtr     Ring buffer shared with the socket reader, NULL to read the socket
+ */
+void parseBMP::setRingBuffer(RingBuffer *ringPtr) {
+    ring = ringPtr;
+}
+
+/**
+ * Read from the client stream
+ *
+ * \details Reads from the ring buffer when set, otherwise from the socket.
+ *
+ * \param [in]  sockfd     Socket to read from when there is no ring buffer
+ * \param [out] buf        Buffer to read into
+ * \param [in]  len        Number of bytes to read
+ * \param [in]  flags      recv() flags, only MSG_WAITALL is supported
+ *
+ * \return number of bytes read, zero on end of stream and negative on error
+ */
+ssize_t parseBMP::readStream(int sockfd, void *buf, size_t len, int flags) {
+    if (ring != NULL)
+        return ring->read(buf, len, flags & MSG_WAITALL, false);
+    else
+        return recv(sockfd, buf, len, flags & MSG_WAITALL);
+}
+
+/**
+ * Get the raw BMP packet of the current message
+ *
+ * \return shared pointer to the raw packet
+ */
+const std::shared_ptr<MsgBusInterface::obj_bmp_raw> &parseBMP::getRawPacket() {
+    bmp_raw->data_len = bmp_packet_len;
+
+    return bmp_raw;
+}
+
 /**
  * Recv wrapper for recv() to enable packet buffering
+ *
+ * \details The BMP message is buffered in bmp_packet and all reads are served from it.
+ *          For BMPv3 the complete message is framed (read at once) based on the common
+ *          header length.  Older versions don't have a length, so data not yet buffered
+ *          is read from the stream and appended to the packet buffer.
  */
 ssize_t parseBMP::Recv(int sockfd, void *buf, size_t len, int flags) {
-    ssize_t read = recv(sockfd, buf, len, flags);
+    size_t avail = bmp_packet_len - packet_pos;
+
+    if (avail < len and not framed) {
+        size_t want = len - avail;
 
-    if (read > 0)
-        if ((bmp_packet_len + read) < BMP_PACKET_BUF_SIZE) {
-            memcpy(&bmp_packet[bmp_packet_len], buf, read);
+        if (bmp_packet_len + want > BMP_PACKET_BUF_SIZE)
+            want = BMP_PACKET_BUF_SIZE - bmp_packet_len;
+
+        ssize_t read = want > 0 ? readStream(sockfd, &bmp_packet[bmp_packet_len], want, flags) : 0;
+
+        if (read > 0) {
             bmp_packet_len += read;
+            avail += read;
+
+        } else if (avail == 0) {
+            return read;
         }
+    }
 
-    return read;
+    if (len > avail)
+        len = avail;
+
+    memcpy(buf, &bmp_packet[packet_pos], len);
+
+    if (not (flags & MSG_PEEK))
+        packet_pos += len;
+
+    return len;
+}
+
+/**
+ * Read the remaining BMP message into the packet buffer
+ *
+ * \details The message is read with a single read, the headers and data are then
+ *          parsed from the packet buffer instead of the socket.
+ *
+ * \param [in]  sock       Socket to read the message from
+ * \param [in]  len        Remaining length of the message
+ *
+ * \throws (const char *) on error.
+ */
+void parseBMP::readFrame(int sock, uint32_t len) {
+    if (bmp_packet_len + len > BMP_PACKET_BUF_SIZE)
+        throw "ERROR: BMP message is larger than the packet buffer";
+
+    if (len > 0 and readStream(sock, &bmp_packet[bmp_packet_len], len, MSG_WAITALL) != (ssize_t)len) {
+        LOG_ERR("sock=%d: Couldn't read all %u bytes of the BMP message", sock, len);
+        throw "ERROR: Cannot read the BMP message.";
+    }
+
+    bmp_packet_len += len;
+    framed = true;
 }
 
 /**
@@ -83,16 +191,34 @@ char parseBMP::handleMessage(int sock) {
     unsigned char ver;
     ssize_t bytes_read;
 
-    // Get the version in order to determine what we read next
-    //    As of Junos 10.4R6.5, it supports version 1
-    bytes_read = Recv(sock, &ver, 1, MSG_WAITALL);
+    bmp_packet_len = 0;
+    packet_pos = 0;
+    framed = false;
+
+    // The message bus still references the last packet until it's sent, use a new buffer
+    if (bmp_raw.use_count() > 1) {
+        bmp_raw = std::make_shared<MsgBusInterface::obj_bmp_raw>(BMP_PACKET_BUF_SIZE + 1);
+        bmp_packet = bmp_raw->data();
+    }
+
+    /*
+     * Read the version and the v3 common header at once. The older versions have a
+     * longer common header, so this never reads past the end of any message.
+     */
+    bytes_read = readStream(sock, bmp_packet, 1 + BMP_HDRv3_LEN, MSG_WAITALL);
 
     if (bytes_read < 0)
         throw "(1) Failed to read from socket.";
     else if (bytes_read == 0)
         throw "(2) Connection closed";
-    else if (bytes_read != 1)
-        throw "(3) Cannot read the BMP version byte from socket";
+    else if (bytes_read != 1 + BMP_HDRv3_LEN)
+        throw "(3) Cannot read the BMP common header from socket";
+
+    bmp_packet_len = bytes_read;
+
+    // Get the version in order to determine what we read next
+    //    As of Junos 10.4R6.5, it supports version 1
+    Recv(sock, &ver, 1, 0);
 
     // check the version
     if (ver == 3) { // draft-ietf-grow-bmp-04 - 07
@@ -304,6 +430,9 @@ void parseBMP::parseBMPv3(int sock) {
     if (c_hdr.len > BGP_MAX_MSG_SIZE)
         throw "ERROR: BMP length is larger than max possible BGP size";
 
+    // Read the rest of the message, everything that follows is parsed from memory
+    readFrame(sock, c_hdr.len);
+
     // Parse additional headers based on type
     bmp_type = c_hdr.type;
     bmp_len = c_hdr.len;
@@ -13,6 +13,7 @@
 
 #include "MsgBusInterface.hpp"
 #include "Logger.h"
+#include "RingBuffer.h"
 
 
 /*
@@ -31,7 +32,9 @@
  *
  * \brief   Parser for BMP messages
  * \details This class can be used as needed to parse BMP messages. This
- *          class will read directly from the socket to read the BMP message.
+ *          class will read directly from the socket, or the client ring buffer
+ *          when set, to read the BMP message.  BMPv3 messages are read at once
+ *          and then parsed from memory.
  */
 class parseBMP {
 public:
@@ -155,14 +158,14 @@ public:
     size_t      bmp_data_len;              ///< Length/size of data in the data buffer
 
     /**
-     * BMP packet buffer - This is a copy of the BMP packet.
+     * BMP packet buffer - The BMP packet as read from the router.
      *
-     * Only BMPv3 messages get stored in the packet buffer since it wasn't until
-     * BMPv3 that the length was specified.
+     * Points to the data of the raw packet, which is shared with the message bus
+     * when the raw BMP packet is sent.
      *
      * Length of packet is the common header message length (bytes)
      */
-    u_char      bmp_packet[BMP_PACKET_BUF_SIZE + 1];
+    u_char      *bmp_packet;
     size_t      bmp_packet_len;
 
     /**
@@ -182,6 +185,33 @@ public:
     // destructor
     virtual ~parseBMP();
 
+    /**
+     * Reset the parser for the next message
+     *
+     * \details Only the per message header state and the peer entry are cleared, the
+     *          data and packet buffers are overwritten by the next message.
+     */
+    void reset();
+
+    /**
+     * Set the ring buffer to read the BMP stream from
+     *
+     * \details When set, messages are read directly from the ring instead of the socket.
+     *
+     * \param [in] ringPtr     Ring buffer shared with the socket reader, NULL to read the socket
+     */
+    void setRingBuffer(RingBuffer *ringPtr);
+
+    /**
+     * Get the raw BMP packet of the current message
+     *
+     * \details The packet is not copied, the message bus can keep a reference to it.  A
+     *          new packet buffer is used for the next message while it's referenced.
+     *
+     * \return shared pointer to the raw packet
+     */
+    const std::shared_ptr<MsgBusInterface::obj_bmp_raw> &getRawPacket();
+
     /**
      * Recv wrapper for recv() to enable packet buffering
      */
@@ -290,6 +320,12 @@ public:
 private:
     bool            debug;                      ///< debug flag to indicate debugging
     Logger          *logger;                    ///< Logging class pointer
+    RingBuffer      *ring;                      ///< Ring buffer to read from, NULL to read the socket
+
+    std::shared_ptr<MsgBusInterface::obj_bmp_raw> bmp_raw;  ///< Raw packet that bmp_packet points to
+
+    size_t          packet_pos;                 ///< Parse position in bmp_packet
+    bool            framed;                     ///< True if the complete message is in bmp_packet
 
     MsgBusInterface::obj_bgp_peer *p_entry;         ///< peer table entry - will be updated with BMP info
     char            bmp_type;                   ///< The BMP message type
@@ -301,6 +337,30 @@ private:
     char peer_rd[32];                           ///< Printed format of the peer RD
     char peer_bgp_id[16];                       ///< Printed format of the peer bgp ID
 
+    /**
+     * Read from the client stream
+     *
+     * \details Reads from the ring buffer when set, otherwise from the socket.
+     *
+     * \param [in]  sockfd     Socket to read from when there is no ring buffer
+     * \param [out] buf        Buffer to read into
+     * \param [in]  len        Number of bytes to read
+     * \param [in]  flags      recv() flags, only MSG_WAITALL is supported
+     *
+     * \return number of bytes read, zero on end of stream and negative on error
+     */
+    ssize_t readStream(int sockfd, void *buf, size_t len, int flags);
+
+    /**
+     * Read the remaining BMP message into the packet buffer
+     *
+     * \param [in]  sock       Socket to read the message from
+     * \param [in]  len        Remaining length of the message
+     *
+     * \throws (const char *) on error.
+     */
+    void readFrame(int sock, uint32_t len);
+
     /**
      * Parse v1 and v2 BMP header
      *
@@ -9,12 +9,16 @@
 
 #include <sys/socket.h>
 
+#include <cerrno>
 #include <cstdlib>
 #include <cstring>
 #include <thread>
 #include <unistd.h>
 
 #include "client_thread.h"
+#include "SessionTable.h"
+#include "MemPolicy.h"
+#include "RibCheckpoint.h"
 #include "BMPReader.h"
 #include "Logger.h"
 
@@ -43,12 +47,11 @@ void ClientThread_cancel(void *arg) {
             close(cInfo->client->c_sock);
         }
 
-        usleep(50000);
+        // Discard anything buffered, the reader stops at the next read
+        if (cInfo->client->ring)
+            cInfo->client->ring->close();
 
-        close(cInfo->client->pipe_sock);
-        close(cInfo->bmp_write_end_sock);
-
-        if (cInfo->bmp_reader_thread->joinable())
+        if (cInfo->bmp_reader_thread != NULL and cInfo->bmp_reader_thread->joinable())
             cInfo->bmp_reader_thread->join();
 
         if (cInfo->bmp_reader_thread != NULL) {
@@ -84,11 +87,10 @@ void *ClientThread(void *arg) {
 #endif
     cInfo.client = &thr->client;
     cInfo.log = thr->log;
+    cInfo.bmp_reader_thread = NULL;
     cInfo.closing = false;
 
-    int sock_fds[2];
     pollfd pfd;
-    unsigned char *sock_buf = NULL;
 
     /*
      * Setup the cleanup routine for when the thread is canceled.
@@ -97,6 +99,10 @@ void *ClientThread(void *arg) {
     pthread_cleanup_push(ClientThread_cancel, &cInfo);
 
     try {
+        // Keep the socket reads, the reader thread, the message bus and the ring on the
+        //   router's node, threads started from here inherit the binding
+        MemPolicy::bindThread(cInfo.client->numa_node);
+
 #ifndef REDIS_ENABLED
         // connect to message bus
         cInfo.mbus = new msgBus_kafka(logger, thr->cfg, thr->cfg->c_hash_id);
@@ -106,19 +112,31 @@ void *ClientThread(void *arg) {
 #else
         // connect to redis
         cInfo.redis = std::make_shared<MsgBusImpl_redis>(logger, thr->cfg, cInfo.client);
-        cInfo.redis->ResetAllTables();
+
+        // Checkpointed prefixes are not sent again, the tables must keep them
+        if (thr->cfg->rib_checkpoint_dir.empty() or not RibCheckpoint::exists(thr->cfg->rib_checkpoint_dir))
+            cInfo.redis->ResetAllTables();
 #endif
         BMPReader rBMP(logger, thr->cfg);
+        rBMP.setParsePool(thr->parse_pool);
         LOG_INFO("Thread started to monitor BMP from router %s using socket %d buffer in bytes = %u",
                 cInfo.client->c_ip, cInfo.client->c_sock, thr->cfg->bmp_buffer_size);
 
-        // Buffer client socket using pipe
-        socketpair(PF_LOCAL, SOCK_STREAM, 0, sock_fds);
-        cInfo.bmp_write_end_sock = sock_fds[1];
-        cInfo.client->pipe_sock = sock_fds[0];
+        // Buffer client socket using a ring shared with the reader thread
+        std::shared_ptr<RingBuffer> client_ring = std::make_shared<RingBuffer>(thr->cfg->bmp_buffer_size,
+                                                                               thr->cfg->bmp_buffer_max_size,
+                                                                               cInfo.client->numa_node);
+        if (thr->cfg->bmp_spool_size > 0 and
+                not client_ring->enableSpool(thr->cfg->bmp_spool_dir, thr->cfg->bmp_spool_size))
+            LOG_WARN("%s: Unable to create spool file in %s: %s, buffering in memory only",
+                     cInfo.client->c_ip, thr->cfg->bmp_spool_dir.c_str(), strerror(errno));
+
+        // The main thread reads the ring for stats
+        std::atomic_store(&cInfo.client->ring, client_ring);
+        RingBuffer *ring = client_ring.get();
 
         /*
-         * Create and start the reader thread to monitor the pipe fd (read end)
+         * Create and start the reader thread to consume the ring
          */
         bool bmp_run = true;
 #ifndef REDIS_ENABLED
@@ -129,122 +147,45 @@ void *ClientThread(void *arg) {
         cInfo.bmp_reader_thread = new std::thread(&BMPReader::readerThreadLoop, &rBMP, std::ref(bmp_run), cInfo.client,
                                                                              (MsgBusInterface *)cInfo.redis.get());
 #endif
-        // Variables to handle circular buffer
-        sock_buf = new unsigned char[thr->cfg->bmp_buffer_size];
         int bytes_read = 0;
-        int write_buf_pos = 0;
-        int read_buf_pos = 0;
-        bool wrap_state = false;
-        unsigned char *sock_buf_read_ptr = sock_buf;
-        unsigned char *sock_buf_write_ptr = sock_buf;
+        unsigned char *write_ptr;
 
         /*
-         * monitor and buffer the client socket
+         * monitor and buffer the client socket, until the reader is done with it
          */
-        while (bmp_run) {
-
-            if ((wrap_state and (write_buf_pos + 1) < read_buf_pos) or
-                    (not wrap_state and write_buf_pos < thr->cfg->bmp_buffer_size)) {
-
-                pfd.fd = cInfo.client->c_sock;
-                pfd.events = POLLIN | POLLHUP | POLLERR;
-                pfd.revents = 0;
-
-                // Attempt to read from socket
-                if (poll(&pfd, 1, 5)) {
-                    if (pfd.revents & POLLHUP or pfd.revents & POLLERR) {
-                        bytes_read = 0;                     // Indicate to close the connection
-
-                    } else {
-                            if (not wrap_state)     // write is ahead of read in terms of buffer pointer
-                                bytes_read = read(cInfo.client->c_sock, sock_buf_write_ptr,
-                                                  thr->cfg->bmp_buffer_size - write_buf_pos);
-
-                            else if (read_buf_pos > write_buf_pos) // read is ahead of write in terms of buffer pointer
-                                bytes_read = read(cInfo.client->c_sock, sock_buf_write_ptr,
-                                                  read_buf_pos - write_buf_pos - 1);
-                    }
-
-                    if (bytes_read <= 0) {
-                        close(sock_fds[0]);
-                        close(sock_fds[1]);
-                        close(cInfo.client->c_sock);
-
-                        bmp_run = false;
-                        //cInfo.bmp_reader_thread->join();
-                        //delete cInfo.bmp_reader_thread;
-                        //cInfo.bmp_reader_thread = NULL;
-                        break;
-                    }
-                    else {
-                        sock_buf_write_ptr += bytes_read;
-                        write_buf_pos += bytes_read;
-                    }
-
-                }
-
-            } else if (write_buf_pos >= thr->cfg->bmp_buffer_size) { // if reached end of buffer space
-                // Reached end of buffer, wrap to start
-                write_buf_pos = 0;
-                sock_buf_write_ptr = sock_buf;
-                wrap_state = true;
-                //LOG_INFO("write buffer wrapped");
+        while (not ring->isReadClosed()) {
+            if (thr->draining) {
+                // Shutting down, the reader parses what is buffered and then ends
+                ring->closeWrite();
+                break;
             }
 
-            /** DEBUG ONLY
+            size_t space = ring->writeSpace(&write_ptr);
 
-            else {
-                LOG_INFO("%s: buffer stall, waiting for read to catch up  w=%u r=%u",  cInfo.client->c_ipv4,
-                         write_buf_pos, read_buf_pos);
+            if (space == 0) {
+                // Buffer is full, wait for the reader to catch up
+                ring->waitForSpace(100);
+                continue;
             }
 
-            if (write_buf_pos != read_buf_pos)
-                LOG_INFO("%s: CHECK: state=%d w=%u r=%u",  cInfo.client->c_ipv4, wrap_state, write_buf_pos, read_buf_pos);
-            **/
-
-            if ((not wrap_state and read_buf_pos < write_buf_pos) or
-                    (wrap_state and read_buf_pos < thr->cfg->bmp_buffer_size)) {
-
-                pfd.fd = cInfo.bmp_write_end_sock;
-                pfd.events = POLLOUT | POLLHUP | POLLERR;
-                pfd.revents = 0;
-
-                // Attempt to write buffer to bmp reader
-                if (poll(&pfd, 1, 10)) {
-
-                    if (pfd.revents & POLLHUP or pfd.revents & POLLERR) {
-                        close(sock_fds[0]);
-                        close(sock_fds[1]);
-                        close(cInfo.client->c_sock);
-
-                        bmp_run = false;
-                        //cInfo.bmp_reader_thread->join();
-                        //delete cInfo.bmp_reader_thread;
-                        //cInfo.bmp_reader_thread = NULL;
-                        break;
-                    }
-
-                    if (not wrap_state) // Write buffer is a head of read in terms of buffer pointer
-                        bytes_read = write(cInfo.bmp_write_end_sock, sock_buf_read_ptr,
-                                           (write_buf_pos - read_buf_pos) > CLIENT_WRITE_BUFFER_BLOCK_SIZE ?
-                                           CLIENT_WRITE_BUFFER_BLOCK_SIZE : (write_buf_pos - read_buf_pos));
-
-                    else // Read buffer is ahead of write in terms of buffer pointer
-                        bytes_read = write(cInfo.bmp_write_end_sock, sock_buf_read_ptr,
-                                           (thr->cfg->bmp_buffer_size - read_buf_pos) > CLIENT_WRITE_BUFFER_BLOCK_SIZE ?
-                                           CLIENT_WRITE_BUFFER_BLOCK_SIZE : (thr->cfg->bmp_buffer_size - read_buf_pos));
-
-                    if (bytes_read > 0) {
-                        sock_buf_read_ptr += bytes_read;
-                        read_buf_pos += bytes_read;
-                    }
+            pfd.fd = cInfo.client->c_sock;
+            pfd.events = POLLIN | POLLHUP | POLLERR;
+            pfd.revents = 0;
+
+            // Attempt to read from socket
+            if (poll(&pfd, 1, 100) > 0) {
+                if (pfd.revents & POLLHUP or pfd.revents & POLLERR)
+                    bytes_read = 0;                     // Indicate to close the connection
+                else
+                    bytes_read = read(cInfo.client->c_sock, write_ptr, space);
+
+                if (bytes_read <= 0) {
+                    // Reader gets end of stream once it has consumed what is buffered
+                    ring->closeWrite();
+                    break;
                 }
-            }
-            else if (read_buf_pos >= thr->cfg->bmp_buffer_size) {
-                read_buf_pos = 0;
-                sock_buf_read_ptr = sock_buf;
-                wrap_state = false;
-                //LOG_INFO("read buffer wrapped");
+
+                ring->commitWrite(bytes_read);
             }
         }
 
@@ -252,29 +193,21 @@ void *ClientThread(void *arg) {
 
     } catch (char const *str) {
         LOG_INFO("%s: %s - Thread for sock [%d] ended", cInfo.client->c_ip, str, cInfo.client->c_sock);
-        close(sock_fds[0]);
-        close(sock_fds[1]);
+        if (cInfo.client->ring)
+            cInfo.client->ring->closeWrite();
 #ifndef __APPLE__
     } catch (abi::__forced_unwind&) {
-        close(sock_fds[0]);
-        close(sock_fds[1]);
         throw;
 #endif
 
     } catch (...) {
         LOG_INFO("%s: Thread for sock [%d] ended abnormally: ", cInfo.client->c_ip, cInfo.client->c_sock);
-        close(sock_fds[0]);
-        close(sock_fds[1]);
+        if (cInfo.client->ring)
+            cInfo.client->ring->closeWrite();
     }
 
-    if (sock_buf != NULL)
-        delete[] sock_buf;
-
     pthread_cleanup_pop(0);
 
-    // Indicate that we are no longer running
-    thr->running = false;
-
     if (not cInfo.closing) {
         cInfo.closing = true;
 
@@ -287,6 +220,9 @@ void *ClientThread(void *arg) {
             cInfo.bmp_reader_thread = NULL;
         }
 
+        // Reader is done with the socket
+        close(cInfo.client->c_sock);
+
 #ifndef REDIS_ENABLED
         if (cInfo.mbus != NULL) {
             delete cInfo.mbus;
@@ -295,8 +231,128 @@ void *ClientThread(void *arg) {
 #endif
     }
 
+    // Indicate that we are no longer running, the reader thread has stopped using the client
+    thr->running = false;
+    thr->sessions->finished(thr);
+
     // Exit the thread
     pthread_exit(NULL);
 
     return NULL;
 }
+
+/**
+ * Session reader thread cancel
+ * @param arg       Pointer to ClientThreadInfo struct
+ */
+void SessionReaderThread_cancel(void *arg) {
+    ClientThreadInfo *cInfo = static_cast<ClientThreadInfo *>(arg);
+    Logger *logger = cInfo->log;
+
+    if (not cInfo->closing) {
+        cInfo->closing = true;
+
+        LOG_INFO("Reader thread for %s:%s terminating due to cancel request.",
+                 cInfo->client->c_ip, cInfo->client->c_port);
+
+        // Closing the ring ends the I/O session, which closes the router socket
+        cInfo->client->ring->closeRead();
+
+#ifndef REDIS_ENABLED
+        if (cInfo->mbus != NULL) {
+            delete cInfo->mbus;
+            cInfo->mbus = NULL;
+        }
+#endif
+    }
+}
+
+/**
+ * Session reader thread function
+ *
+ * Thread function used when the router socket is owned by the IOEngine.  The
+ * thread only runs the BMP reader/parser on the client ring, which
+ * is fed by an I/O thread.
+ *
+ * @param [in]  arg     Pointer to the ThreadMgmt of the router
+ */
+void *SessionReaderThread(void *arg) {
+    ThreadMgmt *thr = static_cast<ThreadMgmt *>(arg);
+    Logger *logger = thr->log;
+
+    ClientThreadInfo cInfo;
+#ifndef REDIS_ENABLED
+    cInfo.mbus = NULL;
+#endif
+    cInfo.client = &thr->client;
+    cInfo.log = thr->log;
+    cInfo.bmp_reader_thread = NULL;
+    cInfo.closing = false;
+
+    pthread_cleanup_push(SessionReaderThread_cancel, &cInfo);
+
+    try {
+        // Parse on the node of the I/O thread that fills the ring
+        MemPolicy::bindThread(cInfo.client->numa_node);
+
+#ifndef REDIS_ENABLED
+        cInfo.mbus = new msgBus_kafka(logger, thr->cfg, thr->cfg->c_hash_id);
+
+        if (thr->cfg->debug_msgbus)
+            cInfo.mbus->enableDebug();
+#else
+        cInfo.redis = std::make_shared<MsgBusImpl_redis>(logger, thr->cfg, cInfo.client);
+
+        // Checkpointed prefixes are not sent again, the tables must keep them
+        if (thr->cfg->rib_checkpoint_dir.empty() or not RibCheckpoint::exists(thr->cfg->rib_checkpoint_dir))
+            cInfo.redis->ResetAllTables();
+#endif
+        BMPReader rBMP(logger, thr->cfg);
+        rBMP.setParsePool(thr->parse_pool);
+        LOG_INFO("Reader thread started to monitor BMP from router %s using socket %d",
+                cInfo.client->c_ip, cInfo.client->c_sock);
+
+        bool bmp_run = true;
+#ifndef REDIS_ENABLED
+        rBMP.readerThreadLoop(bmp_run, cInfo.client, (MsgBusInterface *)cInfo.mbus);
+#else
+        rBMP.readerThreadLoop(bmp_run, cInfo.client, (MsgBusInterface *)cInfo.redis.get());
+#endif
+
+        LOG_INFO("%s: Reader thread for sock [%d] ended normally", cInfo.client->c_ip, cInfo.client->c_sock);
+
+    } catch (char const *str) {
+        LOG_INFO("%s: %s - Reader thread for sock [%d] ended", cInfo.client->c_ip, str, cInfo.client->c_sock);
+#ifndef __APPLE__
+    } catch (abi::__forced_unwind&) {
+        throw;
+#endif
+
+    } catch (...) {
+        LOG_INFO("%s: Reader thread for sock [%d] ended abnormally: ", cInfo.client->c_ip, cInfo.client->c_sock);
+    }
+
+    pthread_cleanup_pop(0);
+
+    if (not cInfo.closing) {
+        cInfo.closing = true;
+
+        // The reader loop closed the ring, unless it ended with an exception
+        cInfo.client->ring->closeRead();
+
+#ifndef REDIS_ENABLED
+        if (cInfo.mbus != NULL) {
+            delete cInfo.mbus;
+            cInfo.mbus = NULL;
+        }
+#endif
+    }
+
+    // Indicate that we are no longer running
+    thr->running = false;
+    thr->sessions->finished(thr);
+
+    pthread_exit(NULL);
+
+    return NULL;
+}
@@ -20,17 +20,24 @@
 #include "BMPListener.h"
 #include "Logger.h"
 #include "Config.h"
+#include "ParsePool.h"
+#include <atomic>
 #include <thread>
 
-#define CLIENT_WRITE_BUFFER_BLOCK_SIZE    8192        // Number of bytes to write to BMP reader from buffer
+class SessionTable;
 
 struct ThreadMgmt {
     pthread_t thr;
+    uint64_t session_id;                // ID of the session in the session table
+    SessionTable *sessions;             // Session table to post to when the thread ends
     BMPListener::ClientInfo client;
     Config *cfg;
     Logger *log;
+    ParsePool *parse_pool;              // Shared parse pool, NULL to parse in the reader thread
     bool running;                       // true if running, zero if not running
+    std::atomic<bool> draining;         // true once the session should stop reading the router and drain
     bool baselineTimeout;		        // true if past the baseline time of the router
+    RingBuffer::Stats last_stats;       // Ring counters at the previous stats interval
 };
 
 struct ClientThreadInfo {
@@ -43,7 +50,6 @@ struct ClientThreadInfo {
     Logger *log;
 
     std::thread *bmp_reader_thread;
-    int bmp_write_end_sock;
 
     bool closing;                      // Indicates if client is closing normally (set when socket is disconnected)
 
@@ -59,6 +65,17 @@ struct ClientThreadInfo {
  */
 void *ClientThread(void *arg);
 
+/**
+ * Session reader thread function
+ *
+ * Thread function used when the router socket is owned by the IOEngine.  The
+ * thread only runs the BMP reader/parser on the client ring, which
+ * is fed by an I/O thread.
+ *
+ * @param [in]  arg     Pointer to the ThreadMgmt of the router
+ */
+void *SessionReaderThread(void *arg);
+
 
 
 #endif /* CLIENT_THREAD_H_ */
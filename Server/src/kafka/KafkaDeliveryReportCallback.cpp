@@ -8,7 +8,19 @@
  */
 
 #include "KafkaDeliveryReportCallback.h"
+#include "MsgBusInterface.hpp"
+
+KafkaDeliveryReportCallback::KafkaDeliveryReportCallback(std::atomic<uint32_t> *rawInFlightRef)
+        : RdKafka::DeliveryReportCb() {
+    raw_in_flight = rawInFlightRef;
+}
 
 void KafkaDeliveryReportCallback::dr_cb (RdKafka::Message &message) {
     //std::cout << "Message delivery for (" << message.len() << " bytes): " << message.errstr() << std::endl;
-}
\ No newline at end of file
+
+    // Raw BMP packets are produced without a copy, release the packet now that it's done
+    if (message.msg_opaque() != NULL) {
+        delete static_cast<std::shared_ptr<MsgBusInterface::obj_bmp_raw> *>(message.msg_opaque());
+        --(*raw_in_flight);
+    }
+}
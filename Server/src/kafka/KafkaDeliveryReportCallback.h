@@ -11,11 +11,23 @@
 #define OPENBMP_KAFKADELIVERYREPORTCALLBACK_H
 
 #include <librdkafka/rdkafkacpp.h>
+#include <atomic>
+#include <cstdint>
 #include "Logger.h"
 
 class KafkaDeliveryReportCallback : public RdKafka::DeliveryReportCb {
 public:
+    /**
+     * Constructor for callback
+     *
+     * \param rawInFlightRef[in,out]  Pointer to the count of raw packets produced without a copy
+     */
+    KafkaDeliveryReportCallback(std::atomic<uint32_t> *rawInFlightRef);
+
     void dr_cb (RdKafka::Message &message);
+
+private:
+    std::atomic<uint32_t> *raw_in_flight;   // Raw packets referenced until delivered
 };
 
 #endif //OPENBMP_KAFKADELIVERYREPORTCALLBACK_H
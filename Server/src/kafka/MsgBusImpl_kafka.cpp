@@ -74,6 +74,7 @@ msgBus_kafka::msgBus_kafka(Logger *logPtr, Config *cfg, u_char *c_hash_id) {
     // Make the connection to the server
     event_callback       = NULL;
     delivery_callback    = NULL;
+    raw_in_flight        = 0;
     producer             = NULL;
     topicSel             = NULL;
 
@@ -111,13 +112,12 @@ msgBus_kafka::~msgBus_kafka() {
         update_Router(r_object, msgBus_kafka::ROUTER_ACTION_TERM);
     }
 
-    sleep(2);
-
     delete [] producer_buf;
     delete [] prep_buf;
 
     peer_list.clear();
 
+    // Waits for the queued messages, including the term message, to be delivered
     disconnect(500);
 
     delete conf;
@@ -141,8 +141,12 @@ void msgBus_kafka::disconnect(int wait_ms) {
 
     topicSel = NULL;
 
-    if (producer != NULL) delete producer;
-    producer = NULL;
+    {
+        std::lock_guard<std::mutex> guard(producer_lock);
+
+        if (producer != NULL) delete producer;
+        producer = NULL;
+    }
 
     // suggested by librdkafka to free memory
     RdKafka::wait_destroyed(wait_ms);
@@ -312,19 +316,22 @@ void msgBus_kafka::connect() {
         throw "ERROR: Failed to configure kafka event callback";
     }
 
-    // Register delivery report callback
-    /*
-    delivery_callback = new KafkaDeliveryReportCallback();
+    // Register delivery report callback, it releases the raw packets produced without a copy
+    raw_in_flight = 0;
+    delivery_callback = new KafkaDeliveryReportCallback(&raw_in_flight);
 
     if (conf->set("dr_cb", delivery_callback, errstr) != RdKafka::Conf::CONF_OK) {
         LOG_ERR("Failed to configure kafka delivery report callback: %s", errstr.c_str());
         throw "ERROR: Failed to configure kafka delivery report callback";
     }
-    */
 
 
     // Create producer and connect
-    producer = RdKafka::Producer::create(conf, errstr);
+    {
+        std::lock_guard<std::mutex> guard(producer_lock);
+        producer = RdKafka::Producer::create(conf, errstr);
+    }
+
     if (producer == NULL) {
         LOG_ERR("rtr=%s: Failed to create producer: %s", router_ip.c_str(), errstr.c_str());
         throw "ERROR: Failed to create producer";
@@ -772,11 +779,13 @@ void msgBus_kafka::update_L3Vpn(obj_bgp_peer &peer, std::vector<obj_vpn> &vpn,
 
     // Loop through the vector array of vpn entries
     for (size_t i = 0; i < vpn.size(); i++) {
+        char prefix[PREFIX_STR_LEN];
+        size_t prefix_str_len = prefix_toStr(vpn[i].prefix_bin, vpn[i].isIPv4, prefix);
 
         // Generate the hash
         MD5 hash;
 
-        hash.update((unsigned char *) vpn[i].prefix, strlen(vpn[i].prefix));
+        hash.update((unsigned char *) prefix, prefix_str_len);
         hash.update(&vpn[i].prefix_len, sizeof(vpn[i].prefix_len));
         hash.update((unsigned char *) vpn[i].rd_administrator_subfield.c_str(),
                     vpn[i].rd_administrator_subfield.length());
@@ -822,7 +831,7 @@ void msgBus_kafka::update_L3Vpn(obj_bgp_peer &peer, std::vector<obj_vpn> &vpn,
                                             "\t%s\t%d\t%d\t%s:%s\t%d\t%s\n",
                                     l3vpn_seq, vpn_hash_str.c_str(), r_hash_str.c_str(),
                                     router_ip.c_str(),path_hash_str.c_str(), p_hash_str.c_str(),
-                                    peer.peer_addr, peer.peer_as, ts.c_str(), vpn[i].prefix, vpn[i].prefix_len,
+                                    peer.peer_addr, peer.peer_as, ts.c_str(), prefix, vpn[i].prefix_len,
                                     vpn[i].isIPv4, attr->origin,
                                     attr->as_path.c_str(), attr->as_path_count, attr->origin_as, attr->next_hop, attr->med, attr->local_pref,
                                     attr->aggregator,
@@ -841,7 +850,7 @@ void msgBus_kafka::update_L3Vpn(obj_bgp_peer &peer, std::vector<obj_vpn> &vpn,
                                             "\t%s\t%d\t%d\t%s:%s\t%d\t\n",
                                     l3vpn_seq, vpn_hash_str.c_str(), r_hash_str.c_str(),
                                     router_ip.c_str(), p_hash_str.c_str(),
-                                    peer.peer_addr, peer.peer_as, ts.c_str(), vpn[i].prefix, vpn[i].prefix_len,
+                                    peer.peer_addr, peer.peer_as, ts.c_str(), prefix, vpn[i].prefix_len,
                                     vpn[i].isIPv4, vpn[i].path_id, vpn[i].labels, peer.isPrePolicy, peer.isAdjIn,
                                     vpn[i].rd_administrator_subfield.c_str(), vpn[i].rd_assigned_number.c_str(),
                                     vpn[i].rd_type);
@@ -1012,11 +1021,13 @@ void msgBus_kafka::update_unicastPrefix(obj_bgp_peer &peer, std::vector<obj_rib>
 
     // Loop through the vector array of rib entries
     for (size_t i = 0; i < rib.size(); i++) {
+        char prefix[PREFIX_STR_LEN];
+        size_t prefix_str_len = prefix_toStr(rib[i].prefix_bin, rib[i].isIPv4, prefix);
 
         // Generate the hash
         MD5 hash;
 
-        hash.update((unsigned char *) rib[i].prefix, strlen(rib[i].prefix));
+        hash.update((unsigned char *) prefix, prefix_str_len);
         hash.update(&rib[i].prefix_len, sizeof(rib[i].prefix_len));
         hash.update((unsigned char *) p_hash_str.c_str(), p_hash_str.length());
 
@@ -1057,7 +1068,7 @@ void msgBus_kafka::update_unicastPrefix(obj_bgp_peer &peer, std::vector<obj_rib>
                                             "\t%s\t%d\t%d\t%s\n",
                                     action.c_str(), unicast_prefix_seq, rib_hash_str.c_str(), r_hash_str.c_str(),
                                     router_ip.c_str(),path_hash_str.c_str(), p_hash_str.c_str(),
-                                    peer.peer_addr, peer.peer_as, ts.c_str(), rib[i].prefix, rib[i].prefix_len,
+                                    peer.peer_addr, peer.peer_as, ts.c_str(), prefix, rib[i].prefix_len,
                                     rib[i].isIPv4, attr->origin,
                                     attr->as_path.c_str(), attr->as_path_count, attr->origin_as, attr->next_hop, attr->med, attr->local_pref,
                                     attr->aggregator,
@@ -1073,7 +1084,7 @@ void msgBus_kafka::update_unicastPrefix(obj_bgp_peer &peer, std::vector<obj_rib>
                                             "\t%s\t%d\t%d\t\n",
                                     action.c_str(), unicast_prefix_seq, rib_hash_str.c_str(), r_hash_str.c_str(),
                                     router_ip.c_str(), p_hash_str.c_str(),
-                                    peer.peer_addr, peer.peer_as, ts.c_str(), rib[i].prefix, rib[i].prefix_len,
+                                    peer.peer_addr, peer.peer_as, ts.c_str(), prefix, rib[i].prefix_len,
                                     rib[i].isIPv4, rib[i].path_id, rib[i].labels, peer.isPrePolicy, peer.isAdjIn);
                 break;
         }
@@ -1091,6 +1102,39 @@ void msgBus_kafka::update_unicastPrefix(obj_bgp_peer &peer, std::vector<obj_rib>
             &peer_list[p_hash_str], peer.peer_as);
 }
 
+/**
+ * Abstract method Implementation - See MsgBusInterface.hpp for details
+ */
+bool msgBus_kafka::flush_PeerPrefixes(obj_bgp_peer &peer) {
+    char    buf[1024];                  // Misc working buffer
+    size_t  buf_len;
+
+    string p_hash_str;
+    string r_hash_str;
+
+    hash_toStr(peer.router_hash_id, r_hash_str);
+    hash_toStr(peer.hash_id, p_hash_str);
+
+    string ts;
+    getTimestamp(peer.timestamp_secs, peer.timestamp_us, ts);
+
+    /*
+     * One unicast_prefix row with the flush action and only the peer fields set, it withdraws
+     *      all prefixes of the peer (all tables). Keyed by the peer hash like the prefixes
+     *      of the peer, so it's ordered after them.
+     */
+    buf_len = snprintf(buf, sizeof(buf),
+                       "flush\t%" PRIu64 "\t\t%s\t%s\t\t%s\t%s\t%" PRIu32 "\t%s\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\n",
+                       unicast_prefix_seq, r_hash_str.c_str(), router_ip.c_str(), p_hash_str.c_str(),
+                       peer.peer_addr, peer.peer_as, ts.c_str());
+
+    ++unicast_prefix_seq;
+
+    produce(MSGBUS_TOPIC_VAR_UNICAST_PREFIX, buf, buf_len, 1, p_hash_str, &peer_list[p_hash_str], peer.peer_as);
+
+    return false;
+}
+
 /**
  * Abstract method Implementation - See MsgBusInterface.hpp for details
  */
@@ -1122,7 +1166,7 @@ void msgBus_kafka::add_StatReport(obj_bgp_peer &peer, obj_stats_report &stats) {
 /**
  * Abstract method Implementation - See MsgBusInterface.hpp for details
  */
-void msgBus_kafka::update_LsNode(obj_bgp_peer &peer, obj_path_attr &attr, std::list<MsgBusInterface::obj_ls_node> &nodes,
+void msgBus_kafka::update_LsNode(obj_bgp_peer &peer, obj_path_attr &attr, std::vector<MsgBusInterface::obj_ls_node> &nodes,
                                   ls_action_code code) {
     bzero(prep_buf, MSGBUS_WORKING_BUF_SIZE);
 
@@ -1160,7 +1204,7 @@ void msgBus_kafka::update_LsNode(obj_bgp_peer &peer, obj_path_attr &attr, std::l
 
     // Loop through the vector array of entries
     int rows = 0;
-    for (std::list<MsgBusInterface::obj_ls_node>::iterator it = nodes.begin();
+    for (std::vector<MsgBusInterface::obj_ls_node>::iterator it = nodes.begin();
             it != nodes.end(); it++) {
         ++rows;
         MsgBusInterface::obj_ls_node &node = (*it);
@@ -1235,7 +1279,7 @@ void msgBus_kafka::update_LsNode(obj_bgp_peer &peer, obj_path_attr &attr, std::l
 /**
  * Abstract method Implementation - See MsgBusInterface.hpp for details
  */
-void msgBus_kafka::update_LsLink(obj_bgp_peer &peer, obj_path_attr &attr, std::list<MsgBusInterface::obj_ls_link> &links,
+void msgBus_kafka::update_LsLink(obj_bgp_peer &peer, obj_path_attr &attr, std::vector<MsgBusInterface::obj_ls_link> &links,
                                  ls_action_code code) {
     bzero(prep_buf, MSGBUS_WORKING_BUF_SIZE);
 
@@ -1280,7 +1324,7 @@ void msgBus_kafka::update_LsLink(obj_bgp_peer &peer, obj_path_attr &attr, std::l
 
     // Loop through the vector array of entries
     int rows = 0;
-    for (std::list<MsgBusInterface::obj_ls_link>::iterator it = links.begin();
+    for (std::vector<MsgBusInterface::obj_ls_link>::iterator it = links.begin();
          it != links.end(); it++) {
 
         ++rows;
@@ -1404,7 +1448,7 @@ void msgBus_kafka::update_LsLink(obj_bgp_peer &peer, obj_path_attr &attr, std::l
 /**
  * Abstract method Implementation - See MsgBusInterface.hpp for details
  */
-void msgBus_kafka::update_LsPrefix(obj_bgp_peer &peer, obj_path_attr &attr, std::list<MsgBusInterface::obj_ls_prefix> &prefixes,
+void msgBus_kafka::update_LsPrefix(obj_bgp_peer &peer, obj_path_attr &attr, std::vector<MsgBusInterface::obj_ls_prefix> &prefixes,
                                    ls_action_code code) {
     bzero(prep_buf, MSGBUS_WORKING_BUF_SIZE);
 
@@ -1448,7 +1492,7 @@ void msgBus_kafka::update_LsPrefix(obj_bgp_peer &peer, obj_path_attr &attr, std:
 
     // Loop through the vector array of entries
     int rows = 0;
-    for (std::list<MsgBusInterface::obj_ls_prefix>::iterator it = prefixes.begin();
+    for (std::vector<MsgBusInterface::obj_ls_prefix>::iterator it = prefixes.begin();
          it != prefixes.end(); it++) {
 
         ++rows;
@@ -1548,7 +1592,7 @@ void msgBus_kafka::update_LsPrefix(obj_bgp_peer &peer, obj_path_attr &attr, std:
  *
  * TODO: Consolidate this to single produce method
  */
-void msgBus_kafka::send_bmp_raw(u_char *r_hash, obj_bgp_peer &peer, u_char *data, size_t data_len) {
+void msgBus_kafka::send_bmp_raw(u_char *r_hash, obj_bgp_peer &peer, const std::shared_ptr<obj_bmp_raw> &packet) {
     string r_hash_str;
     string p_hash_str;
     RdKafka::Topic *topic = NULL;
@@ -1556,6 +1600,8 @@ void msgBus_kafka::send_bmp_raw(u_char *r_hash, obj_bgp_peer &peer, u_char *data
     hash_toStr(peer.hash_id, p_hash_str);
     hash_toStr(r_hash, r_hash_str);
 
+    size_t data_len = packet->data_len;
+
     if (data_len == 0)
         return;
 
@@ -1570,25 +1616,48 @@ void msgBus_kafka::send_bmp_raw(u_char *r_hash, obj_bgp_peer &peer, u_char *data
     if (!topicSel->topicEnabled(MSGBUS_TOPIC_VAR_BMP_RAW))
         return;
 
-    char headers[256];
+    char headers[MSGBUS_RAW_HEADROOM];
     size_t hdr_len = snprintf(headers, sizeof(headers), "V: %s\nC_HASH_ID: %s\nR_HASH: %s\nR_IP: %s\nL: %lu\n\n",
              MSGBUS_API_VERSION, collector_hash.c_str(), r_hash_str.c_str(), router_ip.c_str(), data_len);
 
-    memcpy(producer_buf, headers, hdr_len);
-    memcpy(producer_buf+hdr_len, data, data_len);
+    if (hdr_len >= sizeof(headers)) {
+        LOG_ERR("rtr=%s: bmp raw message headers are larger than the packet headroom", router_ip.c_str());
+        return;
+    }
+
+    // Headers are put in the headroom right in front of the packet, the packet itself isn't copied
+    u_char *msg = packet->data() - hdr_len;
+    memcpy(msg, headers, hdr_len);
 
     topic = topicSel->getTopic(MSGBUS_TOPIC_VAR_BMP_RAW, &router_group_name, &peer_list[p_hash_str], peer.peer_as);
     if (topic != NULL) {
         SELF_DEBUG("rtr=%s: Producing bmp raw message: topic=%s key=%s, msg size = %lu", router_ip.c_str(),
                    topic->name().c_str(), r_hash_str.c_str(), data_len);
 
+        /*
+         * Reference to the packet is released by the delivery report callback. When too many
+         * are waiting on delivery, only the message is copied so the packet buffer isn't pinned.
+         */
+        std::shared_ptr<obj_bmp_raw> *packet_ref = NULL;
+        int msgflags = RdKafka::Producer::RK_MSG_COPY;
+
+        if (raw_in_flight < MSGBUS_RAW_MAX_IN_FLIGHT) {
+            packet_ref = new std::shared_ptr<obj_bmp_raw>(packet);
+            msgflags = 0;
+            ++raw_in_flight;
+        }
+
         RdKafka::ErrorCode resp = producer->produce(topic, RdKafka::Topic::PARTITION_UA,
-                                                    RdKafka::Producer::RK_MSG_COPY /* Copy payload */,
-                                                    producer_buf, data_len + hdr_len,
-                                                    (const std::string *)&r_hash_str, NULL);
+                                                    msgflags, msg, data_len + hdr_len,
+                                                    (const std::string *)&r_hash_str, packet_ref);
 
         if (resp != RdKafka::ERR_NO_ERROR) {
             LOG_ERR("rtr=%s: Failed to produce bmp raw message: %s", router_ip.c_str(), RdKafka::err2str(resp).c_str());
+
+            if (packet_ref != NULL) {
+                delete packet_ref;
+                --raw_in_flight;
+            }
             producer->poll(100);
         }
     }
@@ -1600,6 +1669,27 @@ void msgBus_kafka::send_bmp_raw(u_char *r_hash, obj_bgp_peer &peer, u_char *data
     producer->poll(0);
 }
 
+/**
+ * Abstract method Implementation - See MsgBusInterface.hpp for details
+ */
+uint32_t msgBus_kafka::getBacklog() {
+    std::lock_guard<std::mutex> guard(producer_lock);
+
+    if (producer == NULL)
+        return 0;
+
+    return producer->outq_len();
+}
+
+/**
+ * Abstract method Implementation - See MsgBusInterface.hpp for details
+ */
+bool msgBus_kafka::isRawEnabled() {
+    Config::topic_names_map_iter it = cfg->topic_names_map.find(MSGBUS_TOPIC_VAR_BMP_RAW);
+
+    return it != cfg->topic_names_map.end() and it->second.length() > 0;
+}
+
 /**
 * \brief Method to resolve the IP address to a hostname
 *
@@ -21,6 +21,7 @@
 
 #include <librdkafka/rdkafkacpp.h>
 
+#include <mutex>
 #include <thread>
 #include "safeQueue.hpp"
 #include "KafkaEventCallback.h"
@@ -38,6 +39,7 @@ class msgBus_kafka: public MsgBusInterface {
 public:
     #define MSGBUS_WORKING_BUF_SIZE         1800000
     #define MSGBUS_API_VERSION              "1.7"
+    #define MSGBUS_RAW_MAX_IN_FLIGHT        256         ///< Raw packets referenced until delivered, then copied
 
     /******************************************************************//**
      * \brief This function will initialize and connect to Kafka.
@@ -60,20 +62,24 @@ public:
     void update_Peer(obj_bgp_peer &peer, obj_peer_up_event *up, obj_peer_down_event *down, peer_action_code code);
     void update_baseAttribute(obj_bgp_peer &peer, obj_path_attr &attr, base_attr_action_code code);
     void update_unicastPrefix(obj_bgp_peer &peer, std::vector<obj_rib> &rib, obj_path_attr *attr, unicast_prefix_action_code code);
+    bool flush_PeerPrefixes(obj_bgp_peer &peer);
     void add_StatReport(obj_bgp_peer &peer, obj_stats_report &stats);
 
-    void update_LsNode(obj_bgp_peer &peer, obj_path_attr &attr, std::list<MsgBusInterface::obj_ls_node> &nodes,
+    void update_LsNode(obj_bgp_peer &peer, obj_path_attr &attr, std::vector<MsgBusInterface::obj_ls_node> &nodes,
                      ls_action_code code);
-    void update_LsLink(obj_bgp_peer &peer, obj_path_attr &attr, std::list<MsgBusInterface::obj_ls_link> &links,
+    void update_LsLink(obj_bgp_peer &peer, obj_path_attr &attr, std::vector<MsgBusInterface::obj_ls_link> &links,
                      ls_action_code code);
-    void update_LsPrefix(obj_bgp_peer &peer, obj_path_attr &attr, std::list<MsgBusInterface::obj_ls_prefix> &prefixes,
+    void update_LsPrefix(obj_bgp_peer &peer, obj_path_attr &attr, std::vector<MsgBusInterface::obj_ls_prefix> &prefixes,
                       ls_action_code code);
     
     void update_L3Vpn(obj_bgp_peer &peer, std::vector<obj_vpn> &vpn, obj_path_attr *attr, vpn_action_code code);
 
     void update_eVPN(obj_bgp_peer &peer, std::vector<obj_evpn> &vpn, obj_path_attr *attr, vpn_action_code code);
 
-    void send_bmp_raw(u_char *r_hash, obj_bgp_peer &peer, u_char *data, size_t data_len);
+    void send_bmp_raw(u_char *r_hash, obj_bgp_peer &peer, const std::shared_ptr<obj_bmp_raw> &packet);
+
+    uint32_t getBacklog();
+    bool isRawEnabled();
 
     // Debug methods
     void enableDebug();
@@ -107,6 +113,7 @@ private:
     RdKafka::Conf   *conf;
 
     RdKafka::Producer *producer;                ///< Kafka Producer instance
+    std::mutex      producer_lock;              ///< Protects replacing producer against getBacklog() from other threads
 
     /**
      * Callback handlers
@@ -114,6 +121,12 @@ private:
     KafkaEventCallback              *event_callback;
     KafkaDeliveryReportCallback     *delivery_callback;
 
+    /**
+     * Raw BMP packets produced without a copy and not yet delivered. Each pins a full size
+     * packet buffer, so past MSGBUS_RAW_MAX_IN_FLIGHT the packets are copied instead.
+     */
+    std::atomic<uint32_t>           raw_in_flight;
+
     bool isConnected;                           ///< Indicates if Kafka is connected or not
 
     // array of hashes
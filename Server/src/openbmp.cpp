@@ -21,11 +21,20 @@
 #endif
 #include "MsgBusInterface.hpp"
 #include "client_thread.h"
+#include "IOEngine.h"
+#include "ParsePool.h"
+#include "SessionTable.h"
+#include "AdmissionControl.h"
+#include "MemPolicy.h"
+#ifdef IO_URING_ENABLED
+#include "IOUringEngine.h"
+#endif
 #include "openbmpd_version.h"
 #include "Config.h"
 
 #include <unistd.h>
 #include <fstream>
+#include <cinttypes>
 #include <csignal>
 #include <cstring>
 #include <sys/stat.h>
@@ -40,12 +49,12 @@ const char *cfg_filename    = NULL;                 // Configuration file name t
 const char *log_filename    = NULL;                 // Output file to log messages to
 const char *debug_filename  = NULL;                 // Debug file to log messages to
 const char *pid_filename    = NULL;                 // PID file to record the daemon pid
-bool        run             = true;                 // Indicates if server should run
+volatile sig_atomic_t run   = true;                 // Indicates if server should run, cleared by the signal handler
 bool        run_foreground  = false;                // Indicates if server should run in forground
 
 
-// Global thread list
-vector<ThreadMgmt *> thr_list(0);
+// Global router session table
+SessionTable *sessions = NULL;
 
 static Logger *logger;                              // Local source logger reference
 
@@ -156,20 +165,8 @@ void signal_handler(int signum)
         case SIGINT  :
         case SIGCHLD : // Handle the child cleanup
 
-            for (size_t i=0; i < thr_list.size(); i++) {
-                if (thr_list.at(i)->running) {
-                    pthread_cancel(thr_list.at(i)->thr);
-                    thr_list.at(i)->running = false;
-                    pthread_join(thr_list.at(i)->thr, NULL);
-                }
-            }
-
-            thr_list.clear();
-
-            LOG_INFO("Done closing all active BMP connections");
-
+            // The main loop drains and closes the BMP connections
             run = false;
-            exit(0);
             break;
 
         default:
@@ -374,18 +371,8 @@ void collector_update_msg(Config &cfg,
 
     snprintf(oc.admin_id, sizeof(oc.admin_id), "%s", cfg.admin_id);
 
-    oc.router_count = thr_list.size();
-
-    string router_ips;
-    for (int i=0; i < thr_list.size(); i++) {
-        //MsgBusInterface::hash_toStr(thr_list.at(i)->client.hash_id, hash_str);
-        if (router_ips.size() > 0)
-            router_ips.append(", ");
-
-        router_ips.append(thr_list.at(i)->client.c_ip);
-    }
-
-    snprintf(oc.routers, sizeof(oc.routers), "%s", router_ips.c_str());
+    oc.router_count = sessions->size();
+    sessions->getRouterList(oc.routers, sizeof(oc.routers));
 
     timeval tv;
     gettimeofday(&tv, NULL);
@@ -408,18 +395,8 @@ void collector_update_msg(msgBus_kafka *kafka, Config &cfg,
 
     snprintf(oc.admin_id, sizeof(oc.admin_id), "%s", cfg.admin_id);
 
-    oc.router_count = thr_list.size();
-
-    string router_ips;
-    for (int i=0; i < thr_list.size(); i++) {
-        //MsgBusInterface::hash_toStr(thr_list.at(i)->client.hash_id, hash_str);
-        if (router_ips.size() > 0)
-            router_ips.append(", ");
-
-        router_ips.append(thr_list.at(i)->client.c_ip);
-    }
-
-    snprintf(oc.routers, sizeof(oc.routers), "%s", router_ips.c_str());
+    oc.router_count = sessions->size();
+    sessions->getRouterList(oc.routers, sizeof(oc.routers));
 
     timeval tv;
     gettimeofday(&tv, NULL);
@@ -430,6 +407,41 @@ void collector_update_msg(msgBus_kafka *kafka, Config &cfg,
 }
 #endif
 
+/**
+ * Log the ring buffer and parser counters of each router
+ *
+ * \param [in] interval    Seconds since the previous call
+ */
+void log_router_stats(int interval) {
+    vector<ThreadMgmt *> thr_list;
+    sessions->getSessions(thr_list);
+
+    for (size_t i = 0; i < thr_list.size(); i++) {
+        ThreadMgmt *thr = thr_list.at(i);
+
+        // Set by the client thread in thread mode
+        std::shared_ptr<RingBuffer> ring = std::atomic_load(&thr->client.ring);
+        if (not ring)
+            continue;
+
+        RingBuffer::Stats stats;
+        ring->getStats(stats);
+
+        RingBuffer::Stats &last = thr->last_stats;
+
+        LOG_INFO("%s: stats rx_bytes=%" PRIu64 " parsed_bytes=%" PRIu64 " msgs=%" PRIu64
+                 " msgs_per_sec=%.1f rx_kbps=%.1f buffer=%zu/%zu peak=%zu stalls=%" PRIu64
+                 " stall_ms=%" PRIu64 " wraps=%" PRIu64,
+                 thr->client.c_ip, stats.bytes_in, stats.bytes_out, stats.messages,
+                 (double)(stats.messages - last.messages) / interval,
+                 (double)(stats.bytes_in - last.bytes_in) * 8 / 1000 / interval,
+                 stats.used, stats.size, stats.peak_used, stats.stalls,
+                 stats.stall_ms, stats.wraps);
+
+        last = stats;
+    }
+}
+
 /**
  * Run Server loop
  *
@@ -439,9 +451,12 @@ void runServer(Config &cfg) {
 #ifndef REDIS_ENABLED
     msgBus_kafka *kafka;
 #endif
-    int active_connections = 0;                 // Number of active connections/threads
-    int concurrent_routers = 0;			// Number of concurrent routers
+    IOEngine *io_engine = NULL;                 // Event driven router socket ingest (NULL in thread mode)
+    ParsePool *parse_pool = NULL;               // Shared parse threads (NULL to parse in the reader threads)
+    AdmissionControl *admission = NULL;         // Load based router admission (NULL to admit by max_concurrent_routers)
+    int max_connections = MAX_THREADS;          // Max number of active connections
     time_t last_heartbeat_time = 0;
+    time_t last_stats_time = time(NULL);
    
     LOG_INFO("Initializing server");
 
@@ -461,9 +476,44 @@ void runServer(Config &cfg) {
         kafka = new msgBus_kafka(logger, &cfg, cfg.c_hash_id);
 #endif
 
+        // Huge pages and NUMA placement, before any buffer or thread is created
+        MemPolicy::setup(logger, &cfg);
+
+        sessions = new SessionTable(logger, &cfg);
+
+        // Limit the memory that router buffers can grow to
+        RingBuffer::setMemoryBudget(cfg.bmp_buffer_budget);
+
         // allocate and start a new bmp server
         BMPListener *bmp_svr = new BMPListener(logger, &cfg);
 
+        // Start the I/O threads that own the router sockets
+        if (cfg.io_mode == Config::IO_MODE_URING) {
+#ifdef IO_URING_ENABLED
+            if (IOUringEngine::isSupported())
+                io_engine = new IOUringEngine(logger, &cfg);
+            else
+                LOG_WARN("Kernel does not support io_uring multishot receive, using epoll");
+#else
+            LOG_WARN("openbmpd was built without io_uring support, using epoll");
+#endif
+        }
+
+        if (io_engine == NULL and cfg.io_mode != Config::IO_MODE_THREAD)
+            io_engine = new IOEngine(logger, &cfg);
+
+        if (io_engine != NULL)
+            max_connections = MAX_SESSIONS;
+
+        // Start the parse threads shared by all routers
+        if (cfg.parse_threads > 0)
+            parse_pool = new ParsePool(logger, &cfg);
+
+        if (cfg.admission_mode == Config::ADMISSION_LOAD) {
+            admission = new AdmissionControl(logger, &cfg);
+            admission->setParsePool(parse_pool);
+        }
+
 #ifndef REDIS_ENABLED
         collector_update_msg(kafka, cfg, MsgBusInterface::COLLECTOR_ACTION_STARTED);
 #else
@@ -476,73 +526,67 @@ void runServer(Config &cfg) {
         // Loop to accept new connections
         while (run) {
             /*
-             * Check for any stale threads/connections
+             * Clean up the sessions that ended
              */
-             for (size_t i=0; i < thr_list.size(); i++) {
-
-                // If thread is not running, it means it terminated, so close it out
-                if (!thr_list.at(i)->running) {
-
-                    // Join the thread to clean up
-                    pthread_join(thr_list.at(i)->thr, NULL);
-                    --active_connections;
-
-                    if (!thr_list.at(i)->baselineTimeout)
-                        --concurrent_routers;
-
-                    // free the vector entry
-                    delete thr_list.at(i);
-                    thr_list.erase(thr_list.begin() + i);
-
+            if (sessions->reap() > 0) {
 #ifndef REDIS_ENABLED
-                    collector_update_msg(kafka, cfg,
-                                         MsgBusInterface::COLLECTOR_ACTION_CHANGE);
+                collector_update_msg(kafka, cfg,
+                                     MsgBusInterface::COLLECTOR_ACTION_CHANGE);
 #else
-                    collector_update_msg(cfg,
-                                         MsgBusInterface::COLLECTOR_ACTION_CHANGE);
+                collector_update_msg(cfg,
+                                     MsgBusInterface::COLLECTOR_ACTION_CHANGE);
 #endif
-                }
-
-		        else if (!thr_list.at(i)->baselineTimeout) {
-
-                    int initial_time = cfg.initial_router_time;
-                    string hash(reinterpret_cast<char*>(thr_list.at(i)->client.hash_id), 16);
-
-                    //if calculate_baseline is true and the baseline time for the router is calculated, use the baseline time
-                    if (cfg.calculate_baseline && cfg.router_baseline_time.find(hash) != cfg.router_baseline_time.end())
-                        initial_time = cfg.router_baseline_time[hash];
+            }
 
-                    timeval now;
-                    gettimeofday(&now, NULL);
+            // Routers past their baseline time no longer count as concurrent routers
+            sessions->checkBaselines();
 
-                    //If past the baseline time, decrement concurrent router count
-                    if(now.tv_sec - thr_list.at(i)->client.startTime.tv_sec >= initial_time) {
-                        --concurrent_routers;
-                    thr_list.at(i)->baselineTimeout = true;		// Indicating that this router is not counted in the concurrent routers count
-                    }
-		        }
+            //TODO: Add code to check for a socket that is open, but not really connected/half open
 
-                //TODO: Add code to check for a socket that is open, but not really connected/half open
+            /*
+             * Log the router stats
+             */
+            if (cfg.stats_interval > 0 and time(NULL) - last_stats_time >= cfg.stats_interval) {
+                log_router_stats(time(NULL) - last_stats_time);
+                last_stats_time = time(NULL);
             }
 
             /*
-             * Create a new client thread if we aren't at the max number of active sessions
+             * Create a new client thread if the collector can take another router and we
+             * aren't at the max number of active sessions
              */
-            if(concurrent_routers < cfg.max_concurrent_routers)
-            {
-                if (active_connections <= MAX_THREADS) {
+            bool can_admit;
+            if (admission != NULL)
+                can_admit = admission->admit(sessions);
+            else
+                can_admit = sessions->concurrentRouters() < cfg.max_concurrent_routers;
+
+            if (not can_admit) {
+                // Send heartbeat if needed, no connection is accepted while holding
+                if ( (time(NULL) - last_heartbeat_time) >= cfg.heartbeat_interval) {
+#ifndef REDIS_ENABLED
+                    collector_update_msg(kafka, cfg, MsgBusInterface::COLLECTOR_ACTION_HEARTBEAT);
+#else
+                    collector_update_msg(cfg, MsgBusInterface::COLLECTOR_ACTION_HEARTBEAT);
+#endif
+                    last_heartbeat_time = time(NULL);
+                }
+
+                usleep(10000);
+
+            } else {
+                if ((int)sessions->size() <= max_connections) {
                     ThreadMgmt *thr = new ThreadMgmt;
+                    thr->sessions = NULL;
+                    thr->draining = false;
                     thr->cfg = &cfg;
                     thr->log = logger;
+                    thr->parse_pool = parse_pool;
+                    thr->last_stats = RingBuffer::Stats();
 
                     // wait for a new connection and accept
                     if (bmp_svr->wait_and_accept_connection(thr->client, 500)) {
-                        // Bump the current thread count
-                        ++active_connections;
-
-                        // Bump the concurrent router count
-                        ++concurrent_routers;
-                        LOG_INFO("Accepted new connection; active connections = %d", active_connections);
+                        LOG_INFO("Accepted new connection; active connections = %zu", sessions->size() + 1);
 
                         /*
                          * Start a new thread for every new router connection
@@ -557,12 +601,36 @@ void runServer(Config &cfg) {
                         thr->running = 1;
                         thr->baselineTimeout = false;
 
-                        // Start the thread to handle the client connection
-                        pthread_create(&thr->thr, &thr_attr,
-                                       ClientThread, thr);
+                        if (admission != NULL)
+                            admission->admitted();
 
-                        // Add thread to vector
-                        thr_list.insert(thr_list.end(), thr);
+                        if (io_engine != NULL) {
+                            try {
+                                // Hand the socket to an I/O thread, only the parser gets a thread
+                                io_engine->addSession(thr);
+
+                            } catch (char const *str) {
+                                LOG_ERR("%s: %s", thr->client.c_ip, str);
+                                close(thr->client.c_sock);
+                                pthread_attr_destroy(&thr_attr);
+                                delete thr;
+                                continue;
+                            }
+
+                            // Add the session before the thread can post that it ended
+                            sessions->add(thr);
+
+                            pthread_create(&thr->thr, &thr_attr,
+                                           SessionReaderThread, thr);
+
+                        } else {
+                            thr->client.numa_node = MemPolicy::nextNode();
+                            sessions->add(thr);
+
+                            // Start the thread to handle the client connection
+                            pthread_create(&thr->thr, &thr_attr,
+                                           ClientThread, thr);
+                        }
 
                         // Free attribute
                         pthread_attr_destroy(&thr_attr);
@@ -593,18 +661,56 @@ void runServer(Config &cfg) {
                     }
 
                 } else {
-                    LOG_WARN("Reached max number of threads, cannot accept new BMP connections at this time. ");
+                    LOG_WARN("Reached max number of sessions, cannot accept new BMP connections at this time. ");
                     sleep (1);
                 }
 	        }
 	    }
 
+        LOG_INFO("Shutting down, draining %zu active BMP connections", sessions->size());
+
+        // Stop accepting connections
+        delete bmp_svr;
+
+        // Stop reading the routers, the readers parse and send what is buffered and end
+        if (io_engine != NULL)
+            io_engine->drain();
+
+        sessions->drainAll();
+
+        time_t drain_deadline = time(NULL) + cfg.shutdown_timeout;
+        while (sessions->size() > 0 and time(NULL) < drain_deadline) {
+            if (sessions->reap() == 0)
+                usleep(10000);
+        }
+
+        if (sessions->size() > 0) {
+            LOG_WARN("%zu BMP connections not drained within %d seconds, canceling them",
+                     sessions->size(), cfg.shutdown_timeout);
+            sessions->cancelAll();
+        }
+
+        LOG_INFO("Done closing all active BMP connections");
+
 #ifndef REDIS_ENABLED
         collector_update_msg(kafka, cfg, MsgBusInterface::COLLECTOR_ACTION_STOPPED);
         delete kafka;
 #else
         collector_update_msg(cfg, MsgBusInterface::COLLECTOR_ACTION_STOPPED);
 #endif
+
+        if (io_engine != NULL)
+            delete io_engine;
+
+        delete sessions;
+        sessions = NULL;
+
+        if (parse_pool != NULL)
+            delete parse_pool;
+
+        if (admission != NULL)
+            delete admission;
+
     } catch (char const *str) {
         LOG_WARN(str);
     }
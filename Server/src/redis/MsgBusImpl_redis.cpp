@@ -44,6 +44,7 @@ MsgBusImpl_redis::~MsgBusImpl_redis() {
  */
 void MsgBusImpl_redis::ResetAllTables() {
     redisMgr_.ResetAllTables();
+    peer_keys_.clear();
 }
 
 /**
@@ -104,11 +105,13 @@ void MsgBusImpl_redis::update_Peer(obj_bgp_peer &peer, obj_peer_up_event *up, ob
  */
 void MsgBusImpl_redis::update_unicastPrefix(obj_bgp_peer &peer, vector<obj_rib> &rib,
                                         obj_path_attr *attr, unicast_prefix_action_code code) {
-    if (attr == NULL)
+    // Withdrawals have no attributes
+    if (attr == NULL and code == UNICAST_PREFIX_ACTION_ADD)
         return;
 
     vector<string> del_keys;
     string neigh = peer.peer_addr;
+    unordered_set<string> &installed = peer_keys_[neigh];
 
     for (size_t i = 0; i < rib.size(); i++) {
         // Loop through the vector array of rib entries
@@ -117,7 +120,8 @@ void MsgBusImpl_redis::update_unicastPrefix(obj_bgp_peer &peer, vector<obj_rib>
 
         // rib table schema as BGP_RIB_OUT_TABLE|192.181.168.0/25|10.0.0.59
         vector<string> keys;
-        string redisMgr_pfx = rib[i].prefix;
+        char prefix[PREFIX_STR_LEN];
+        string redisMgr_pfx(prefix, prefix_toStr(rib[i].prefix_bin, rib[i].isIPv4, prefix));
         redisMgr_pfx += "/";
         redisMgr_pfx += to_string(rib[i].prefix_len);
         keys.reserve(MAX_ATTRIBUTES_COUNT);
@@ -150,13 +154,16 @@ void MsgBusImpl_redis::update_unicastPrefix(obj_bgp_peer &peer, vector<obj_rib>
                     const std::string& value = std::get<1>(fieldValue);
                     DEBUG("MsgBusImpl_redis update_unicastPrefix field = %s, value = %s", field.c_str(), value.c_str());
                 }
-                if(peer.isAdjIn)
-                {
-                    redisMgr_.WriteBMPTable(BMP_TABLE_RIB_IN, keys, addFieldValues);
-                }
-                else
+                const char *table = peer.isAdjIn ? BMP_TABLE_RIB_IN : BMP_TABLE_RIB_OUT;
+
+                if (redisMgr_.WriteBMPTable(table, keys, addFieldValues))
                 {
-                    redisMgr_.WriteBMPTable(BMP_TABLE_RIB_OUT, keys, addFieldValues);
+                    string com_key = table;
+                    com_key += redisMgr_.GetKeySeparator();
+                    com_key += redisMgr_pfx;
+                    com_key += redisMgr_.GetKeySeparator();
+                    com_key += neigh;
+                    installed.insert(com_key);
                 }
             }
                 break;
@@ -176,6 +183,7 @@ void MsgBusImpl_redis::update_unicastPrefix(obj_bgp_peer &peer, vector<obj_rib>
                 com_key += redisMgr_pfx;
                 com_key += redisMgr_.GetKeySeparator();
                 com_key += neigh;
+                installed.erase(com_key);
                 del_keys.push_back(com_key);
             }
                 break;
@@ -188,6 +196,39 @@ void MsgBusImpl_redis::update_unicastPrefix(obj_bgp_peer &peer, vector<obj_rib>
 }
 
 
+/**
+ * Abstract method Implementation - See MsgBusInterface.hpp for details
+ */
+bool MsgBusImpl_redis::flush_PeerPrefixes(obj_bgp_peer &peer) {
+    map<string, unordered_set<string>>::iterator it = peer_keys_.find(peer.peer_addr);
+
+    if (it == peer_keys_.end())
+        return false;
+
+    // The session is down, both directions are gone; one DEL of BMP_DEL_BATCH keys per call
+    unordered_set<string> &installed = it->second;
+    vector<string> del_keys;
+
+    del_keys.reserve(installed.size() < BMP_DEL_BATCH ? installed.size() : BMP_DEL_BATCH);
+
+    while (!installed.empty() && del_keys.size() < BMP_DEL_BATCH) {
+        del_keys.push_back(*installed.begin());
+        installed.erase(installed.begin());
+    }
+
+    if (!del_keys.empty()) {
+        redisMgr_.RemoveEntityFromBMPTable(del_keys);
+    }
+
+    if (installed.empty()) {
+        peer_keys_.erase(it);
+        return false;
+    }
+
+    return true;
+}
+
+
 /**
  * Abstract method Implementation - See MsgBusInterface.hpp for details
  */
@@ -234,21 +275,21 @@ void MsgBusImpl_redis::add_StatReport(obj_bgp_peer &peer, obj_stats_report &stat
 /**
  * Abstract method Implementation - See MsgBusInterface.hpp for details
  */
-void MsgBusImpl_redis::update_LsNode(obj_bgp_peer &peer, obj_path_attr &attr, std::list<MsgBusInterface::obj_ls_node> &nodes,
+void MsgBusImpl_redis::update_LsNode(obj_bgp_peer &peer, obj_path_attr &attr, std::vector<MsgBusInterface::obj_ls_node> &nodes,
                                   ls_action_code code) {
 }
 
 /**
  * Abstract method Implementation - See MsgBusInterface.hpp for details
  */
-void MsgBusImpl_redis::update_LsLink(obj_bgp_peer &peer, obj_path_attr &attr, std::list<MsgBusInterface::obj_ls_link> &links,
+void MsgBusImpl_redis::update_LsLink(obj_bgp_peer &peer, obj_path_attr &attr, std::vector<MsgBusInterface::obj_ls_link> &links,
                                  ls_action_code code) {
 }
 
 /**
  * Abstract method Implementation - See MsgBusInterface.hpp for details
  */
-void MsgBusImpl_redis::update_LsPrefix(obj_bgp_peer &peer, obj_path_attr &attr, std::list<MsgBusInterface::obj_ls_prefix> &prefixes,
+void MsgBusImpl_redis::update_LsPrefix(obj_bgp_peer &peer, obj_path_attr &attr, std::vector<MsgBusInterface::obj_ls_prefix> &prefixes,
                                    ls_action_code code) {
 }
 
@@ -257,5 +298,5 @@ void MsgBusImpl_redis::update_LsPrefix(obj_bgp_peer &peer, obj_path_attr &attr,
  *
  * TODO: Consolidate this to single produce method
  */
-void MsgBusImpl_redis::send_bmp_raw(u_char *r_hash, obj_bgp_peer &peer, u_char *data, size_t data_len) {
+void MsgBusImpl_redis::send_bmp_raw(u_char *r_hash, obj_bgp_peer &peer, const std::shared_ptr<obj_bmp_raw> &packet) {
 }
\ No newline at end of file
@@ -10,6 +10,7 @@
 #include "Logger.h"
 #include <string>
 #include <map>
+#include <unordered_set>
 #include <vector>
 #include <ctime>
 
@@ -53,25 +54,34 @@ public:
     void update_Peer(obj_bgp_peer &peer, obj_peer_up_event *up, obj_peer_down_event *down, peer_action_code code);
     void update_baseAttribute(obj_bgp_peer &peer, obj_path_attr &attr, base_attr_action_code code);
     void update_unicastPrefix(obj_bgp_peer &peer, std::vector<obj_rib> &rib, obj_path_attr *attr, unicast_prefix_action_code code);
+    bool flush_PeerPrefixes(obj_bgp_peer &peer);
     void add_StatReport(obj_bgp_peer &peer, obj_stats_report &stats);
 
-    void update_LsNode(obj_bgp_peer &peer, obj_path_attr &attr, std::list<MsgBusInterface::obj_ls_node> &nodes,
+    void update_LsNode(obj_bgp_peer &peer, obj_path_attr &attr, std::vector<MsgBusInterface::obj_ls_node> &nodes,
                      ls_action_code code);
-    void update_LsLink(obj_bgp_peer &peer, obj_path_attr &attr, std::list<MsgBusInterface::obj_ls_link> &links,
+    void update_LsLink(obj_bgp_peer &peer, obj_path_attr &attr, std::vector<MsgBusInterface::obj_ls_link> &links,
                      ls_action_code code);
-    void update_LsPrefix(obj_bgp_peer &peer, obj_path_attr &attr, std::list<MsgBusInterface::obj_ls_prefix> &prefixes,
+    void update_LsPrefix(obj_bgp_peer &peer, obj_path_attr &attr, std::vector<MsgBusInterface::obj_ls_prefix> &prefixes,
                       ls_action_code code);
     
     void update_L3Vpn(obj_bgp_peer &peer, std::vector<obj_vpn> &vpn, obj_path_attr *attr, vpn_action_code code);
 
     void update_eVPN(obj_bgp_peer &peer, std::vector<obj_evpn> &vpn, obj_path_attr *attr, vpn_action_code code);
 
-    void send_bmp_raw(u_char *r_hash, obj_bgp_peer &peer, u_char *data, size_t data_len);
+    void send_bmp_raw(u_char *r_hash, obj_bgp_peer &peer, const std::shared_ptr<obj_bmp_raw> &packet);
+
+    bool isRawEnabled() { return false; }
 
 private:
     Logger          *logger;                    ///< Logging class pointer
     Config          *cfg;                       ///< Pointer to config instance
     RedisManager    redisMgr_;
+
+    /**
+     * RIB keys written per peer address, so the prefixes of a peer are deleted on
+     * PEER DOWN without scanning the tables
+     */
+    std::map<std::string, std::unordered_set<std::string>> peer_keys_;
 };
 
 #endif /* MSGBUSIMPL_REDIS_H_ */
@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2013-2016 Cisco Systems, Inc. and others.  All rights reserved.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v1.0 which accompanies this distribution,
+ * and is available at http://www.eclipse.org/legal/epl-v10.html
+ *
+ */
+
+/**
+ * Equivalence test of bgp_msg::NlriBatch against the per prefix decoders it replaced
+ *
+ * \details Random well formed NLRI fields are decoded by both, for IPv4 and IPv6, with
+ *          and without add path and labels.  The batch decoder zeroes the bits past the
+ *          prefix length, so the prefixes are compared masked.  Random garbage is decoded
+ *          as well; it must stop cleanly without reading past the field (run it with
+ *          -fsanitize=address to check) and only return valid prefix lengths.
+ *
+ *          Built twice by cmake -DENABLE_TESTS=ON, the second time with -mno-sse2 to test
+ *          the scalar path.
+ *
+ *          Usage: nlri_batch_test [seed]
+ */
+#include "NlriBatch.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define TEST_ITERATIONS         2000        ///< NLRI fields per address family/add path/label combination
+#define TEST_MAX_PREFIXES       300         ///< Max prefixes in a generated NLRI field
+#define TEST_MAX_NLRI_LEN       4000        ///< Max length of a generated NLRI field
+#define TEST_MAX_GARBAGE_LEN    200         ///< Max length of a garbage NLRI field
+
+using namespace std;
+
+/**
+ * Prefix decoded by the reference decoders
+ */
+struct RefTuple {
+    bgp::PREFIX_TYPE  type;
+    unsigned char     len;
+    uint8_t           prefix_bin[16];
+    uint32_t          path_id;
+    bool              isIPv4;
+    std::string       labels;
+};
+
+/**
+ * Reference label decoder, MPReachAttr::decodeLabel() before NlriBatch
+ */
+static uint16_t refDecodeLabel(u_char *data, uint16_t len, std::string &labels) {
+    int read_size = 0;
+    typedef union {
+        struct {
+            uint8_t   ttl     : 8;          // TTL - not present since only 3 octets are used
+            uint8_t   bos     : 1;          // Bottom of stack
+            uint8_t   exp     : 3;          // EXP - not really used
+            uint32_t  value   : 20;         // Label value
+        } decode;
+        uint32_t  data;                 // Raw label - 3 octets only per RFC3107
+    } mpls_label;
+
+    mpls_label label;
+
+    labels.clear();
+
+    u_char *data_ptr = data;
+
+    while (read_size <= len) {
+        bzero(&label, sizeof(label));
+
+        memcpy(&label.data, data_ptr, 3);
+        bgp::SWAP_BYTES(&label.data);
+
+        data_ptr += 3;
+        read_size += 3;
+
+        ostringstream convert;
+        convert << label.decode.value;
+        labels.append(convert.str());
+
+        if (label.decode.bos == 1 or label.data == 0x80000000 or label.data == 0)
+            break;
+        else
+            labels.append(",");
+    }
+
+    return read_size;
+}
+
+/**
+ * Reference decoder, MPReachAttr::parseNlriData_IPv4IPv6() and
+ * parseNlriData_LabelIPv4IPv6() before NlriBatch, without the printed prefix
+ */
+static void refDecode(bool isIPv4, bool add_path, bool labeled, u_char *data, uint16_t len,
+                      std::list<RefTuple> &prefixes) {
+    u_char      ip_raw[16];
+    int         addr_bytes;
+    RefTuple    tuple;
+
+    if (len <= 0 or data == NULL)
+        return;
+
+    if (labeled)
+        tuple.type = isIPv4 ? bgp::PREFIX_LABEL_UNICAST_V4 : bgp::PREFIX_LABEL_UNICAST_V6;
+    else
+        tuple.type = isIPv4 ? bgp::PREFIX_UNICAST_V4 : bgp::PREFIX_UNICAST_V6;
+    tuple.isIPv4 = isIPv4;
+
+    for (size_t read_size=0; read_size < len; read_size++) {
+        if (add_path and (len - read_size) >= 4) {
+            memcpy(&tuple.path_id, data, 4);
+            bgp::SWAP_BYTES(&tuple.path_id);
+            data += 4;
+            read_size += 4;
+        } else
+            tuple.path_id = 0;
+
+        bzero(ip_raw, sizeof(ip_raw));
+
+        tuple.len = *data++;
+
+        addr_bytes = tuple.len / 8;
+        if (tuple.len % 8)
+           ++addr_bytes;
+
+        if (labeled) {
+            uint16_t label_bytes = refDecodeLabel(data, addr_bytes, tuple.labels);
+
+            tuple.len -= (8 * label_bytes);
+            data += label_bytes;
+            addr_bytes -= label_bytes;
+            read_size += label_bytes;
+        }
+
+        if (addr_bytes > 0) {
+            memcpy(ip_raw, data, addr_bytes);
+            data += addr_bytes;
+            read_size += addr_bytes;
+        }
+
+        memcpy(tuple.prefix_bin, ip_raw, sizeof(ip_raw));
+
+        prefixes.push_back(tuple);
+    }
+}
+
+/**
+ * Generate a well formed NLRI field
+ *
+ * \param [in]  isIPv4      True false to indicate if IPv4 or IPv6
+ * \param [in]  add_path    True to add a path ID to each prefix
+ * \param [in]  labeled     True to add 1 to 3 labels to each prefix
+ * \param [out] nlri        NLRI field
+ */
+static void genNlri(bool isIPv4, bool add_path, bool labeled, std::vector<u_char> &nlri) {
+    int prefixes = rand() % TEST_MAX_PREFIXES;
+
+    nlri.clear();
+
+    for (int i = 0; i < prefixes and nlri.size() < TEST_MAX_NLRI_LEN; i++) {
+        if (add_path) {
+            for (int k = 0; k < 4; k++)
+                nlri.push_back(rand());
+        }
+
+        int bits = rand() % ((isIPv4 ? 32 : 128) + 1);
+        int labels = labeled ? 1 + rand() % 3 : 0;
+
+        nlri.push_back(bits + 24 * labels);
+
+        for (int l = 0; l < labels; l++) {
+            uint32_t raw = (rand() & 0xFFFFF) << 4 | (rand() & 0xE);
+
+            // Withdrawn and zero labels end the stack, only use them as the last label
+            if (l == labels - 1 and rand() % 20 == 0)
+                raw = rand() & 1 ? 0x800000 : 0;
+            else if (l == labels - 1)
+                raw |= 1;
+            else if (raw == 0)
+                raw = 0x10;
+
+            nlri.push_back(raw >> 16);
+            nlri.push_back(raw >> 8);
+            nlri.push_back(raw);
+        }
+
+        for (int b = 0; b < (bits + 7) / 8; b++)
+            nlri.push_back(rand());
+    }
+}
+
+/**
+ * Zero the bits of a prefix past its length
+ */
+static void maskPrefix(uint8_t *prefix, int len) {
+    for (int bit = len; bit < 128; bit++)
+        prefix[bit / 8] &= ~(0x80 >> (bit % 8));
+}
+
+/**
+ * Decode NLRI fields of one address family/add path/label combination with both decoders
+ *
+ * \returns number of prefixes compared, -1 if the decoders differ
+ */
+static long compareDecoders(bgp_msg::NlriBatch &batch, bool isIPv4, bool add_path, bool labeled) {
+    std::vector<u_char> nlri;
+    std::vector<bgp::prefix_tuple> tuples;
+    std::list<RefTuple> ref;
+    long compared = 0;
+
+    bgp::PREFIX_TYPE type;
+    if (labeled)
+        type = isIPv4 ? bgp::PREFIX_LABEL_UNICAST_V4 : bgp::PREFIX_LABEL_UNICAST_V6;
+    else
+        type = isIPv4 ? bgp::PREFIX_UNICAST_V4 : bgp::PREFIX_UNICAST_V6;
+
+    for (int iter = 0; iter < TEST_ITERATIONS; iter++) {
+        genNlri(isIPv4, add_path, labeled, nlri);
+
+        ref.clear();
+        tuples.clear();
+
+        refDecode(isIPv4, add_path, labeled, nlri.data(), nlri.size(), ref);
+
+        bgp_msg::NlriBatch::DECODE_STATUS status = batch.decode(isIPv4, add_path, labeled, nlri.data(), nlri.size());
+        batch.toTuples(type, tuples);
+
+        if (status != bgp_msg::NlriBatch::NLRI_OK or ref.size() != tuples.size()) {
+            printf("FAIL: %s prefixes, reference decoded %zu, batch decoded %zu\n",
+                   bgp_msg::NlriBatch::statusStr(status), ref.size(), tuples.size());
+            return -1;
+        }
+
+        std::vector<bgp::prefix_tuple>::iterator it = tuples.begin();
+        for (std::list<RefTuple>::iterator r = ref.begin(); r != ref.end(); ++r, ++it) {
+            uint8_t prefix[16];
+
+            memcpy(prefix, r->prefix_bin, sizeof(prefix));
+            maskPrefix(prefix, r->len);
+
+            if (r->type != it->type or r->len != it->len or r->path_id != it->path_id
+                    or r->isIPv4 != it->isIPv4 or r->labels != it->labels
+                    or memcmp(prefix, it->prefix_bin, sizeof(prefix)) != 0) {
+                printf("FAIL: prefix %ld differs, len %d/%d path_id %u/%u labels '%s'/'%s'\n",
+                       compared, r->len, it->len, r->path_id, it->path_id, r->labels.c_str(), it->labels);
+                return -1;
+            }
+
+            compared++;
+        }
+    }
+
+    return compared;
+}
+
+/**
+ * Decode random garbage, decoding must stop without reading past the field
+ *
+ * \returns true if only valid prefixes were returned
+ */
+static bool decodeGarbage(bgp_msg::NlriBatch &batch, bool isIPv4, bool add_path, bool labeled) {
+    for (int iter = 0; iter < TEST_ITERATIONS; iter++) {
+        // Exact size, so that reading past the end is caught by the address sanitizer
+        uint16_t len = 1 + rand() % TEST_MAX_GARBAGE_LEN;
+        u_char *nlri = new u_char[len];
+
+        for (uint16_t i = 0; i < len; i++)
+            nlri[i] = rand();
+
+        batch.decode(isIPv4, add_path, labeled, nlri, len);
+        delete [] nlri;
+
+        for (size_t i = 0; i < batch.count; i++) {
+            if (batch.lens[i] > (isIPv4 ? 32 : 128)) {
+                printf("FAIL: garbage decoded to prefix length %d\n", batch.lens[i]);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bgp_msg::NlriBatch batch;
+
+    srand(argc > 1 ? atoi(argv[1]) : 1);
+
+    for (int i = 0; i < 8; i++) {
+        bool isIPv4 = i & 1;
+        bool add_path = i & 2;
+        bool labeled = i & 4;
+
+        long compared = compareDecoders(batch, isIPv4, add_path, labeled);
+
+        if (compared < 0 or not decodeGarbage(batch, isIPv4, add_path, labeled)) {
+            printf("FAIL: %s add_path=%d labeled=%d\n", isIPv4 ? "IPv4" : "IPv6", add_path, labeled);
+            return 1;
+        }
+
+        printf("OK: %s add_path=%d labeled=%d, %ld prefixes\n", isIPv4 ? "IPv4" : "IPv6", add_path, labeled,
+               compared);
+    }
+
+    return 0;
+}